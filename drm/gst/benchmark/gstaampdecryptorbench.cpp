@@ -0,0 +1,355 @@
+/*
+* Copyright 2018 RDK Management
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Library General Public
+* License as published by the Free Software Foundation, version 2
+* of the license.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Library General Public License for more details.
+*
+* You should have received a copy of the GNU Library General Public
+* License along with this library; if not, write to the
+* Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file gstaampdecryptorbench.cpp
+ * @brief Throughput benchmark of the decryptor elements
+ *
+ * Runs synthetic 'cenc' samples through the PlayReady and Widevine decryptors with software DRM
+ * sessions and through the ClearKey decryptor with its "keys" property, and reports throughput,
+ * allocations and lock wait from the "stats" property. Samples are chained into the decryptor's
+ * sink pad and collected from its src pad, without a pipeline, so the batched and parallel paths
+ * of submit_input_buffer run as they do in playback and only the decryptor's own costs are measured.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <gst/gst.h>
+#include <gst/base/gstbasetransform.h>
+#include "gstaampcdmidecryptor.h"
+#include "gstaampplayreadydecryptor.h"
+#include "gstaampwidevinedecryptor.h"
+#include "gstaampclearkeydecryptor.h"
+#include "gstaampprotectionmeta.h"
+#include "gstaampfakedrmsession.h"
+
+#define SUBSAMPLE_ENTRY_SIZE 6      // uint16 clear bytes, uint32 encrypted bytes
+
+/**
+ * @struct BenchLayout
+ * @brief Synthetic sample layout
+ */
+struct BenchLayout
+{
+    const char*     name;
+    gsize           sampleSize;
+    guint           nalCount;       // 0 if the whole sample is encrypted
+    gsize           leaderSize;     // clear parameter sets and SEI ahead of the first slice
+    gsize           nalClearSize;   // clear NAL and slice header bytes of each slice
+    guint           ivSize;
+};
+
+static const BenchLayout benchLayouts[] =
+{
+    { "aac-audio",   768,    0,  0,   0,  8  },  // 128 kbit/s AAC frame, full sample encryption
+    { "h264-1080p",  65536,  68, 96,  8,  8  },  // slice per macroblock row
+    { "hevc-4k",     524288, 4,  256, 32, 16 }   // few large slices
+};
+
+/**
+ * @enum BenchPath
+ * @brief Decrypt path exercised by a run
+ */
+enum BenchPath
+{
+    BENCH_PATH_GATHER,      // session implementing AampDrmSession::decrypt only
+    BENCH_PATH_IN_PLACE,    // session implementing the in place subsample interface
+    BENCH_PATH_BATCH,       // in place session decrypting batch-size samples per call
+    BENCH_PATH_PARALLEL,    // in place session called from decrypt-threads worker threads
+    BENCH_PATH_CLEARKEY     // in element decryption of the ClearKey decryptor
+};
+
+static const guint8 benchKid[GST_AAMP_CLEARKEY_KEY_SIZE] =
+{
+    0x10, 0x77, 0xef, 0xec, 0xc0, 0xb2, 0x4d, 0x02, 0xac, 0xe3, 0x3c, 0x1e, 0x52, 0xe2, 0xfb, 0x4b
+};
+static const guint8 benchKey[GST_AAMP_CLEARKEY_KEY_SIZE] =
+{
+    0x3c, 0x98, 0x3d, 0x94, 0x2a, 0xbf, 0x41, 0x1b, 0x93, 0x8b, 0x74, 0x0a, 0x5e, 0x29, 0x3c, 0x72
+};
+static const gchar* benchKeys = "1077efecc0b24d02ace33c1e52e2fb4b:3c983d942abf411b938b740a5e293c72";
+
+static gint benchIterations = 2000;
+static gboolean benchBinaryMeta = FALSE;
+static gint benchBatchSize = 8;
+static gint benchThreads = 4;
+
+static GOptionEntry benchOptions[] =
+{
+    { "iterations", 'n', 0, G_OPTION_ARG_INT, &benchIterations, "Samples per run", "N" },
+    { "binary-meta", 'b', 0, G_OPTION_ARG_NONE, &benchBinaryMeta, "Attach the binary protection meta instead of GstProtectionMeta", NULL },
+    { "batch-size", 's', 0, G_OPTION_ARG_INT, &benchBatchSize, "batch-size of the batch runs", "N" },
+    { "threads", 't', 0, G_OPTION_ARG_INT, &benchThreads, "decrypt-threads of the parallel runs", "N" },
+    { NULL }
+};
+
+/*
+ Builds the subsample table of a layout, NULL for full sample encryption.
+ */
+static GBytes* bench_subsamples(const BenchLayout* layout)
+{
+    if (!layout->nalCount)
+    {
+        return NULL;
+    }
+    guint8* table = (guint8*) g_malloc(layout->nalCount * SUBSAMPLE_ENTRY_SIZE);
+    gsize sliceSize = (layout->sampleSize - layout->leaderSize) / layout->nalCount;
+    for (guint i = 0; i < layout->nalCount; i++)
+    {
+        // the leader goes with the first slice, the remainder of the division with the last
+        gsize clear = layout->nalClearSize + (i ? 0 : layout->leaderSize);
+        gsize size = sliceSize + (i ? 0 : layout->leaderSize);
+        if (i == layout->nalCount - 1)
+        {
+            size += layout->sampleSize - layout->leaderSize - sliceSize * layout->nalCount;
+        }
+        GST_WRITE_UINT16_BE(table + i * SUBSAMPLE_ENTRY_SIZE, clear);
+        GST_WRITE_UINT32_BE(table + i * SUBSAMPLE_ENTRY_SIZE + 2, size - clear);
+    }
+    return g_bytes_new_take(table, layout->nalCount * SUBSAMPLE_ENTRY_SIZE);
+}
+
+/*
+ Builds the GstProtectionMeta structure a demuxer attaches to the samples of a layout.
+ */
+static GstStructure* bench_protection_info(const BenchLayout* layout, GBytes* subsamples, const guint8* iv)
+{
+    GstBuffer* ivBuffer = gst_buffer_new_wrapped(g_memdup(iv, layout->ivSize), layout->ivSize);
+    GstBuffer* kidBuffer = gst_buffer_new_wrapped(g_memdup(benchKid, sizeof(benchKid)), sizeof(benchKid));
+    GstStructure* info = gst_structure_new("application/x-cenc",
+            "encrypted", G_TYPE_BOOLEAN, TRUE,
+            "iv_size", G_TYPE_UINT, layout->ivSize,
+            "iv", GST_TYPE_BUFFER, ivBuffer,
+            "kid", GST_TYPE_BUFFER, kidBuffer,
+            "subsample_count", G_TYPE_UINT, layout->nalCount,
+            NULL);
+    if (subsamples)
+    {
+        gsize size = 0;
+        gconstpointer data = g_bytes_get_data(subsamples, &size);
+        GstBuffer* subsamplesBuffer = gst_buffer_new_wrapped(g_memdup(data, size), size);
+        gst_structure_set(info, "subsamples", GST_TYPE_BUFFER, subsamplesBuffer, NULL);
+        gst_buffer_unref(subsamplesBuffer);
+    }
+    gst_buffer_unref(kidBuffer);
+    gst_buffer_unref(ivBuffer);
+    return info;
+}
+
+/*
+ Creates the decryptor of a run, with its key or session in place.
+ */
+static GstElement* bench_decryptor(BenchPath path, GType type, AampDrmSession* session)
+{
+    GstElement* decryptor = GST_ELEMENT(g_object_new(type, NULL));
+
+    gst_object_ref_sink(decryptor);
+    if (path == BENCH_PATH_CLEARKEY)
+    {
+        g_object_set(decryptor, "keys", benchKeys, NULL);
+    }
+    else
+    {
+        gst_aampcdmidecryptor_set_session(GST_AAMP_CDMI_DECRYPTOR(decryptor), session);
+    }
+    if (path == BENCH_PATH_BATCH)
+    {
+        g_object_set(decryptor, "batch-size", (guint) benchBatchSize, NULL);
+    }
+    else if (path == BENCH_PATH_PARALLEL)
+    {
+        g_object_set(decryptor, "decrypt-threads", (guint) benchThreads, NULL);
+    }
+    return decryptor;
+}
+
+/*
+ Takes back decrypted samples for reuse as input, the queue is the pad's element private.
+ */
+static GstFlowReturn bench_sink_chain(GstPad* pad, GstObject* parent, GstBuffer* buffer)
+{
+    g_queue_push_tail((GQueue*) gst_pad_get_element_private(pad), buffer);
+    return GST_FLOW_OK;
+}
+
+static gboolean bench_sink_event(GstPad* pad, GstObject* parent, GstEvent* event)
+{
+    gst_event_unref(event);
+    return TRUE;
+}
+
+/*
+ Links a sink pad collecting the output of decryptor into samples and starts streaming.
+ */
+static GstPad* bench_connect(GstElement* decryptor, GQueue* samples)
+{
+    GstPad* sinkPad = GST_BASE_TRANSFORM_SINK_PAD(decryptor);
+    GstPad* srcPad = GST_BASE_TRANSFORM_SRC_PAD(decryptor);
+    GstPad* collector = gst_pad_new("bench", GST_PAD_SINK);
+    GstSegment segment;
+
+    gst_pad_set_chain_function(collector, bench_sink_chain);
+    gst_pad_set_event_function(collector, bench_sink_event);
+    gst_pad_set_element_private(collector, samples);
+    gst_pad_set_active(collector, TRUE);
+    gst_pad_link(srcPad, collector);
+    gst_pad_set_active(srcPad, TRUE);
+    gst_pad_set_active(sinkPad, TRUE);
+
+    gst_segment_init(&segment, GST_FORMAT_TIME);
+    gst_pad_send_event(sinkPad, gst_event_new_stream_start("bench"));
+    gst_pad_send_event(sinkPad, gst_event_new_segment(&segment));
+    return collector;
+}
+
+/*
+ Stops streaming and unlinks the collecting pad.
+ */
+static void bench_disconnect(GstElement* decryptor, GstPad* collector)
+{
+    GstPad* srcPad = GST_BASE_TRANSFORM_SRC_PAD(decryptor);
+
+    gst_pad_set_active(GST_BASE_TRANSFORM_SINK_PAD(decryptor), FALSE);
+    gst_pad_set_active(srcPad, FALSE);
+    gst_pad_unlink(srcPad, collector);
+    gst_pad_set_active(collector, FALSE);
+    gst_object_unref(collector);
+}
+
+/*
+ Decrypts benchIterations samples of a layout and prints the counters of the run.
+ */
+static void bench_run(const char* pathName, BenchPath path, const char* elementName, GType type,
+        AampDrmSession* session, const BenchLayout* layout)
+{
+    guint8 iv[16] = { 0 };
+    GBytes* subsamples = bench_subsamples(layout);
+    GstStructure* info = bench_protection_info(layout, subsamples, iv);
+    GstElement* decryptor = bench_decryptor(path, type, session);
+    GQueue samplePool = G_QUEUE_INIT;
+    GstPad* collector = bench_connect(decryptor, &samplePool);
+    GstPad* sinkPad = GST_BASE_TRANSFORM_SINK_PAD(decryptor);
+    GstStructure* stats = NULL;
+    GstBuffer* sample;
+    guint64 samples = 0;
+    guint64 failures = 0;
+    guint64 allocations = 0;
+    guint64 lockWait = 0;
+    guint64 lockContentions = 0;
+
+    gint64 start = g_get_monotonic_time();
+    for (gint i = 0; i < benchIterations; i++)
+    {
+        // samples held for a batch or in flight on a worker are not back yet, the pool grows to cover them
+        sample = (GstBuffer*) g_queue_pop_head(&samplePool);
+        if (!sample)
+        {
+            sample = gst_buffer_new_allocate(NULL, layout->sampleSize, NULL);
+            gst_buffer_memset(sample, 0, 0x5a, layout->sampleSize);
+        }
+        if (benchBinaryMeta)
+        {
+            gst_buffer_add_aamp_protection_meta(sample, iv, layout->ivSize, benchKid, layout->nalCount, subsamples);
+        }
+        else
+        {
+            gst_buffer_add_protection_meta(sample, gst_structure_copy(info));
+        }
+        if (gst_pad_chain(sinkPad, sample) != GST_FLOW_OK)
+        {
+            break;
+        }
+    }
+    // serialized, decrypts the held samples and pushes them out
+    gst_pad_send_event(sinkPad, gst_event_new_eos());
+    gint64 elapsed = MAX(g_get_monotonic_time() - start, (gint64) 1);
+
+    g_object_get(decryptor, "stats", &stats, NULL);
+    if (stats)
+    {
+        gst_structure_get(stats,
+                "samples", G_TYPE_UINT64, &samples,
+                "failures", G_TYPE_UINT64, &failures,
+                "allocations", G_TYPE_UINT64, &allocations,
+                "lock-contentions", G_TYPE_UINT64, &lockContentions,
+                "lock-wait-us", G_TYPE_UINT64, &lockWait,
+                NULL);
+        gst_structure_free(stats);
+    }
+    if (samples)
+    {
+        printf("%-14s %-9s %-11s %9.1f MB/s %9.0f samples/s %6.2f allocs/sample %6" G_GUINT64_FORMAT " contentions %8.3f us lock wait/sample %" G_GUINT64_FORMAT " failures\n",
+                elementName, pathName, layout->name,
+                (double) samples * layout->sampleSize / elapsed, (double) samples * G_USEC_PER_SEC / elapsed,
+                (double) allocations / samples, lockContentions, (double) lockWait / samples, failures);
+    }
+    else
+    {
+        printf("%-14s %-9s %-11s no sample decrypted\n", elementName, pathName, layout->name);
+    }
+
+    bench_disconnect(decryptor, collector);
+    while ((sample = (GstBuffer*) g_queue_pop_head(&samplePool)) != NULL)
+    {
+        gst_buffer_unref(sample);
+    }
+    gst_object_unref(decryptor);
+    gst_structure_free(info);
+    if (subsamples)
+    {
+        g_bytes_unref(subsamples);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    GError* error = NULL;
+    GOptionContext* context = g_option_context_new("- aamp decryptor benchmark");
+
+    g_option_context_add_main_entries(context, benchOptions, NULL);
+    g_option_context_add_group(context, gst_init_get_option_group());
+    if (!g_option_context_parse(context, &argc, &argv, &error))
+    {
+        fprintf(stderr, "%s\n", error->message);
+        g_error_free(error);
+        g_option_context_free(context);
+        return 1;
+    }
+    g_option_context_free(context);
+
+    AampFakeDrmSession gatherSession(benchKid, benchKey);
+    AampFakeSubsampleDrmSession inPlaceSession(benchKid, benchKey);
+
+    printf("%d samples per run, %s, batch-size %d, decrypt-threads %d\n", benchIterations,
+            benchBinaryMeta ? "binary protection meta" : "GstProtectionMeta", benchBatchSize, benchThreads);
+    for (guint i = 0; i < G_N_ELEMENTS(benchLayouts); i++)
+    {
+        const BenchLayout* layout = &benchLayouts[i];
+        bench_run("gather", BENCH_PATH_GATHER, GstPluginNamePR, GST_TYPE_AAMPPLAYREADYDECRYPTOR, &gatherSession, layout);
+        bench_run("in-place", BENCH_PATH_IN_PLACE, GstPluginNamePR, GST_TYPE_AAMPPLAYREADYDECRYPTOR, &inPlaceSession, layout);
+        bench_run("batch", BENCH_PATH_BATCH, GstPluginNamePR, GST_TYPE_AAMPPLAYREADYDECRYPTOR, &inPlaceSession, layout);
+        bench_run("parallel", BENCH_PATH_PARALLEL, GstPluginNamePR, GST_TYPE_AAMPPLAYREADYDECRYPTOR, &inPlaceSession, layout);
+        bench_run("gather", BENCH_PATH_GATHER, GstPluginNameWV, GST_TYPE_AAMPWIDEVINEDECRYPTOR, &gatherSession, layout);
+        bench_run("in-place", BENCH_PATH_IN_PLACE, GstPluginNameWV, GST_TYPE_AAMPWIDEVINEDECRYPTOR, &inPlaceSession, layout);
+        bench_run("batch", BENCH_PATH_BATCH, GstPluginNameWV, GST_TYPE_AAMPWIDEVINEDECRYPTOR, &inPlaceSession, layout);
+        bench_run("parallel", BENCH_PATH_PARALLEL, GstPluginNameWV, GST_TYPE_AAMPWIDEVINEDECRYPTOR, &inPlaceSession, layout);
+        bench_run("local", BENCH_PATH_CLEARKEY, GstPluginNameCK, GST_TYPE_AAMPCLEARKEYDECRYPTOR, NULL, layout);
+    }
+    return 0;
+}
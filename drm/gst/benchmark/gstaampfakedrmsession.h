@@ -0,0 +1,170 @@
+/*
+* Copyright 2018 RDK Management
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Library General Public
+* License as published by the Free Software Foundation, version 2
+* of the license.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Library General Public License for more details.
+*
+* You should have received a copy of the GNU Library General Public
+* License along with this library; if not, write to the
+* Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file gstaampfakedrmsession.h
+ * @brief DRM sessions decrypting 'cenc' samples in software, for benchmarking the decryptors without a CDM
+ *
+ * The key is set on construction, no license is acquired. AampFakeDrmSession implements
+ * AampDrmSession::decrypt only, so samples take the gather/scatter path of the decryptor.
+ * AampFakeSubsampleDrmSession also implements the in place and batch interfaces.
+ */
+
+#ifndef _GST_AAMP_FAKE_DRM_SESSION_H_
+#define _GST_AAMP_FAKE_DRM_SESSION_H_
+
+#include <string.h>
+#include <string>
+#include "gstaampcdmidecryptor.h"
+#include "gstaampclearkeyengine.h"
+
+/**
+ * @class AampFakeDrmSession
+ * @brief AES-CTR session with a fixed key
+ */
+class AampFakeDrmSession : public AampDrmSession
+{
+public:
+    AampFakeDrmSession(const guint8 *kid, const guint8 *key) : AampDrmSession("org.aamp.benchmark"),
+            engine(gst_aamp_clearkey_engine_new())
+    {
+        memcpy(this->kid, kid, sizeof(this->kid));
+        gst_aamp_clearkey_engine_set_key(engine, kid, key);
+    }
+
+    virtual ~AampFakeDrmSession()
+    {
+        gst_aamp_clearkey_engine_free(engine);
+    }
+
+    void generateAampDRMSession(const uint8_t *f_pbInitData, uint32_t f_cbInitData, std::string &customData)
+    {
+    }
+
+    DrmData * aampGenerateKeyRequest(std::string& destinationURL, uint32_t timeout)
+    {
+        return NULL;
+    }
+
+    int aampDRMProcessKey(DrmData* key, uint32_t timeout)
+    {
+        return 0;
+    }
+
+    /**
+     * @brief Decrypts the encrypted bytes of a sample gathered into one key stream
+     */
+    int decrypt(const uint8_t *f_pbIV, uint32_t f_cbIV, const uint8_t *payloadData, uint32_t payloadDataSize,
+            uint8_t **ppOpaqueData)
+    {
+        return decryptRanges(f_pbIV, f_cbIV, const_cast<uint8_t *>(payloadData), payloadDataSize, NULL, 0);
+    }
+
+#if defined(USE_OPENCDM_ADAPTER)
+    int decrypt(GstBuffer* keyIDBuffer, GstBuffer* ivBuffer, GstBuffer* buffer, unsigned subSampleCount,
+            GstBuffer* subSamplesBuffer, GstCaps* caps = NULL)
+    {
+        GstMapInfo ivMap;
+        GstMapInfo map;
+        GstMapInfo subsamplesMap;
+        AampDecryptRange* ranges = NULL;
+        int result = -1;
+
+        if (!gst_buffer_map(ivBuffer, &ivMap, GST_MAP_READ))
+        {
+            return -1;
+        }
+        if (!gst_buffer_map(buffer, &map, GST_MAP_READWRITE))
+        {
+            gst_buffer_unmap(ivBuffer, &ivMap);
+            return -1;
+        }
+        if (subSampleCount && subSamplesBuffer && gst_buffer_map(subSamplesBuffer, &subsamplesMap, GST_MAP_READ))
+        {
+            ranges = g_new(AampDecryptRange, subSampleCount);
+            for (unsigned i = 0; i < subSampleCount && (i + 1) * 6 <= subsamplesMap.size; i++)
+            {
+                const guint8* entry = subsamplesMap.data + i * 6;
+                ranges[i].clearBytes = GST_READ_UINT16_BE(entry);
+                ranges[i].encryptedBytes = GST_READ_UINT32_BE(entry + 2);
+            }
+            gst_buffer_unmap(subSamplesBuffer, &subsamplesMap);
+        }
+        if (!subSampleCount || ranges)
+        {
+            result = decryptRanges(ivMap.data, ivMap.size, map.data, map.size, ranges, subSampleCount);
+        }
+        g_free(ranges);
+        gst_buffer_unmap(buffer, &map);
+        gst_buffer_unmap(ivBuffer, &ivMap);
+        return result;
+    }
+#endif
+
+    KeyState getState()
+    {
+        return KEY_READY;
+    }
+
+    void clearDecryptContext()
+    {
+    }
+
+protected:
+    int decryptRanges(const uint8_t *iv, uint32_t ivLen, uint8_t *data, uint32_t dataLen,
+            const AampDecryptRange *ranges, uint32_t rangeCount)
+    {
+        return gst_aamp_clearkey_engine_decrypt(engine, kid, sizeof(kid), GST_AAMP_CIPHER_CENC, iv, ivLen,
+                data, dataLen, ranges, rangeCount, 0, 0);
+    }
+
+private:
+    GstAampClearKeyEngine*  engine;
+    guint8                  kid[GST_AAMP_CLEARKEY_KEY_SIZE];
+};
+
+/**
+ * @class AampFakeSubsampleDrmSession
+ * @brief AES-CTR session with a fixed key, decrypting subsamples in place and in batches
+ */
+class AampFakeSubsampleDrmSession : public AampFakeDrmSession, public AampSubsampleDecryptor, public AampBatchDecryptor
+{
+public:
+    AampFakeSubsampleDrmSession(const guint8 *kid, const guint8 *key) : AampFakeDrmSession(kid, key)
+    {
+    }
+
+    int decryptSubsamples(const uint8_t *iv, uint32_t ivLen, uint8_t *data, uint32_t dataLen,
+            const AampDecryptRange *ranges, uint32_t rangeCount, uint8_t **ppOpaqueData)
+    {
+        return decryptRanges(iv, ivLen, data, dataLen, ranges, rangeCount);
+    }
+
+    int decryptBatch(AampDecryptSample *samples, uint32_t count)
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            samples[i].result = decryptRanges(samples[i].iv, samples[i].ivLen, samples[i].data,
+                    samples[i].dataLen, samples[i].ranges, samples[i].rangeCount);
+        }
+        return 0;
+    }
+};
+
+#endif /* _GST_AAMP_FAKE_DRM_SESSION_H_ */
@@ -24,7 +24,10 @@
 
 #include <gst/gst.h>
 #include <gst/base/gstbasetransform.h>
+#include <gst/base/gstbytereader.h>
 #include "gstaampcdmidecryptor.h"
+#include "gstaampdrmsessionregistry.h"
+#include "gstaampprotectionmeta.h"
 #include <open_cdm.h>
 #include <open_cdm_adapter.h>
 #if defined(AMLOGIC)
@@ -33,7 +36,6 @@
 #include <dlfcn.h>
 
 #ifndef USE_OPENCDM_ADAPTER
-#include <gst/base/gstbytereader.h>
 #ifdef USE_SAGE_SVP
 #include "gst_brcm_svp_meta.h"
 #ifdef USE_OPENCDM
@@ -50,14 +52,114 @@ struct Rpc_Secbuf_Info {
 #endif //USE_OPENCDM_ADAPTER
 
 #include <stdio.h>
+#include <stdlib.h>
 
 GST_DEBUG_CATEGORY_STATIC ( gst_aampcdmidecryptor_debug_category);
 #define GST_CAT_DEFAULT  gst_aampcdmidecryptor_debug_category
 #define DECRYPT_FAILURE_THRESHOLD 5
+#define SCRATCH_ALIGNMENT 64        // cache line, also satisfies SIMD loads in CDM backends
+#define SCRATCH_GRANULARITY 4096    // round arena growth to pages to avoid frequent reallocation
+#define CBCS_BLOCK_SIZE 16          // AES block, unit of the cbcs crypt/skip pattern
+#define CAPS_CACHE_SIZE 8           // distinct caps remembered, covers the renditions of an ABR ladder
+#define DEFAULT_BATCH_SIZE 1
+#define MAX_BATCH_SIZE 64
+#define MAX_KID_ENTRIES 8           // KIDs of an init data keying the shared session registry
+#define KID_SIZE 16
+#define DEFAULT_LICENSE_QUEUE_SIZE 16
+#define MAX_LICENSE_QUEUE_SIZE 256
+#define DEFAULT_DECRYPT_THREADS 0
+#define MAX_DECRYPT_THREADS 16
+#define DEFAULT_REORDER_WINDOW 8
+#define MAX_REORDER_WINDOW 256
 
 enum
 {
-    PROP_0, PROP_AAMP
+    PROP_0, PROP_AAMP, PROP_BATCH_SIZE, PROP_DECRYPT_THREADS, PROP_REORDER_WINDOW, PROP_LICENSE_QUEUE_SIZE, PROP_STATS
+};
+
+// upper bounds of the decrypt latency buckets in us, the last bucket is open ended
+static const guint64 gst_aampcdmidecryptor_latency_bounds[GST_AAMP_DECRYPT_LATENCY_BUCKETS - 1] =
+{
+    100, 250, 500, 1000, 2500, 5000, 10000
+};
+
+/**
+ * @struct AampCDMILicenseRequest
+ * @brief Session creation handed from the streaming thread to the license worker
+ */
+struct AampCDMILicenseRequest
+{
+    gchar*              systemId;
+    GBytes*             initData;       // as passed to createDrmSession, after the WideVine KID workaround
+    guint64             fingerprint;    // of the init data as received, see initDataFingerprint
+    gsize               receivedLength;
+    MediaType           streamtype;
+};
+
+/**
+ * @struct AampCDMIPendingSample
+ * @brief Encrypted sample held back for a batch decrypt call
+ */
+struct AampCDMIPendingSample
+{
+    GstBuffer*          buffer;
+    GstAampCDMISessionState* state;     // session the sample is decrypted with
+    AampCDMISampleInfo  info;
+    GstMapInfo          map;
+    AampDecryptRange*   ranges;
+    guint               rangeCount;
+    gboolean            done;           // parallel mode: set by the worker under workMutex
+    int                 errorCode;
+};
+
+/**
+ * @struct AampCDMICapsCacheEntry
+ * @brief Outcome of an earlier caps negotiation step for the same caps and direction
+ */
+struct AampCDMICapsCacheEntry
+{
+    GstPadDirection     direction;
+    GstCaps*            caps;
+    GstCaps*            transformed;    // unfiltered transform_caps result, NULL if not computed yet
+    gboolean            accepted;       // accept_caps succeeded
+};
+
+/**
+ * @struct AampCDMIWorkerScratch
+ * @brief Per worker thread gather/scatter buffer for parallel decryption
+ */
+struct AampCDMIWorkerScratch
+{
+    guint8*             data;
+    gsize               size;
+};
+
+static void gst_aampcdmidecryptor_free_worker_scratch(gpointer data)
+{
+    AampCDMIWorkerScratch* scratch = (AampCDMIWorkerScratch*) data;
+    g_free(scratch->data);
+    g_slice_free(AampCDMIWorkerScratch, scratch);
+}
+
+static GPrivate workerScratch = G_PRIVATE_INIT(gst_aampcdmidecryptor_free_worker_scratch);
+
+/**
+ * @struct GstAampCDMISessionState
+ * @brief Immutable, refcounted snapshot of the active DRM session and sink caps
+ *
+ * The decrypt path references the current snapshot under the read side of stateLock and
+ * calls into the CDM without holding the decryptor mutex. Session installation and caps
+ * changes publish a new snapshot under the write side; a replaced snapshot lives on until
+ * its last reader drops it.
+ */
+struct GstAampCDMISessionState
+{
+    gint                        refCount;
+    AampDrmSession*             drmSession;
+    AampSubsampleDecryptor*     subsampleDecryptor;
+    AampBatchDecryptor*         batchDecryptor;
+    AampPatternDecryptor*       patternDecryptor;
+    GstCaps*                    sinkCaps;
 };
 
 //#define FUNCTION_DEBUG 1
@@ -67,6 +169,18 @@ enum
 #define DEBUG_FUNC()
 #endif
 
+// GstProtectionMeta field names, interned in class_init
+static GQuark quarkIvSize;
+static GQuark quarkEncrypted;
+static GQuark quarkSubsampleCount;
+static GQuark quarkIv;
+static GQuark quarkConstantIv;
+static GQuark quarkKid;
+static GQuark quarkSubsamples;
+static GQuark quarkCipherMode;
+static GQuark quarkCryptByteBlock;
+static GQuark quarkSkipByteBlock;
+
 static const gchar *srcMimeTypes[] = { "video/x-h264", "video/x-h264(memory:SecMem)", "audio/mpeg", "video/x-h265", "video/x-h265(memory:SecMem)", "audio/x-eac3", "audio/x-gst-fourcc-ec_3", nullptr };
 
 /* prototypes */
@@ -84,6 +198,21 @@ static void gst_aampcdmidecryptor_set_property(GObject * object,
         guint prop_id, const GValue * value, GParamSpec * pspec);
 static gboolean gst_aampcdmidecryptor_accept_caps(GstBaseTransform * trans,
         GstPadDirection direction, GstCaps * caps);
+static void gst_aampcdmidecryptor_get_property(GObject * object,
+        guint prop_id, GValue * value, GParamSpec * pspec);
+static GstFlowReturn gst_aampcdmidecryptor_submit_input_buffer(
+        GstBaseTransform * trans, gboolean is_discont, GstBuffer * input);
+static GstFlowReturn gst_aampcdmidecryptor_generate_output(
+        GstBaseTransform * trans, GstBuffer ** outbuf);
+static GstFlowReturn gst_aampcdmidecryptor_drain(GstAampCDMIDecryptor * aampcdmidecryptor);
+static GstFlowReturn gst_aampcdmidecryptor_decrypt_result(GstAampCDMIDecryptor * aampcdmidecryptor, int errorCode);
+static void gst_aampcdmidecryptor_discard_pending(GstAampCDMIDecryptor * aampcdmidecryptor);
+static void gst_aampcdmidecryptor_caps_cache_clear(GstAampCDMIDecryptor * aampcdmidecryptor);
+static gboolean gst_aampcdmidecryptor_query(GstBaseTransform * trans, GstPadDirection direction, GstQuery * query);
+static void gst_aampcdmidecryptor_state_publish(GstAampCDMIDecryptor * aampcdmidecryptor);
+static GstAampCDMISessionState* gst_aampcdmidecryptor_state_get(GstAampCDMIDecryptor * aampcdmidecryptor);
+static void gst_aampcdmidecryptor_state_unref(GstAampCDMISessionState * state);
+static void gst_aampcdmidecryptor_lock_decrypt(GstAampCDMIDecryptor * aampcdmidecryptor);
 static OpenCDMError(*OCDMGstTransformCaps)(GstCaps **);
 
 
@@ -102,12 +231,53 @@ static void gst_aampcdmidecryptor_class_init(
     GstBaseTransformClass *base_transform_class = GST_BASE_TRANSFORM_CLASS(klass);
 
     gobject_class->set_property = gst_aampcdmidecryptor_set_property;
+    gobject_class->get_property = gst_aampcdmidecryptor_get_property;
     gobject_class->dispose = gst_aampcdmidecryptor_dispose;
 
+    quarkIvSize = g_quark_from_static_string("iv_size");
+    quarkEncrypted = g_quark_from_static_string("encrypted");
+    quarkSubsampleCount = g_quark_from_static_string("subsample_count");
+    quarkIv = g_quark_from_static_string("iv");
+    quarkConstantIv = g_quark_from_static_string("constant_iv");
+    quarkKid = g_quark_from_static_string("kid");
+    quarkSubsamples = g_quark_from_static_string("subsamples");
+    quarkCipherMode = g_quark_from_static_string("cipher-mode");
+    quarkCryptByteBlock = g_quark_from_static_string("crypt_byte_block");
+    quarkSkipByteBlock = g_quark_from_static_string("skip_byte_block");
+
     g_object_class_install_property(gobject_class, PROP_AAMP,
             g_param_spec_pointer("aamp", "AAMP",
                     "AAMP instance to do profiling", G_PARAM_WRITABLE));
 
+    g_object_class_install_property(gobject_class, PROP_BATCH_SIZE,
+            g_param_spec_uint("batch-size", "Batch size",
+                    "Encrypted samples sharing a key decrypted per call when the DRM session supports batching, 1 disables batching",
+                    1, MAX_BATCH_SIZE, DEFAULT_BATCH_SIZE, G_PARAM_READWRITE));
+
+    g_object_class_install_property(gobject_class, PROP_DECRYPT_THREADS,
+            g_param_spec_uint("decrypt-threads", "Decrypt threads",
+                    "Worker threads decrypting samples in parallel, output order is kept. "
+                    "The DRM session must allow concurrent decrypt calls. 0 decrypts on the streaming thread",
+                    0, MAX_DECRYPT_THREADS, DEFAULT_DECRYPT_THREADS, G_PARAM_READWRITE));
+
+    g_object_class_install_property(gobject_class, PROP_REORDER_WINDOW,
+            g_param_spec_uint("reorder-window", "Reorder window",
+                    "Maximum samples in flight when decrypt-threads is set",
+                    1, MAX_REORDER_WINDOW, DEFAULT_REORDER_WINDOW, G_PARAM_READWRITE));
+
+    g_object_class_install_property(gobject_class, PROP_LICENSE_QUEUE_SIZE,
+            g_param_spec_uint("license-queue-size", "License queue size",
+                    "Encrypted samples held while the DRM session is created on a worker thread. "
+                    "0 creates the session on the streaming thread",
+                    0, MAX_LICENSE_QUEUE_SIZE, DEFAULT_LICENSE_QUEUE_SIZE, G_PARAM_READWRITE));
+
+    g_object_class_install_property(gobject_class, PROP_STATS,
+            g_param_spec_boxed("stats", "Statistics",
+                    "Decryption counters: samples and bytes, subsample count and decrypt latency "
+                    "histograms, time spent waiting for keys, failures, decrypt path allocations and "
+                    "lock contention",
+                    GST_TYPE_STRUCTURE, G_PARAM_READABLE));
+
     GST_ELEMENT_CLASS(klass)->change_state =
             gst_aampcdmidecryptor_changestate;
 
@@ -117,6 +287,12 @@ static void gst_aampcdmidecryptor_class_init(
             gst_aampcdmidecryptor_sink_event);
     base_transform_class->transform_ip = GST_DEBUG_FUNCPTR(
             gst_aampcdmidecryptor_transform_ip);
+    base_transform_class->query = GST_DEBUG_FUNCPTR(
+            gst_aampcdmidecryptor_query);
+    base_transform_class->submit_input_buffer = GST_DEBUG_FUNCPTR(
+            gst_aampcdmidecryptor_submit_input_buffer);
+    base_transform_class->generate_output = GST_DEBUG_FUNCPTR(
+            gst_aampcdmidecryptor_generate_output);
 
 #if !defined(AMLOGIC)
     base_transform_class->accept_caps = GST_DEBUG_FUNCPTR(
@@ -147,11 +323,25 @@ static void gst_aampcdmidecryptor_init(
     g_mutex_init(&aampcdmidecryptor->mutex);
     //GST_DEBUG_OBJECT(aampcdmidecryptor, "\n Initialized plugin mutex\n");
     g_cond_init(&aampcdmidecryptor->condition);
+    g_rw_lock_init(&aampcdmidecryptor->stateLock);
+    aampcdmidecryptor->sessionState = NULL;
     aampcdmidecryptor->streamReceived = false;
     aampcdmidecryptor->canWait = false;
     aampcdmidecryptor->protectionEvent = NULL;
+    aampcdmidecryptor->initDataFingerprint = 0;
+    aampcdmidecryptor->initDataLength = 0;
     aampcdmidecryptor->sessionManager = NULL;
     aampcdmidecryptor->drmSession = NULL;
+    aampcdmidecryptor->subsampleDecryptor = NULL;
+    aampcdmidecryptor->batchDecryptor = NULL;
+    aampcdmidecryptor->patternDecryptor = NULL;
+    aampcdmidecryptor->hostOutput = FALSE;
+    aampcdmidecryptor->localDecrypt = FALSE;
+    aampcdmidecryptor->sessionShare = NULL;
+    aampcdmidecryptor->licenseQueueSize = DEFAULT_LICENSE_QUEUE_SIZE;
+    aampcdmidecryptor->licensePending = 0;
+    aampcdmidecryptor->licenseWorker = NULL;
+    g_queue_init(&aampcdmidecryptor->licenseWait);
     aampcdmidecryptor->aamp = NULL;
     aampcdmidecryptor->streamtype = eMEDIATYPE_MANIFEST;
     aampcdmidecryptor->firstsegprocessed = false;
@@ -163,6 +353,25 @@ static void gst_aampcdmidecryptor_init(
     aampcdmidecryptor->ignoreSVP = false;
     aampcdmidecryptor->sinkCaps = NULL;
     aampcdmidecryptor->svpCtx = NULL;
+    aampcdmidecryptor->scratch = NULL;
+    aampcdmidecryptor->scratchSize = 0;
+    aampcdmidecryptor->ranges = NULL;
+    aampcdmidecryptor->rangesSize = 0;
+    aampcdmidecryptor->batchSize = DEFAULT_BATCH_SIZE;
+    g_queue_init(&aampcdmidecryptor->pending);
+    g_queue_init(&aampcdmidecryptor->ready);
+    aampcdmidecryptor->decryptThreads = DEFAULT_DECRYPT_THREADS;
+    aampcdmidecryptor->reorderWindow = DEFAULT_REORDER_WINDOW;
+    aampcdmidecryptor->workers = NULL;
+    g_queue_init(&aampcdmidecryptor->inflight);
+    g_mutex_init(&aampcdmidecryptor->workMutex);
+    g_mutex_init(&aampcdmidecryptor->statsMutex);
+    memset(&aampcdmidecryptor->stats, 0, sizeof(aampcdmidecryptor->stats));
+    g_mutex_init(&aampcdmidecryptor->capsCacheMutex);
+    g_queue_init(&aampcdmidecryptor->capsCache);
+    g_cond_init(&aampcdmidecryptor->workDone);
+    // readers always find a snapshot, the first one without session
+    gst_aampcdmidecryptor_state_publish(aampcdmidecryptor);
 
     OCDMGstTransformCaps = (OpenCDMError(*)(GstCaps**))dlsym(RTLD_DEFAULT, ocdmgsttransformcaps);
     if (OCDMGstTransformCaps)
@@ -192,6 +401,38 @@ void gst_aampcdmidecryptor_dispose(GObject * object)
         aampcdmidecryptor->sinkCaps = NULL;
     }
 
+    if (aampcdmidecryptor->scratch)
+    {
+        free(aampcdmidecryptor->scratch);
+        aampcdmidecryptor->scratch = NULL;
+        aampcdmidecryptor->scratchSize = 0;
+    }
+    g_free(aampcdmidecryptor->ranges);
+    aampcdmidecryptor->ranges = NULL;
+    aampcdmidecryptor->rangesSize = 0;
+    if (aampcdmidecryptor->licenseWorker)
+    {
+        g_thread_pool_free(aampcdmidecryptor->licenseWorker, FALSE, TRUE);
+        aampcdmidecryptor->licenseWorker = NULL;
+    }
+    gst_aampcdmidecryptor_discard_pending(aampcdmidecryptor);
+    if (aampcdmidecryptor->workers)
+    {
+        g_thread_pool_free(aampcdmidecryptor->workers, FALSE, TRUE);
+        aampcdmidecryptor->workers = NULL;
+    }
+    g_mutex_clear(&aampcdmidecryptor->workMutex);
+    g_mutex_clear(&aampcdmidecryptor->statsMutex);
+    gst_aampcdmidecryptor_caps_cache_clear(aampcdmidecryptor);
+    g_mutex_clear(&aampcdmidecryptor->capsCacheMutex);
+    g_cond_clear(&aampcdmidecryptor->workDone);
+    gst_aamp_drm_session_share_release(aampcdmidecryptor->sessionShare);
+    aampcdmidecryptor->sessionShare = NULL;
+
+    gst_aampcdmidecryptor_state_unref(aampcdmidecryptor->sessionState);
+    aampcdmidecryptor->sessionState = NULL;
+    g_rw_lock_clear(&aampcdmidecryptor->stateLock);
+
     g_mutex_clear(&aampcdmidecryptor->mutex);
     g_cond_clear(&aampcdmidecryptor->condition);
 
@@ -221,48 +462,129 @@ static void gst_aampcdmicapsappendifnotduplicate(GstCaps* destCaps,
         gst_structure_free(cap);
 }
 
-static GstCaps *
-gst_aampcdmidecryptor_transform_caps(GstBaseTransform * trans,
-        GstPadDirection direction, GstCaps * caps, GstCaps * filter)
+/*
+ Finds the cache entry for caps in direction and makes it the most recently used.
+ Called with capsCacheMutex held.
+ */
+static AampCDMICapsCacheEntry* gst_aampcdmidecryptor_caps_cache_find(GstAampCDMIDecryptor* aampcdmidecryptor,
+        GstPadDirection direction, GstCaps* caps)
 {
-    DEBUG_FUNC();
-	GstAampCDMIDecryptor *aampcdmidecryptor = GST_AAMP_CDMI_DECRYPTOR(trans);
-    g_return_val_if_fail(direction != GST_PAD_UNKNOWN, NULL);
-    unsigned size = gst_caps_get_size(caps);
-    GstCaps* transformedCaps = gst_caps_new_empty();
-
-    GST_DEBUG_OBJECT(trans, "direction: %s, caps: %" GST_PTR_FORMAT " filter:"
-            " %" GST_PTR_FORMAT, (direction == GST_PAD_SRC) ? "src" : "sink", caps, filter);
-
-    if(!aampcdmidecryptor->selectedProtection)
+    for (GList* l = aampcdmidecryptor->capsCache.head; l; l = l->next)
     {
-        GstStructure *capstruct = gst_caps_get_structure(caps, 0);
-        const gchar* capsinfo = gst_structure_get_string(capstruct, "protection-system");
-        if(capsinfo != NULL)
+        AampCDMICapsCacheEntry* entry = (AampCDMICapsCacheEntry*) l->data;
+        if (entry->direction == direction
+                && (entry->caps == caps || gst_caps_is_strictly_equal(entry->caps, caps)))
         {
-            if(!g_strcmp0(capsinfo, PLAYREADY_PROTECTION_SYSTEM_ID))
-            {
-                aampcdmidecryptor->selectedProtection = PLAYREADY_PROTECTION_SYSTEM_ID;
-            }
-            else if(!g_strcmp0(capsinfo, WIDEVINE_PROTECTION_SYSTEM_ID))
-            {
-                aampcdmidecryptor->selectedProtection = WIDEVINE_PROTECTION_SYSTEM_ID;
-            }
-            else if(!g_strcmp0(capsinfo, CLEARKEY_PROTECTION_SYSTEM_ID))
-            {
-                 aampcdmidecryptor->selectedProtection = CLEARKEY_PROTECTION_SYSTEM_ID;
-                 aampcdmidecryptor->ignoreSVP = true;
-            }
-            else if(!g_strcmp0(capsinfo, VERIMATRIX_PROTECTION_SYSTEM_ID))
+            if (l != aampcdmidecryptor->capsCache.head)
             {
-                aampcdmidecryptor->selectedProtection = VERIMATRIX_PROTECTION_SYSTEM_ID;
+                g_queue_unlink(&aampcdmidecryptor->capsCache, l);
+                g_queue_push_head_link(&aampcdmidecryptor->capsCache, l);
             }
+            return entry;
         }
-        else
+    }
+    return NULL;
+}
+
+static void gst_aampcdmidecryptor_caps_cache_entry_free(AampCDMICapsCacheEntry* entry)
+{
+    gst_caps_unref(entry->caps);
+    if (entry->transformed)
+    {
+        gst_caps_unref(entry->transformed);
+    }
+    g_slice_free(AampCDMICapsCacheEntry, entry);
+}
+
+/*
+ Returns the cache entry for caps in direction, adding it and evicting the least recently
+ used entry beyond CAPS_CACHE_SIZE if not cached yet. Called with capsCacheMutex held.
+ */
+static AampCDMICapsCacheEntry* gst_aampcdmidecryptor_caps_cache_add(GstAampCDMIDecryptor* aampcdmidecryptor,
+        GstPadDirection direction, GstCaps* caps)
+{
+    AampCDMICapsCacheEntry* entry = gst_aampcdmidecryptor_caps_cache_find(aampcdmidecryptor, direction, caps);
+    if (!entry)
+    {
+        entry = g_slice_new0(AampCDMICapsCacheEntry);
+        entry->direction = direction;
+        entry->caps = gst_caps_ref(caps);
+        g_queue_push_head(&aampcdmidecryptor->capsCache, entry);
+        while (g_queue_get_length(&aampcdmidecryptor->capsCache) > CAPS_CACHE_SIZE)
         {
-            GST_DEBUG_OBJECT(trans, "can't find protection-system field from caps: %" GST_PTR_FORMAT, caps);
+            gst_aampcdmidecryptor_caps_cache_entry_free((AampCDMICapsCacheEntry*) g_queue_pop_tail(&aampcdmidecryptor->capsCache));
+        }
+    }
+    return entry;
+}
+
+/*
+ Forgets all cached negotiation results.
+ */
+static void gst_aampcdmidecryptor_caps_cache_clear(GstAampCDMIDecryptor* aampcdmidecryptor)
+{
+    g_mutex_lock(&aampcdmidecryptor->capsCacheMutex);
+    g_queue_free_full(&aampcdmidecryptor->capsCache, (GDestroyNotify) gst_aampcdmidecryptor_caps_cache_entry_free);
+    g_queue_init(&aampcdmidecryptor->capsCache);
+    g_mutex_unlock(&aampcdmidecryptor->capsCacheMutex);
+}
+
+/*
+ Checks if cbcs samples can be decrypted: in element with keys of the subclass, or by a DRM
+ session implementing AampPatternDecryptor.
+ */
+static gboolean gst_aampcdmidecryptor_can_decrypt_cbcs(GstAampCDMIDecryptor* aampcdmidecryptor)
+{
+    if (aampcdmidecryptor->localDecrypt && GST_AAMP_CDMI_DECRYPTOR_GET_CLASS(aampcdmidecryptor)->local_decrypt)
+    {
+        return TRUE;
+    }
+    GstAampCDMISessionState* state = gst_aampcdmidecryptor_state_get(aampcdmidecryptor);
+    gboolean pattern = (state->patternDecryptor != NULL);
+    gst_aampcdmidecryptor_state_unref(state);
+    return pattern;
+}
+
+/*
+ Returns caps with an application/x-cbcs copy of each application/x-cenc structure of caps.
+ */
+static GstCaps* gst_aampcdmidecryptor_add_cbcs(GstCaps* caps)
+{
+    GstCaps* result = gst_caps_copy(caps);
+
+    for (guint i = 0; i < gst_caps_get_size(caps); i++)
+    {
+        GstStructure* structure = gst_caps_get_structure(caps, i);
+        if (gst_structure_has_name(structure, "application/x-cenc"))
+        {
+            GstStructure* cbcs = gst_structure_copy(structure);
+            gst_structure_set_name(cbcs, "application/x-cbcs");
+            gst_aampcdmicapsappendifnotduplicate(result, cbcs);
         }
     }
+    return result;
+}
+
+void gst_aampcdmidecryptor_set_local_decrypt(GstAampCDMIDecryptor* aampcdmidecryptor, gboolean enabled)
+{
+    if (aampcdmidecryptor->localDecrypt == enabled)
+    {
+        return;
+    }
+    aampcdmidecryptor->localDecrypt = enabled;
+    // cbcs sink caps come and go with the keys
+    gst_aampcdmidecryptor_caps_cache_clear(aampcdmidecryptor);
+    gst_pad_push_event(GST_BASE_TRANSFORM_SINK_PAD(aampcdmidecryptor), gst_event_new_reconfigure());
+}
+
+/*
+ Transforms caps structure by structure, see gst_aampcdmidecryptor_transform_caps().
+ */
+static GstCaps* gst_aampcdmidecryptor_build_caps(GstAampCDMIDecryptor* aampcdmidecryptor,
+        GstPadDirection direction, GstCaps* caps)
+{
+    unsigned size = gst_caps_get_size(caps);
+    GstCaps* transformedCaps = gst_caps_new_empty();
 
     for (unsigned i = 0; i < size; ++i)
     {
@@ -307,12 +629,22 @@ gst_aampcdmidecryptor_transform_caps(GstBaseTransform * trans,
 
             gst_structure_set_name(out, "application/x-cenc");
 
+            // cbcs protected streams decrypt to the same formats when keys are set for in
+            // element decryption, DRM sessions lack the cipher mode unless they implement
+            // AampPatternDecryptor
+            if (gst_aampcdmidecryptor_can_decrypt_cbcs(aampcdmidecryptor))
+            {
+                GstStructure* cbcs = gst_structure_copy(out);
+                gst_structure_set_name(cbcs, "application/x-cbcs");
+                gst_aampcdmicapsappendifnotduplicate(transformedCaps, cbcs);
+            }
+
         }
         else
         {
             if (!gst_structure_has_field(in, "original-media-type"))
             {
-                GST_DEBUG_OBJECT(trans, "No original-media-type field in caps: %" GST_PTR_FORMAT, out);
+                GST_DEBUG_OBJECT(aampcdmidecryptor, "No original-media-type field in caps: %" GST_PTR_FORMAT, out);
 
                 // BCOM-4645: Check if these caps are present in supported src pad caps in case direction is GST_PAD_SINK,
                 // we can allow caps in this case, since plugin will let the data passthrough
@@ -363,6 +695,79 @@ gst_aampcdmidecryptor_transform_caps(GstBaseTransform * trans,
 		OCDMGstTransformCaps(&transformedCaps);
 #endif
     }
+    return transformedCaps;
+}
+
+static GstCaps *
+gst_aampcdmidecryptor_transform_caps(GstBaseTransform * trans,
+        GstPadDirection direction, GstCaps * caps, GstCaps * filter)
+{
+    DEBUG_FUNC();
+	GstAampCDMIDecryptor *aampcdmidecryptor = GST_AAMP_CDMI_DECRYPTOR(trans);
+    g_return_val_if_fail(direction != GST_PAD_UNKNOWN, NULL);
+    GstCaps* transformedCaps = NULL;
+
+    GST_DEBUG_OBJECT(trans, "direction: %s, caps: %" GST_PTR_FORMAT " filter:"
+            " %" GST_PTR_FORMAT, (direction == GST_PAD_SRC) ? "src" : "sink", caps, filter);
+
+    if(!aampcdmidecryptor->selectedProtection)
+    {
+        GstStructure *capstruct = gst_caps_get_structure(caps, 0);
+        const gchar* capsinfo = gst_structure_get_string(capstruct, "protection-system");
+        if(capsinfo != NULL)
+        {
+            if(!g_strcmp0(capsinfo, PLAYREADY_PROTECTION_SYSTEM_ID))
+            {
+                aampcdmidecryptor->selectedProtection = PLAYREADY_PROTECTION_SYSTEM_ID;
+            }
+            else if(!g_strcmp0(capsinfo, WIDEVINE_PROTECTION_SYSTEM_ID))
+            {
+                aampcdmidecryptor->selectedProtection = WIDEVINE_PROTECTION_SYSTEM_ID;
+            }
+            else if(!g_strcmp0(capsinfo, CLEARKEY_PROTECTION_SYSTEM_ID))
+            {
+                 aampcdmidecryptor->selectedProtection = CLEARKEY_PROTECTION_SYSTEM_ID;
+                 aampcdmidecryptor->ignoreSVP = true;
+            }
+            else if(!g_strcmp0(capsinfo, VERIMATRIX_PROTECTION_SYSTEM_ID))
+            {
+                aampcdmidecryptor->selectedProtection = VERIMATRIX_PROTECTION_SYSTEM_ID;
+            }
+        }
+        else
+        {
+            GST_DEBUG_OBJECT(trans, "can't find protection-system field from caps: %" GST_PTR_FORMAT, caps);
+        }
+    }
+
+    if (direction == GST_PAD_SINK || aampcdmidecryptor->selectedProtection)
+    {
+        g_mutex_lock(&aampcdmidecryptor->capsCacheMutex);
+        AampCDMICapsCacheEntry* entry = gst_aampcdmidecryptor_caps_cache_find(aampcdmidecryptor, direction, caps);
+        if (entry && entry->transformed)
+        {
+            transformedCaps = gst_caps_ref(entry->transformed);
+        }
+        g_mutex_unlock(&aampcdmidecryptor->capsCacheMutex);
+
+        if (!transformedCaps)
+        {
+            transformedCaps = gst_aampcdmidecryptor_build_caps(aampcdmidecryptor, direction, caps);
+            g_mutex_lock(&aampcdmidecryptor->capsCacheMutex);
+            entry = gst_aampcdmidecryptor_caps_cache_add(aampcdmidecryptor, direction, caps);
+            gst_caps_replace(&entry->transformed, transformedCaps);
+            g_mutex_unlock(&aampcdmidecryptor->capsCacheMutex);
+        }
+        else
+        {
+            GST_LOG_OBJECT(trans, "transformed caps from cache");
+        }
+    }
+    else
+    {
+        // source caps depend on the protection system, not known yet
+        transformedCaps = gst_aampcdmidecryptor_build_caps(aampcdmidecryptor, direction, caps);
+    }
 
     if (filter)
     {
@@ -379,299 +784,827 @@ gst_aampcdmidecryptor_transform_caps(GstBaseTransform * trans,
     if (direction == GST_PAD_SINK && !gst_caps_is_empty(transformedCaps))
     {
         g_mutex_lock(&aampcdmidecryptor->mutex);
-        // clean up previous caps
-        if (aampcdmidecryptor->sinkCaps)
+        // caps are not modified once returned, share them instead of copying;
+        // cached caps returned again leave sinkCaps as is
+        if (aampcdmidecryptor->sinkCaps != transformedCaps)
         {
-            gst_caps_unref(aampcdmidecryptor->sinkCaps);
-            aampcdmidecryptor->sinkCaps = NULL;
+            gst_caps_replace(&aampcdmidecryptor->sinkCaps, transformedCaps);
+            gst_aampcdmidecryptor_state_publish(aampcdmidecryptor);
+            GST_DEBUG_OBJECT(trans, "Set sinkCaps to %" GST_PTR_FORMAT, aampcdmidecryptor->sinkCaps);
         }
-        aampcdmidecryptor->sinkCaps = gst_caps_copy(transformedCaps);
         g_mutex_unlock(&aampcdmidecryptor->mutex);
-        GST_DEBUG_OBJECT(trans, "Set sinkCaps to %" GST_PTR_FORMAT, aampcdmidecryptor->sinkCaps);
     }
     return transformedCaps;
 }
 
-#ifdef USE_OPENCDM_ADAPTER
-
-static GstFlowReturn gst_aampcdmidecryptor_transform_ip(
-        GstBaseTransform * trans, GstBuffer * buffer)
+/*
+ Extracts key ids from a pssh box: the KID list of version 1 boxes and, for Widevine,
+ the key_id fields of the protobuf payload. Returns the number of KIDs stored in kids.
+ */
+static guint gst_aampcdmidecryptor_parse_kids(const guint8* initData, gsize len,
+        guint8 kids[][KID_SIZE], guint maxKids)
 {
-    DEBUG_FUNC();
-
-    GstAampCDMIDecryptor *aampcdmidecryptor =
-            GST_AAMP_CDMI_DECRYPTOR(trans);
-
-    GstFlowReturn result = GST_FLOW_OK;
-
-    guint subSampleCount;
-    guint ivSize;
-    gboolean encrypted;
-    const GValue* value;
-    GstBuffer* ivBuffer = NULL;
-    GstBuffer* keyIDBuffer = NULL;
-    GstBuffer* subsamplesBuffer = NULL;
-    GstMapInfo subSamplesMap;
-    GstProtectionMeta* protectionMeta = NULL;
-    gboolean mutexLocked = FALSE;
-    int errorCode;
-
-    GST_DEBUG_OBJECT(aampcdmidecryptor, "Processing buffer");
-
-    if (!buffer)
+    static const guint8 widevineSystemId[KID_SIZE] = { 0xed, 0xef, 0x8b, 0xa9, 0x79, 0xd6, 0x4a, 0xce,
+            0xa3, 0xc8, 0x27, 0xdc, 0xd5, 0x1d, 0x21, 0xed };
+    GstByteReader reader;
+    guint32 boxSize = 0;
+    guint32 boxType = 0;
+    guint8 version = 0;
+    guint32 kidCount = 0;
+    guint32 dataSize = 0;
+    const guint8* systemId = NULL;
+    const guint8* data = NULL;
+    guint count = 0;
+
+    gst_byte_reader_init(&reader, initData, len);
+    if (!gst_byte_reader_get_uint32_be(&reader, &boxSize)
+            || !gst_byte_reader_get_uint32_le(&reader, &boxType)
+            || boxType != GST_MAKE_FOURCC('p','s','s','h')
+            || !gst_byte_reader_get_uint8(&reader, &version)
+            || !gst_byte_reader_skip(&reader, 3)
+            || !gst_byte_reader_get_data(&reader, KID_SIZE, &systemId))
     {
-        GST_ERROR_OBJECT(aampcdmidecryptor,"Failed to get writable buffer");
-        result = GST_FLOW_NOT_SUPPORTED;
-        goto free_resources;
+        return 0;
     }
 
-    protectionMeta =
-            reinterpret_cast<GstProtectionMeta*>(gst_buffer_get_protection_meta(buffer));
-
-    if (!protectionMeta)
+    if (version > 0 && gst_byte_reader_get_uint32_be(&reader, &kidCount))
     {
-        GST_DEBUG_OBJECT(aampcdmidecryptor,
-                "Failed to get GstProtection metadata from buffer %p, could be clear buffer",buffer);
-#if defined(AMLOGIC)
-        // call decrypt even for clear samples in order to copy it to a secure buffer. If secure buffers are not supported
-        // decrypt() call will return without doing anything
-	if (aampcdmidecryptor->drmSession != NULL)
-		errorCode = aampcdmidecryptor->drmSession->decrypt(keyIDBuffer, ivBuffer, buffer, subSampleCount, subsamplesBuffer, aampcdmidecryptor->sinkCaps);
-	else
-	{ /* If drmSession creation failed, then the call will be aborted here */
-		result = GST_FLOW_NOT_SUPPORTED;
-		GST_DEBUG_OBJECT(aampcdmidecryptor, "drmSession is **** NULL ****, returning GST_FLOW_NOT_SUPPORTED");
-	}
-#endif
-        goto free_resources;
+        const guint8* kid;
+        for (guint32 i = 0; i < kidCount && gst_byte_reader_get_data(&reader, KID_SIZE, &kid); i++)
+        {
+            if (count < maxKids)
+            {
+                memcpy(kids[count++], kid, KID_SIZE);
+            }
+        }
     }
 
-    g_mutex_lock(&aampcdmidecryptor->mutex);
-    mutexLocked = TRUE;
-    GST_TRACE_OBJECT(aampcdmidecryptor,
-            "Mutex acquired, stream received: %s canWait: %d",
-            aampcdmidecryptor->streamReceived ? "yes" : "no", aampcdmidecryptor->canWait);
-
-    if (!aampcdmidecryptor->canWait
-            && !aampcdmidecryptor->streamReceived)
+    if (!memcmp(systemId, widevineSystemId, KID_SIZE)
+            && gst_byte_reader_get_uint32_be(&reader, &dataSize)
+            && gst_byte_reader_get_data(&reader, dataSize, &data))
     {
-        result = GST_FLOW_NOT_SUPPORTED;
-        goto free_resources;
-    }
+        // WidevinePsshData: key_id is field 2, length delimited
+        GstByteReader pb;
+        gst_byte_reader_init(&pb, data, dataSize);
+        while (gst_byte_reader_get_remaining(&pb))
+        {
+            guint64 tag = 0;
+            guint64 fieldLen = 0;
+            guint8 byte = 0;
+            guint shift = 0;
+            do
+            {
+                if (!gst_byte_reader_get_uint8(&pb, &byte) || shift > 63)
+                    return count;
+                tag |= (guint64)(byte & 0x7f) << shift;
+                shift += 7;
+            } while (byte & 0x80);
 
-    if (!aampcdmidecryptor->firstsegprocessed)
-    {
-        GST_DEBUG_OBJECT(aampcdmidecryptor, "\n\nWaiting for key\n");
+            if ((tag & 0x7) == 0)
+            {
+                do
+                {
+                    if (!gst_byte_reader_get_uint8(&pb, &byte))
+                        return count;
+                } while (byte & 0x80);
+                continue;
+            }
+            if ((tag & 0x7) != 2)
+            {
+                break;
+            }
+            shift = 0;
+            do
+            {
+                if (!gst_byte_reader_get_uint8(&pb, &byte) || shift > 63)
+                    return count;
+                fieldLen |= (guint64)(byte & 0x7f) << shift;
+                shift += 7;
+            } while (byte & 0x80);
+
+            const guint8* field = NULL;
+            if (fieldLen > G_MAXUINT32 || !gst_byte_reader_get_data(&pb, (guint)fieldLen, &field))
+            {
+                break;
+            }
+            if ((tag >> 3) == 2 && fieldLen == KID_SIZE && count < maxKids)
+            {
+                memcpy(kids[count++], field, KID_SIZE);
+            }
+        }
     }
-    // The key might not have been received yet. Wait for it.
-    if (!aampcdmidecryptor->streamReceived)
-        g_cond_wait(&aampcdmidecryptor->condition,
-                &aampcdmidecryptor->mutex);
+    return count;
+}
 
-    if (!aampcdmidecryptor->streamReceived)
-    {
-        GST_DEBUG_OBJECT(aampcdmidecryptor,
-                "Condition signaled from state change transition. Aborting.");
-        result = GST_FLOW_NOT_SUPPORTED;
-        goto free_resources;
+/*
+ Returns a reference to the current session snapshot.
+ */
+static GstAampCDMISessionState* gst_aampcdmidecryptor_state_get(GstAampCDMIDecryptor* aampcdmidecryptor)
+{
+    g_rw_lock_reader_lock(&aampcdmidecryptor->stateLock);
+    GstAampCDMISessionState* state = aampcdmidecryptor->sessionState;
+    g_atomic_int_inc(&state->refCount);
+    g_rw_lock_reader_unlock(&aampcdmidecryptor->stateLock);
+    return state;
+}
+
+static void gst_aampcdmidecryptor_state_unref(GstAampCDMISessionState* state)
+{
+    if (state && g_atomic_int_dec_and_test(&state->refCount))
+    {
+        if (state->sinkCaps)
+        {
+            gst_caps_unref(state->sinkCaps);
+        }
+        g_slice_free(GstAampCDMISessionState, state);
     }
+}
+
+/*
+ Publishes a snapshot of the current session and sink caps. Called with mutex held.
+ */
+static void gst_aampcdmidecryptor_state_publish(GstAampCDMIDecryptor* aampcdmidecryptor)
+{
+    GstAampCDMISessionState* state = g_slice_new0(GstAampCDMISessionState);
+    state->refCount = 1;
+    state->drmSession = aampcdmidecryptor->drmSession;
+    state->subsampleDecryptor = aampcdmidecryptor->subsampleDecryptor;
+    state->batchDecryptor = aampcdmidecryptor->batchDecryptor;
+    state->patternDecryptor = aampcdmidecryptor->patternDecryptor;
+    state->sinkCaps = aampcdmidecryptor->sinkCaps ? gst_caps_ref(aampcdmidecryptor->sinkCaps) : NULL;
+
+    g_rw_lock_writer_lock(&aampcdmidecryptor->stateLock);
+    GstAampCDMISessionState* old = aampcdmidecryptor->sessionState;
+    aampcdmidecryptor->sessionState = state;
+    g_rw_lock_writer_unlock(&aampcdmidecryptor->stateLock);
+
+    gst_aampcdmidecryptor_state_unref(old);
+}
 
-    /* If drmSession creation failed, then the call will be aborted here */
-    if (aampcdmidecryptor->drmSession == NULL)
+/*
+ Makes session the one decrypting samples, probing the optional decrypt interfaces it
+ implements, and publishes the new state. Called with mutex held.
+ */
+static void gst_aampcdmidecryptor_install_session(GstAampCDMIDecryptor* aampcdmidecryptor,
+        AampDrmSession* session)
+{
+    gboolean pattern = (aampcdmidecryptor->patternDecryptor != NULL);
+
+    aampcdmidecryptor->drmSession = session;
+    aampcdmidecryptor->subsampleDecryptor = dynamic_cast<AampSubsampleDecryptor*>(aampcdmidecryptor->drmSession);
+    aampcdmidecryptor->patternDecryptor = dynamic_cast<AampPatternDecryptor*>(aampcdmidecryptor->drmSession);
+    aampcdmidecryptor->hostOutput = TRUE;
+#if defined(AMLOGIC) || (defined(USE_SAGE_SVP) && defined(USE_OPENCDM) && !defined(USE_OPENCDM_ADAPTER))
+    // secure video path output is not host memory, batched and parallel decryption are
+    // for clear-to-host decryption only
+    aampcdmidecryptor->hostOutput = aampcdmidecryptor->ignoreSVP;
+#endif
+    aampcdmidecryptor->batchDecryptor = aampcdmidecryptor->hostOutput ?
+            dynamic_cast<AampBatchDecryptor*>(aampcdmidecryptor->drmSession) : NULL;
+    gst_aampcdmidecryptor_state_publish(aampcdmidecryptor);
+    if (pattern != (aampcdmidecryptor->patternDecryptor != NULL))
     {
-        GST_DEBUG_OBJECT(aampcdmidecryptor, "drmSession is invalid **** NULL ****. Aborting.");
-        result = GST_FLOW_NOT_SUPPORTED;
-        goto free_resources;
+        // cbcs sink caps depend on the session, applied at the next negotiation
+        gst_aampcdmidecryptor_caps_cache_clear(aampcdmidecryptor);
     }
+}
 
-    GST_TRACE_OBJECT(aampcdmidecryptor, "Got key event ; Proceeding with decryption");
+void gst_aampcdmidecryptor_set_session(GstAampCDMIDecryptor* aampcdmidecryptor, AampDrmSession* session)
+{
+    g_mutex_lock(&aampcdmidecryptor->mutex);
+    gst_aampcdmidecryptor_install_session(aampcdmidecryptor, session);
+    aampcdmidecryptor->streamReceived = (session != NULL);
+    g_cond_broadcast(&aampcdmidecryptor->condition);
+    g_mutex_unlock(&aampcdmidecryptor->mutex);
+    GST_DEBUG_OBJECT(aampcdmidecryptor, "DRM session %p installed", session);
+}
 
-    if (!gst_structure_get_uint(protectionMeta->info, "iv_size", &ivSize))
+/*
+ Accounts an encrypted sample given to the CDM and its outcome.
+ */
+static void gst_aampcdmidecryptor_stats_sample(GstAampCDMIDecryptor* aampcdmidecryptor, gsize size,
+        gsize encryptedBytes, guint subSampleCount, int errorCode)
+{
+    guint bucket = 0;
+    while (subSampleCount && bucket < GST_AAMP_DECRYPT_SUBSAMPLE_BUCKETS - 1)
     {
-        GST_ERROR_OBJECT(aampcdmidecryptor, "failed to get iv_size");
-        result = GST_FLOW_NOT_SUPPORTED;
-        goto free_resources;
+        bucket++;
+        subSampleCount >>= 1;
     }
 
-    if (!gst_structure_get_boolean(protectionMeta->info, "encrypted",
-            &encrypted))
+    g_mutex_lock(&aampcdmidecryptor->statsMutex);
+    GstAampCDMIDecryptorStats* stats = &aampcdmidecryptor->stats;
+    stats->samples++;
+    stats->bytes += size;
+    stats->encryptedBytes += encryptedBytes;
+    stats->clearBytes += size - MIN(size, encryptedBytes);
+    stats->subsamples[bucket]++;
+    if (errorCode != 0)
     {
-        GST_ERROR_OBJECT(aampcdmidecryptor,
-                "failed to get encrypted flag");
-        result = GST_FLOW_NOT_SUPPORTED;
-        goto free_resources;
+        stats->failures++;
+        if (errorCode == HDCP_OUTPUT_PROTECTION_FAILURE || errorCode == HDCP_COMPLIANCE_CHECK_FAILURE)
+        {
+            stats->hdcpFailures++;
+        }
     }
+    g_mutex_unlock(&aampcdmidecryptor->statsMutex);
+}
 
-    // Unencrypted sample.
-    if (!ivSize || !encrypted)
-        goto free_resources;
+/*
+ Accounts a sample passed through without decryption.
+ */
+static void gst_aampcdmidecryptor_stats_clear(GstAampCDMIDecryptor* aampcdmidecryptor, gsize size)
+{
+    g_mutex_lock(&aampcdmidecryptor->statsMutex);
+    aampcdmidecryptor->stats.clearSamples++;
+    aampcdmidecryptor->stats.clearBytes += size;
+    g_mutex_unlock(&aampcdmidecryptor->statsMutex);
+}
 
-    GST_TRACE_OBJECT(trans, "protection meta: %" GST_PTR_FORMAT, protectionMeta->info);
-    if (!gst_structure_get_uint(protectionMeta->info, "subsample_count",
-            &subSampleCount))
+/*
+ Accounts a decrypt call started at start, monotonic time.
+ */
+static void gst_aampcdmidecryptor_stats_call(GstAampCDMIDecryptor* aampcdmidecryptor, gint64 start)
+{
+    guint64 elapsed = (guint64) (g_get_monotonic_time() - start);
+    guint bucket = 0;
+    while (bucket < GST_AAMP_DECRYPT_LATENCY_BUCKETS - 1 && elapsed >= gst_aampcdmidecryptor_latency_bounds[bucket])
     {
-        GST_ERROR_OBJECT(aampcdmidecryptor,
-                "failed to get subsample_count");
-        result = GST_FLOW_NOT_SUPPORTED;
-        goto free_resources;
+        bucket++;
     }
 
-    value = gst_structure_get_value(protectionMeta->info, "iv");
-    if (!value)
+    g_mutex_lock(&aampcdmidecryptor->statsMutex);
+    GstAampCDMIDecryptorStats* stats = &aampcdmidecryptor->stats;
+    stats->calls++;
+    stats->latency[bucket]++;
+    stats->latencyTotal += elapsed;
+    stats->latencyMax = MAX(stats->latencyMax, elapsed);
+    g_mutex_unlock(&aampcdmidecryptor->statsMutex);
+}
+
+/*
+ Accounts time spent waiting for a key since start, monotonic time.
+ */
+static void gst_aampcdmidecryptor_stats_key_wait(GstAampCDMIDecryptor* aampcdmidecryptor, gint64 start)
+{
+    g_mutex_lock(&aampcdmidecryptor->statsMutex);
+    aampcdmidecryptor->stats.keyWaits++;
+    aampcdmidecryptor->stats.keyWaitTime += (guint64) (g_get_monotonic_time() - start);
+    g_mutex_unlock(&aampcdmidecryptor->statsMutex);
+}
+
+/*
+ Accounts heap allocations made on the decrypt path.
+ */
+static void gst_aampcdmidecryptor_stats_alloc(GstAampCDMIDecryptor* aampcdmidecryptor, guint count)
+{
+    g_mutex_lock(&aampcdmidecryptor->statsMutex);
+    aampcdmidecryptor->stats.allocations += count;
+    g_mutex_unlock(&aampcdmidecryptor->statsMutex);
+}
+
+/*
+ Takes mutex on the decrypt path, accounting the time blocked when another thread holds it.
+ The uncontended case costs no clock reads.
+ */
+static void gst_aampcdmidecryptor_lock_decrypt(GstAampCDMIDecryptor* aampcdmidecryptor)
+{
+    if (!g_mutex_trylock(&aampcdmidecryptor->mutex))
     {
-        GST_ERROR_OBJECT(aampcdmidecryptor, "Failed to get IV for sample");
-        result = GST_FLOW_NOT_SUPPORTED;
-        goto free_resources;
+        gint64 start = g_get_monotonic_time();
+        g_mutex_lock(&aampcdmidecryptor->mutex);
+        g_mutex_lock(&aampcdmidecryptor->statsMutex);
+        aampcdmidecryptor->stats.lockContentions++;
+        aampcdmidecryptor->stats.lockWaitTime += (guint64) (g_get_monotonic_time() - start);
+        g_mutex_unlock(&aampcdmidecryptor->statsMutex);
+    }
+}
+
+/*
+ Builds the "stats" structure
+ */
+static GstStructure* gst_aampcdmidecryptor_stats_structure(GstAampCDMIDecryptor* aampcdmidecryptor)
+{
+    GstAampCDMIDecryptorStats stats;
+    GValue array = G_VALUE_INIT;
+    GValue item = G_VALUE_INIT;
+
+    g_mutex_lock(&aampcdmidecryptor->statsMutex);
+    stats = aampcdmidecryptor->stats;
+    g_mutex_unlock(&aampcdmidecryptor->statsMutex);
+
+    GstStructure* structure = gst_structure_new("application/x-aamp-decryptor-stats",
+            "samples", G_TYPE_UINT64, stats.samples,
+            "clear-samples", G_TYPE_UINT64, stats.clearSamples,
+            "bytes", G_TYPE_UINT64, stats.bytes,
+            "encrypted-bytes", G_TYPE_UINT64, stats.encryptedBytes,
+            "clear-bytes", G_TYPE_UINT64, stats.clearBytes,
+            "decrypt-calls", G_TYPE_UINT64, stats.calls,
+            "latency-total-us", G_TYPE_UINT64, stats.latencyTotal,
+            "latency-max-us", G_TYPE_UINT64, stats.latencyMax,
+            "key-waits", G_TYPE_UINT64, stats.keyWaits,
+            "key-wait-us", G_TYPE_UINT64, stats.keyWaitTime,
+            "failures", G_TYPE_UINT64, stats.failures,
+            "hdcp-failures", G_TYPE_UINT64, stats.hdcpFailures,
+            "allocations", G_TYPE_UINT64, stats.allocations,
+            "lock-contentions", G_TYPE_UINT64, stats.lockContentions,
+            "lock-wait-us", G_TYPE_UINT64, stats.lockWaitTime,
+            NULL);
+
+    g_value_init(&item, G_TYPE_UINT64);
+
+    // subsample count buckets: 0, 1, 2-3, 4-7, 8-15, 16+
+    g_value_init(&array, GST_TYPE_ARRAY);
+    for (guint i = 0; i < GST_AAMP_DECRYPT_SUBSAMPLE_BUCKETS; i++)
+    {
+        g_value_set_uint64(&item, stats.subsamples[i]);
+        gst_value_array_append_value(&array, &item);
     }
+    gst_structure_take_value(structure, "subsample-histogram", &array);
 
-    ivBuffer = gst_value_get_buffer(value);
+    g_value_init(&array, GST_TYPE_ARRAY);
+    for (guint i = 0; i < GST_AAMP_DECRYPT_LATENCY_BUCKETS - 1; i++)
+    {
+        g_value_set_uint64(&item, gst_aampcdmidecryptor_latency_bounds[i]);
+        gst_value_array_append_value(&array, &item);
+    }
+    gst_structure_take_value(structure, "latency-bounds-us", &array);
 
-    value = gst_structure_get_value(protectionMeta->info, "kid");
-    if (!value) {
-        GST_ERROR_OBJECT(aampcdmidecryptor, "Failed to get kid for sample");
-        result = GST_FLOW_NOT_SUPPORTED;
-        goto free_resources;
+    g_value_init(&array, GST_TYPE_ARRAY);
+    for (guint i = 0; i < GST_AAMP_DECRYPT_LATENCY_BUCKETS; i++)
+    {
+        g_value_set_uint64(&item, stats.latency[i]);
+        gst_value_array_append_value(&array, &item);
     }
+    gst_structure_take_value(structure, "latency-histogram", &array);
 
-    keyIDBuffer = gst_value_get_buffer(value);
+    g_value_unset(&item);
+    return structure;
+}
+
+/*
+ Maps a buffer valued field of a GstProtectionMeta structure. Returns FALSE if the
+ field is missing or cannot be mapped.
+ */
+static gboolean gst_aampcdmidecryptor_map_field(const GstStructure* structure, GQuark field,
+        GstBuffer** buffer, GstMapInfo* map)
+{
+    const GValue* value = gst_structure_id_get_value(structure, field);
+    if (!value || !GST_VALUE_HOLDS_BUFFER(value))
+    {
+        return FALSE;
+    }
+    if (!gst_buffer_map(gst_value_get_buffer(value), map, GST_MAP_READ))
+    {
+        return FALSE;
+    }
+    *buffer = gst_value_get_buffer(value);
+    return TRUE;
+}
+
+/*
+ Parses the protection parameters of a sample once. A GstAampProtectionMeta attached by
+ upstream is read directly, a GstProtectionMeta through interned field names with its IV,
+ KID and subsample buffers mapped in place. Returns FALSE for malformed metadata, info
+ must be released with gst_aampcdmidecryptor_release_info() either way.
+ */
+static gboolean gst_aampcdmidecryptor_parse_info(GstAampCDMIDecryptor* aampcdmidecryptor, GstBuffer* buffer,
+        AampCDMISampleInfo* info)
+{
+    memset(info, 0, sizeof(*info));
 
-    if (subSampleCount)
+    GstAampProtectionMeta* binaryMeta = gst_buffer_get_aamp_protection_meta(buffer);
+    if (binaryMeta)
     {
-        value = gst_structure_get_value(protectionMeta->info, "subsamples");
-        if (!value)
+        info->meta = &binaryMeta->meta;
+        info->encrypted = binaryMeta->encrypted && binaryMeta->ivSize;
+        info->iv = binaryMeta->iv;
+        info->ivLength = binaryMeta->ivSize;
+        info->kid = binaryMeta->kidSize ? binaryMeta->kid : NULL;
+        info->kidLength = binaryMeta->kidSize;
+        info->subSampleCount = binaryMeta->subsampleCount;
+        if (binaryMeta->subsamples)
         {
-            GST_ERROR_OBJECT(aampcdmidecryptor,
-                    "Failed to get subsamples");
-            result = GST_FLOW_NOT_SUPPORTED;
-            goto free_resources;
+            info->subsamples = (const guint8*) g_bytes_get_data(binaryMeta->subsamples, &info->subsamplesSize);
         }
-        subsamplesBuffer = gst_value_get_buffer(value);
-        if (!gst_buffer_map(subsamplesBuffer, &subSamplesMap, GST_MAP_READ))
+        info->pattern = binaryMeta->pattern;
+        info->cryptBlocks = binaryMeta->cryptBlocks;
+        info->skipBlocks = binaryMeta->skipBlocks;
+        return TRUE;
+    }
+
+    GstProtectionMeta* protectionMeta = reinterpret_cast<GstProtectionMeta*>(gst_buffer_get_protection_meta(buffer));
+    if (!protectionMeta)
+    {
+        return TRUE;
+    }
+    const GstStructure* structure = protectionMeta->info;
+    guint ivSize = 0;
+    info->meta = &protectionMeta->meta;
+    GST_TRACE_OBJECT(aampcdmidecryptor, "protection meta: %" GST_PTR_FORMAT, structure);
+
+    if (!gst_structure_id_get(structure, quarkIvSize, G_TYPE_UINT, &ivSize,
+            quarkEncrypted, G_TYPE_BOOLEAN, &info->encrypted, NULL))
+    {
+        GST_ERROR_OBJECT(aampcdmidecryptor, "failed to get iv_size or encrypted flag");
+        return FALSE;
+    }
+    // cbcs samples without IV use the constant IV of the stream
+    if (!ivSize && info->encrypted && !gst_structure_id_has_field(structure, quarkConstantIv))
+    {
+        info->encrypted = FALSE;
+    }
+    if (!info->encrypted)
+    {
+        return TRUE;
+    }
+
+    if (!gst_structure_id_get(structure, quarkSubsampleCount, G_TYPE_UINT, &info->subSampleCount, NULL))
+    {
+        GST_ERROR_OBJECT(aampcdmidecryptor, "failed to get subsample_count");
+        return FALSE;
+    }
+    if (!gst_aampcdmidecryptor_map_field(structure, ivSize ? quarkIv : quarkConstantIv, &info->ivBuffer, &info->ivMap))
+    {
+        GST_ERROR_OBJECT(aampcdmidecryptor, "Failed to get IV for sample");
+        return FALSE;
+    }
+    info->iv = info->ivMap.data;
+    info->ivLength = info->ivMap.size;
+    if (gst_aampcdmidecryptor_map_field(structure, quarkKid, &info->kidBuffer, &info->kidMap))
+    {
+        info->kid = info->kidMap.data;
+        info->kidLength = info->kidMap.size;
+    }
+    if (info->subSampleCount)
+    {
+        if (!gst_aampcdmidecryptor_map_field(structure, quarkSubsamples, &info->subsamplesBuffer, &info->subsamplesMap))
         {
-            GST_ERROR_OBJECT(aampcdmidecryptor,
-                    "Failed to map subsample buffer");
-            result = GST_FLOW_NOT_SUPPORTED;
-            goto free_resources;
+            GST_ERROR_OBJECT(aampcdmidecryptor, "Failed to get subsamples");
+            return FALSE;
         }
+        info->subsamples = info->subsamplesMap.data;
+        info->subsamplesSize = info->subsamplesMap.size;
+    }
+
+    const GValue* cipherMode = gst_structure_id_get_value(structure, quarkCipherMode);
+    info->pattern = gst_structure_has_name(structure, "application/x-cbcs")
+            || (cipherMode && G_VALUE_HOLDS_STRING(cipherMode) && !g_strcmp0(g_value_get_string(cipherMode), "cbcs"));
+    if (info->pattern)
+    {
+        gst_structure_id_get(structure, quarkCryptByteBlock, G_TYPE_UINT, &info->cryptBlocks, NULL);
+        gst_structure_id_get(structure, quarkSkipByteBlock, G_TYPE_UINT, &info->skipBlocks, NULL);
+    }
+    return TRUE;
+}
+
+/*
+ Unmaps the buffers backing a parsed info.
+ */
+static void gst_aampcdmidecryptor_release_info(AampCDMISampleInfo* info)
+{
+    if (info->ivBuffer)
+    {
+        gst_buffer_unmap(info->ivBuffer, &info->ivMap);
+        info->ivBuffer = NULL;
+    }
+    if (info->kidBuffer)
+    {
+        gst_buffer_unmap(info->kidBuffer, &info->kidMap);
+        info->kidBuffer = NULL;
+    }
+    if (info->subsamplesBuffer)
+    {
+        gst_buffer_unmap(info->subsamplesBuffer, &info->subsamplesMap);
+        info->subsamplesBuffer = NULL;
+    }
+}
+
+/*
+ Returns the number of bytes a crypt/skip pattern encrypts in a range of size bytes,
+ a trailing partial block staying clear. A cryptBlocks of 0 encrypts every whole block.
+ */
+static gsize gst_aampcdmidecryptor_pattern_bytes(gsize size, guint cryptBlocks, guint skipBlocks)
+{
+    gsize blocks = size / CBCS_BLOCK_SIZE;
+    if (cryptBlocks)
+    {
+        gsize period = (gsize) cryptBlocks + skipBlocks;
+        blocks = (blocks / period) * cryptBlocks + MIN(blocks % period, (gsize) cryptBlocks);
+    }
+    return blocks * CBCS_BLOCK_SIZE;
+}
+
+/*
+ Returns the number of encrypted bytes of a sample of size bytes.
+ */
+static gsize gst_aampcdmidecryptor_encrypted_bytes(const AampCDMISampleInfo* info, gsize size)
+{
+    gsize encryptedBytes = 0;
+
+    if (!info->subSampleCount)
+    {
+        return info->pattern ? gst_aampcdmidecryptor_pattern_bytes(size, info->cryptBlocks, info->skipBlocks) : size;
+    }
+
+    GstByteReader reader;
+    guint16 nBytesClear;
+    guint32 nBytesEncrypted;
+    gst_byte_reader_init(&reader, info->subsamples, info->subsamplesSize);
+    for (guint i = 0; i < info->subSampleCount
+            && gst_byte_reader_get_uint16_be(&reader, &nBytesClear)
+            && gst_byte_reader_get_uint32_be(&reader, &nBytesEncrypted); i++)
+    {
+        encryptedBytes += info->pattern ?
+                gst_aampcdmidecryptor_pattern_bytes(nBytesEncrypted, info->cryptBlocks, info->skipBlocks) : nBytesEncrypted;
     }
+    return encryptedBytes;
+}
+
+/*
+ Decrypts a sample with the subclass' in element decryption. Returns FALSE if the
+ subclass leaves the sample to the DRM session.
+ */
+static gboolean gst_aampcdmidecryptor_local_decrypt(GstAampCDMIDecryptor* aampcdmidecryptor, GstBuffer* buffer,
+        const AampCDMISampleInfo* info, GstFlowReturn* result)
+{
+    GstAampCDMIDecryptorClass* klass = GST_AAMP_CDMI_DECRYPTOR_GET_CLASS(aampcdmidecryptor);
+    int errorCode = 0;
+    gsize encryptedBytes = 0;
 
-    errorCode = aampcdmidecryptor->drmSession->decrypt(keyIDBuffer, ivBuffer, buffer, subSampleCount, subsamplesBuffer, aampcdmidecryptor->sinkCaps);
+    if (!klass->local_decrypt)
+    {
+        return FALSE;
+    }
+    gint64 start = g_get_monotonic_time();
+    if (!klass->local_decrypt(aampcdmidecryptor, buffer, info, &errorCode, &encryptedBytes))
+    {
+        return FALSE;
+    }
+    gst_aampcdmidecryptor_stats_call(aampcdmidecryptor, start);
+    gst_aampcdmidecryptor_stats_sample(aampcdmidecryptor, gst_buffer_get_size(buffer), encryptedBytes, info->subSampleCount, errorCode);
 
+    gst_aampcdmidecryptor_lock_decrypt(aampcdmidecryptor);
+    *result = gst_aampcdmidecryptor_decrypt_result(aampcdmidecryptor, errorCode);
     aampcdmidecryptor->streamEncryped = true;
-    if (errorCode != 0 || aampcdmidecryptor->hdcpOpProtectionFailCount)
+    g_mutex_unlock(&aampcdmidecryptor->mutex);
+    return TRUE;
+}
+
+/*
+ Returns a reference to the session snapshot to decrypt a sample with. Until a session is
+ published, waits under mutex for the first protection event to be handled. Returns NULL
+ when there is nothing to wait for, the wait was ended by a state change or session
+ creation failed.
+ */
+static GstAampCDMISessionState* gst_aampcdmidecryptor_acquire_state(GstAampCDMIDecryptor* aampcdmidecryptor)
+{
+    GstAampCDMISessionState* state = gst_aampcdmidecryptor_state_get(aampcdmidecryptor);
+
+    if (state->drmSession)
     {
-	if(errorCode == HDCP_OUTPUT_PROTECTION_FAILURE)
-	{
-		aampcdmidecryptor->hdcpOpProtectionFailCount++;
-	}
-	else if(aampcdmidecryptor->hdcpOpProtectionFailCount)
-	{
-		if(aampcdmidecryptor->hdcpOpProtectionFailCount >= DECRYPT_FAILURE_THRESHOLD) {
-			GstStructure *newmsg = gst_structure_new("HDCPProtectionFailure", "message", G_TYPE_STRING,"HDCP Output Protection Error", NULL);
-			gst_element_post_message(reinterpret_cast<GstElement*>(aampcdmidecryptor),gst_message_new_application (GST_OBJECT (aampcdmidecryptor), newmsg));
-		}
-		aampcdmidecryptor->hdcpOpProtectionFailCount = 0;
-	}
-	else
-	{
-		GST_ERROR_OBJECT(aampcdmidecryptor, "decryption failed; error code %d\n",errorCode);
-		aampcdmidecryptor->decryptFailCount++;
-		if(aampcdmidecryptor->decryptFailCount >= DECRYPT_FAILURE_THRESHOLD && aampcdmidecryptor->notifyDecryptError )
-		{
-			aampcdmidecryptor->notifyDecryptError = false;
-			GError *error;
-			if(errorCode == HDCP_COMPLIANCE_CHECK_FAILURE)
-			{
-				// Failure - 2.2 vs 1.4 HDCP
-				error = g_error_new(GST_STREAM_ERROR , GST_STREAM_ERROR_FAILED, "HDCP Compliance Check Failure");
-			}
-			else
-			{
-				error = g_error_new(GST_STREAM_ERROR , GST_STREAM_ERROR_FAILED, "Decrypt Error: code %d", errorCode);
-			}
-			gst_element_post_message(reinterpret_cast<GstElement*>(aampcdmidecryptor), gst_message_new_error (GST_OBJECT (aampcdmidecryptor), error, "Decrypt Failed"));
-			result = GST_FLOW_ERROR;
-		}
-		goto free_resources;
-	}
+        return state;
     }
-    else
+    gst_aampcdmidecryptor_state_unref(state);
+    state = NULL;
+
+    g_mutex_lock(&aampcdmidecryptor->mutex);
+    GST_TRACE_OBJECT(aampcdmidecryptor,
+            "Mutex acquired, stream received: %s canWait: %d",
+            aampcdmidecryptor->streamReceived ? "yes" : "no", aampcdmidecryptor->canWait);
+
+    if (aampcdmidecryptor->canWait || aampcdmidecryptor->streamReceived)
     {
-        aampcdmidecryptor->decryptFailCount = 0;
-	aampcdmidecryptor->hdcpOpProtectionFailCount = 0;
-        if (aampcdmidecryptor->streamtype == eMEDIATYPE_AUDIO)
+        if (!aampcdmidecryptor->firstsegprocessed)
         {
-            GST_DEBUG_OBJECT(aampcdmidecryptor, "Decryption successful for Audio packets");
+            GST_DEBUG_OBJECT(aampcdmidecryptor, "\n\nWaiting for key\n");
         }
-        else
+        // The key might not have been received yet. Wait for it.
+        if (!aampcdmidecryptor->streamReceived)
         {
-            GST_DEBUG_OBJECT(aampcdmidecryptor, "Decryption successful for Video packets");
+            gint64 start = g_get_monotonic_time();
+            g_cond_wait(&aampcdmidecryptor->condition,
+                    &aampcdmidecryptor->mutex);
+            gst_aampcdmidecryptor_stats_key_wait(aampcdmidecryptor, start);
         }
-    }
 
-    if (!aampcdmidecryptor->firstsegprocessed
-            && aampcdmidecryptor->aamp)
-    {
-        if (aampcdmidecryptor->streamtype == eMEDIATYPE_VIDEO)
+        if (!aampcdmidecryptor->streamReceived)
         {
-            aampcdmidecryptor->aamp->profiler.ProfileEnd(
-                    PROFILE_BUCKET_DECRYPT_VIDEO);
-        } else if (aampcdmidecryptor->streamtype == eMEDIATYPE_AUDIO)
+            GST_DEBUG_OBJECT(aampcdmidecryptor,
+                    "Condition signaled from state change transition. Aborting.");
+        }
+        /* If drmSession creation failed, then the call will be aborted here */
+        else if (aampcdmidecryptor->drmSession == NULL)
         {
-            aampcdmidecryptor->aamp->profiler.ProfileEnd(
-                    PROFILE_BUCKET_DECRYPT_AUDIO);
+            GST_DEBUG_OBJECT(aampcdmidecryptor, "drmSession is invalid **** NULL ****. Aborting.");
+        }
+        else
+        {
+            state = gst_aampcdmidecryptor_state_get(aampcdmidecryptor);
         }
-        aampcdmidecryptor->firstsegprocessed = true;
     }
+    g_mutex_unlock(&aampcdmidecryptor->mutex);
+    return state;
+}
 
-    free_resources:
+#ifdef USE_OPENCDM_ADAPTER
 
-    if (!aampcdmidecryptor->firstsegprocessed
-            && aampcdmidecryptor->aamp)
-    {
-	if(!aampcdmidecryptor->streamEncryped)
-	{
-		if (aampcdmidecryptor->streamtype == eMEDIATYPE_VIDEO)
-		{
-			aampcdmidecryptor->aamp->profiler.ProfileEnd(
-					PROFILE_BUCKET_DECRYPT_VIDEO);
-		} else if (aampcdmidecryptor->streamtype == eMEDIATYPE_AUDIO)
-		{
-			aampcdmidecryptor->aamp->profiler.ProfileEnd(
-					PROFILE_BUCKET_DECRYPT_AUDIO);
-		}
-	}
-	else
-	{
-		if (aampcdmidecryptor->streamtype == eMEDIATYPE_VIDEO)
-		{
-			aampcdmidecryptor->aamp->profiler.ProfileError(PROFILE_BUCKET_DECRYPT_VIDEO, (int)result);
-		} else if (aampcdmidecryptor->streamtype == eMEDIATYPE_AUDIO)
-		{
-			aampcdmidecryptor->aamp->profiler.ProfileError(PROFILE_BUCKET_DECRYPT_AUDIO, (int)result);
-		}
-	}
-	    aampcdmidecryptor->firstsegprocessed = true;
-    }
+static GstFlowReturn gst_aampcdmidecryptor_transform_ip(
+        GstBaseTransform * trans, GstBuffer * buffer)
+{
+    DEBUG_FUNC();
 
-    if (subsamplesBuffer)
-        gst_buffer_unmap(subsamplesBuffer, &subSamplesMap);
+    GstAampCDMIDecryptor *aampcdmidecryptor =
+            GST_AAMP_CDMI_DECRYPTOR(trans);
 
-    if (protectionMeta)
-        gst_buffer_remove_meta(buffer,
-                reinterpret_cast<GstMeta*>(protectionMeta));
+    GstFlowReturn result = GST_FLOW_OK;
 
-    if (mutexLocked)
-        g_mutex_unlock(&aampcdmidecryptor->mutex);
-    return result;
-}
+    guint subSampleCount;
+    GstBuffer* ivBuffer = NULL;
+    GstBuffer* keyIDBuffer = NULL;
+    GstBuffer* subsamplesBuffer = NULL;
+    AampCDMISampleInfo info;
+    GstAampCDMISessionState* state = NULL;
+    gboolean mutexLocked = FALSE;
+    gboolean hdcpFailing;
+    int errorCode;
+    gint64 start;
+    gsize encryptedBytes;
 
-#else
+    memset(&info, 0, sizeof(info));
 
-	static void gst_add_svp_meta_data(GstBuffer* gstBuffer, uint8_t* pOpaqueData, uint32_t cbData, guint subSampleCount, GstByteReader* reader)
+    GST_DEBUG_OBJECT(aampcdmidecryptor, "Processing buffer");
+
+    if (!buffer)
+    {
+        GST_ERROR_OBJECT(aampcdmidecryptor,"Failed to get writable buffer");
+        result = GST_FLOW_NOT_SUPPORTED;
+        goto free_resources;
+    }
+
+    if (!gst_aampcdmidecryptor_parse_info(aampcdmidecryptor, buffer, &info))
+    {
+        result = GST_FLOW_NOT_SUPPORTED;
+        goto free_resources;
+    }
+
+    if (!info.meta)
+    {
+        GST_DEBUG_OBJECT(aampcdmidecryptor,
+                "Failed to get GstProtection metadata from buffer %p, could be clear buffer",buffer);
+        gst_aampcdmidecryptor_stats_clear(aampcdmidecryptor, gst_buffer_get_size(buffer));
+#if defined(AMLOGIC)
+        // call decrypt even for clear samples in order to copy it to a secure buffer. If secure buffers are not supported
+        // decrypt() call will return without doing anything
+	if (aampcdmidecryptor->drmSession != NULL)
+		errorCode = aampcdmidecryptor->drmSession->decrypt(keyIDBuffer, ivBuffer, buffer, subSampleCount, subsamplesBuffer, aampcdmidecryptor->sinkCaps);
+	else
+	{ /* If drmSession creation failed, then the call will be aborted here */
+		result = GST_FLOW_NOT_SUPPORTED;
+		GST_DEBUG_OBJECT(aampcdmidecryptor, "drmSession is **** NULL ****, returning GST_FLOW_NOT_SUPPORTED");
+	}
+#endif
+        goto free_resources;
+    }
+
+    if (aampcdmidecryptor->localDecrypt
+            && gst_aampcdmidecryptor_local_decrypt(aampcdmidecryptor, buffer, &info, &result))
+    {
+        goto free_resources;
+    }
+
+    // decrypts without holding mutex, session and caps come from the snapshot
+    state = gst_aampcdmidecryptor_acquire_state(aampcdmidecryptor);
+    if (!state)
+    {
+        result = GST_FLOW_NOT_SUPPORTED;
+        goto free_resources;
+    }
+
+    GST_TRACE_OBJECT(aampcdmidecryptor, "Got key event ; Proceeding with decryption");
+
+    // Unencrypted sample.
+    if (!info.encrypted)
+    {
+        gst_aampcdmidecryptor_stats_clear(aampcdmidecryptor, gst_buffer_get_size(buffer));
+        goto free_resources;
+    }
+
+    // the adapter reads the cbcs pattern from the protection meta itself
+    if (!info.ivBuffer)
+    {
+        GST_ERROR_OBJECT(aampcdmidecryptor, "binary protection meta is not supported with the OpenCDM adapter");
+        result = GST_FLOW_NOT_SUPPORTED;
+        goto free_resources;
+    }
+    if (!info.kidBuffer)
+    {
+        GST_ERROR_OBJECT(aampcdmidecryptor, "Failed to get kid for sample");
+        result = GST_FLOW_NOT_SUPPORTED;
+        goto free_resources;
+    }
+    ivBuffer = info.ivBuffer;
+    keyIDBuffer = info.kidBuffer;
+    subsamplesBuffer = info.subsamplesBuffer;
+    subSampleCount = info.subSampleCount;
+    encryptedBytes = gst_aampcdmidecryptor_encrypted_bytes(&info, gst_buffer_get_size(buffer));
+
+    start = g_get_monotonic_time();
+    errorCode = state->drmSession->decrypt(keyIDBuffer, ivBuffer, buffer, subSampleCount, subsamplesBuffer, state->sinkCaps);
+    gst_aampcdmidecryptor_stats_call(aampcdmidecryptor, start);
+    gst_aampcdmidecryptor_stats_sample(aampcdmidecryptor, gst_buffer_get_size(buffer), encryptedBytes, subSampleCount, errorCode);
+
+    gst_aampcdmidecryptor_lock_decrypt(aampcdmidecryptor);
+    mutexLocked = TRUE;
+
+    aampcdmidecryptor->streamEncryped = true;
+    hdcpFailing = (aampcdmidecryptor->hdcpOpProtectionFailCount != 0);
+    result = gst_aampcdmidecryptor_decrypt_result(aampcdmidecryptor, errorCode);
+    // samples failing HDCP output protection are still passed on
+    if (errorCode != 0 && errorCode != HDCP_OUTPUT_PROTECTION_FAILURE && !hdcpFailing)
+    {
+        goto free_resources;
+    }
+    if (errorCode == 0)
+    {
+        if (aampcdmidecryptor->streamtype == eMEDIATYPE_AUDIO)
+        {
+            GST_DEBUG_OBJECT(aampcdmidecryptor, "Decryption successful for Audio packets");
+        }
+        else
+        {
+            GST_DEBUG_OBJECT(aampcdmidecryptor, "Decryption successful for Video packets");
+        }
+    }
+
+    if (!aampcdmidecryptor->firstsegprocessed
+            && aampcdmidecryptor->aamp)
+    {
+        if (aampcdmidecryptor->streamtype == eMEDIATYPE_VIDEO)
+        {
+            aampcdmidecryptor->aamp->profiler.ProfileEnd(
+                    PROFILE_BUCKET_DECRYPT_VIDEO);
+        } else if (aampcdmidecryptor->streamtype == eMEDIATYPE_AUDIO)
+        {
+            aampcdmidecryptor->aamp->profiler.ProfileEnd(
+                    PROFILE_BUCKET_DECRYPT_AUDIO);
+        }
+        aampcdmidecryptor->firstsegprocessed = true;
+    }
+
+    free_resources:
+
+    if (!aampcdmidecryptor->firstsegprocessed
+            && aampcdmidecryptor->aamp)
+    {
+	if(!aampcdmidecryptor->streamEncryped)
+	{
+		if (aampcdmidecryptor->streamtype == eMEDIATYPE_VIDEO)
+		{
+			aampcdmidecryptor->aamp->profiler.ProfileEnd(
+					PROFILE_BUCKET_DECRYPT_VIDEO);
+		} else if (aampcdmidecryptor->streamtype == eMEDIATYPE_AUDIO)
+		{
+			aampcdmidecryptor->aamp->profiler.ProfileEnd(
+					PROFILE_BUCKET_DECRYPT_AUDIO);
+		}
+	}
+	else
+	{
+		if (aampcdmidecryptor->streamtype == eMEDIATYPE_VIDEO)
+		{
+			aampcdmidecryptor->aamp->profiler.ProfileError(PROFILE_BUCKET_DECRYPT_VIDEO, (int)result);
+		} else if (aampcdmidecryptor->streamtype == eMEDIATYPE_AUDIO)
+		{
+			aampcdmidecryptor->aamp->profiler.ProfileError(PROFILE_BUCKET_DECRYPT_AUDIO, (int)result);
+		}
+	}
+	    aampcdmidecryptor->firstsegprocessed = true;
+    }
+
+    gst_aampcdmidecryptor_release_info(&info);
+
+    if (info.meta)
+        gst_buffer_remove_meta(buffer, info.meta);
+
+    if (mutexLocked)
+        g_mutex_unlock(&aampcdmidecryptor->mutex);
+    gst_aampcdmidecryptor_state_unref(state);
+    return result;
+}
+
+#else
+
+	/*
+	 Attaches the secure buffer handle and chunk layout of a decrypted sample. The meta data
+	 and chunk array are handed over to the SVP meta, which frees them once downstream is
+	 done with the buffer, so they cannot be recycled by the decryptor. The staging copy
+	 made ahead of decryption comes from the scratch arena.
+	 */
+	static void gst_add_svp_meta_data(GstBuffer* gstBuffer, uint8_t* pOpaqueData, uint32_t cbData, guint subSampleCount, GstByteReader* reader)
 	{
 	#ifdef USE_SAGE_SVP
-	    brcm_svp_meta_data_t *  ptr         = (brcm_svp_meta_data_t *) g_malloc(sizeof(brcm_svp_meta_data_t));
+	    brcm_svp_meta_data_t *  ptr         = g_new0(brcm_svp_meta_data_t, 1);
 	    svp_chunk_info *        ci          = NULL;
 	    uint32_t                clear_start = 0;
 	    guint16                 nBytesClear = 0;
@@ -682,14 +1615,13 @@ static GstFlowReturn gst_aampcdmidecryptor_transform_ip(
 	        // Reset reader position
 	        gst_byte_reader_set_pos(reader, 0);
 	        // Set up SVP meta data.
-	        memset((uint8_t *)ptr, 0, sizeof(brcm_svp_meta_data_t));
 	        ptr->sub_type = GST_META_BRCM_SVP_TYPE_2;
 	        ptr->u.u2.secbuf_ptr = reinterpret_cast<unsigned int>(pOpaqueData);
 	        ptr->u.u2.chunks_cnt = subSampleCount;
 	        //printf("%s  secure data = %p user buff size %d chunks = %d\n", __FUNCTION__, ptr->u.u2.secbuf_ptr, cbData, ptr->u.u2.chunks_cnt);
 	        if (subSampleCount)
 	        {
-	            ci = (svp_chunk_info *)g_malloc(subSampleCount * sizeof(svp_chunk_info));
+	            ci = g_new(svp_chunk_info, subSampleCount);
 	            ptr->u.u2.chunk_info = ci;
 	            for (int i = 0; i < subSampleCount; i++)
 	            {
@@ -709,7 +1641,7 @@ static GstFlowReturn gst_aampcdmidecryptor_transform_ip(
 	        else {
 	            // the SVP data is the whole buffer
 	            ptr->u.u2.chunks_cnt = 1;
-	            ci = (svp_chunk_info *)g_malloc( sizeof(svp_chunk_info));
+	            ci = g_new(svp_chunk_info, 1);
 	            ptr->u.u2.chunk_info = ci;
 	            ci[0].clear_size = 0;
 	            ci[0].encrypted_size = cbData;
@@ -725,6 +1657,31 @@ static GstFlowReturn gst_aampcdmidecryptor_transform_ip(
 	    return;
 	}
 
+	/*
+	 Returns the decryptor's scratch arena, grown to at least size bytes. The arena is
+	 reused across samples and its contents are undefined. Called on the streaming thread.
+	 */
+	static uint8_t* gst_aampcdmidecryptor_get_scratch(GstAampCDMIDecryptor* aampcdmidecryptor, gsize size)
+	{
+	    if (size > aampcdmidecryptor->scratchSize)
+	    {
+	        gsize newSize = (size + SCRATCH_GRANULARITY - 1) & ~((gsize)SCRATCH_GRANULARITY - 1);
+	        void* newScratch = NULL;
+	        if (posix_memalign(&newScratch, SCRATCH_ALIGNMENT, newSize) != 0)
+	        {
+	            GST_ERROR_OBJECT(aampcdmidecryptor, "Failed to grow scratch arena to %" G_GSIZE_FORMAT " bytes", newSize);
+	            return NULL;
+	        }
+	        GST_DEBUG_OBJECT(aampcdmidecryptor, "scratch arena grown %" G_GSIZE_FORMAT " -> %" G_GSIZE_FORMAT,
+	                aampcdmidecryptor->scratchSize, newSize);
+	        free(aampcdmidecryptor->scratch);
+	        aampcdmidecryptor->scratch = (guint8*) newScratch;
+	        aampcdmidecryptor->scratchSize = newSize;
+	        gst_aampcdmidecryptor_stats_alloc(aampcdmidecryptor, 1);
+	    }
+	    return aampcdmidecryptor->scratch;
+	}
+
 	static GstFlowReturn gst_aampcdmidecryptor_transform_ip(
 	        GstBaseTransform * trans, GstBuffer * buffer)
 	{
@@ -735,19 +1692,15 @@ static GstFlowReturn gst_aampcdmidecryptor_transform_ip(
 
 	    GstFlowReturn result = GST_FLOW_OK;
 
-	    GstMapInfo map, ivMap;
+	    GstMapInfo map;
 	    unsigned position = 0;
 	    guint subSampleCount;
-	    guint ivSize;
-	    gboolean encrypted;
-	    const GValue* value;
-	    GstBuffer* ivBuffer = NULL;
-	    GstBuffer* subsamplesBuffer = NULL;
-	    GstMapInfo subSamplesMap;
-	    GstByteReader* reader = NULL;
-	    GstProtectionMeta* protectionMeta = NULL;
+	    AampCDMISampleInfo info;
+	    GstByteReader subsamplesReader;
+	    GstByteReader* reader = &subsamplesReader;
 	    gboolean bufferMapped = FALSE;
 	    gboolean mutexLocked = FALSE;
+	    gboolean hdcpFailing;
 	    int errorCode;
 	    int i;
 	    guint16 nBytesClear = 0;
@@ -755,6 +1708,19 @@ static GstFlowReturn gst_aampcdmidecryptor_transform_ip(
 	    gpointer pbData = NULL;
 	    uint32_t cbData = 0;
 	    uint8_t * pOpaqueData = NULL;
+	    gboolean inPlace = FALSE;
+	    AampDrmSession* session = NULL;
+	    AampSubsampleDecryptor* subsampleDecryptor = NULL;
+	    AampPatternDecryptor* patternDecryptor = NULL;
+	    gboolean pattern = FALSE;
+	    guint cryptBlocks = 0;
+	    guint skipBlocks = 0;
+	    guint rangeCount = 0;
+	    gint64 start;
+	    uint32_t encryptedBytes = 0;
+	    GstAampCDMISessionState* state = NULL;
+
+	    memset(&info, 0, sizeof(info));
 
 	    GST_DEBUG_OBJECT(aampcdmidecryptor, "Processing buffer");
 
@@ -765,54 +1731,34 @@ static GstFlowReturn gst_aampcdmidecryptor_transform_ip(
 	        goto free_resources;
 	    }
 
-	    protectionMeta =
-	            reinterpret_cast<GstProtectionMeta*>(gst_buffer_get_protection_meta(buffer));
-
-	    if (!protectionMeta)
+	    if (!gst_aampcdmidecryptor_parse_info(aampcdmidecryptor, buffer, &info))
 	    {
-	        GST_DEBUG_OBJECT(aampcdmidecryptor,
-	                "Failed to get GstProtection metadata from buffer %p, could be clear buffer",buffer);
+	        result = GST_FLOW_NOT_SUPPORTED;
 	        goto free_resources;
 	    }
 
-	    g_mutex_lock(&aampcdmidecryptor->mutex);
-	    mutexLocked = TRUE;
-	    GST_TRACE_OBJECT(aampcdmidecryptor,
-	            "Mutex acquired, stream received: %s canWait: %d",
-	            aampcdmidecryptor->streamReceived ? "yes" : "no", aampcdmidecryptor->canWait);
-
-	    if (!aampcdmidecryptor->canWait
-	            && !aampcdmidecryptor->streamReceived)
+	    if (!info.meta)
 	    {
-	        result = GST_FLOW_NOT_SUPPORTED;
+	        GST_DEBUG_OBJECT(aampcdmidecryptor,
+	                "Failed to get GstProtection metadata from buffer %p, could be clear buffer",buffer);
+	        gst_aampcdmidecryptor_stats_clear(aampcdmidecryptor, gst_buffer_get_size(buffer));
 	        goto free_resources;
 	    }
 
-	    if (!aampcdmidecryptor->firstsegprocessed)
+	    if (aampcdmidecryptor->localDecrypt
+	            && gst_aampcdmidecryptor_local_decrypt(aampcdmidecryptor, buffer, &info, &result))
 	    {
-	        GST_DEBUG_OBJECT(aampcdmidecryptor, "\n\nWaiting for key\n");
+	        goto free_resources;
 	    }
-	    // The key might not have been received yet. Wait for it.
-	    if (!aampcdmidecryptor->streamReceived)
-	        g_cond_wait(&aampcdmidecryptor->condition,
-	                &aampcdmidecryptor->mutex);
 
-	    if (!aampcdmidecryptor->streamReceived)
+	    // decrypts without holding mutex, the session comes from the snapshot
+	    state = gst_aampcdmidecryptor_acquire_state(aampcdmidecryptor);
+	    if (!state)
 	    {
-	        GST_DEBUG_OBJECT(aampcdmidecryptor,
-	                "Condition signaled from state change transition. Aborting.");
 	        result = GST_FLOW_NOT_SUPPORTED;
 	        goto free_resources;
 	    }
 
-    /* If drmSession creation failed, then the call will be aborted here */
-    if (aampcdmidecryptor->drmSession == NULL)
-    {
-        GST_DEBUG_OBJECT(aampcdmidecryptor, "drmSession is invalid **** NULL ****. Aborting.");
-        result = GST_FLOW_NOT_SUPPORTED;
-        goto free_resources;
-    }
-
 	    GST_TRACE_OBJECT(aampcdmidecryptor, "Got key event ; Proceeding with decryption");
 
 	    bufferMapped = gst_buffer_map(buffer, &map,
@@ -824,100 +1770,133 @@ static GstFlowReturn gst_aampcdmidecryptor_transform_ip(
 	        goto free_resources;
 	    }
 
-	    if (!gst_structure_get_uint(protectionMeta->info, "iv_size", &ivSize))
-	    {
-	        GST_ERROR_OBJECT(aampcdmidecryptor, "failed to get iv_size");
-	        result = GST_FLOW_NOT_SUPPORTED;
-	        goto free_resources;
-	    }
-
-	    if (!gst_structure_get_boolean(protectionMeta->info, "encrypted",
-	            &encrypted))
-	    {
-	        GST_ERROR_OBJECT(aampcdmidecryptor,
-	                "failed to get encrypted flag");
-	        result = GST_FLOW_NOT_SUPPORTED;
-	        goto free_resources;
-	    }
-
 	    // Unencrypted sample.
-	    if (!ivSize || !encrypted)
-	        goto free_resources;
-
-	    GST_TRACE_OBJECT(trans, "protection meta: %" GST_PTR_FORMAT, protectionMeta->info);
-	    if (!gst_structure_get_uint(protectionMeta->info, "subsample_count",
-	            &subSampleCount))
+	    if (!info.encrypted)
 	    {
-	        GST_ERROR_OBJECT(aampcdmidecryptor,
-	                "failed to get subsample_count");
-	        result = GST_FLOW_NOT_SUPPORTED;
+	        gst_aampcdmidecryptor_stats_clear(aampcdmidecryptor, map.size);
 	        goto free_resources;
 	    }
+	    subSampleCount = info.subSampleCount;
+	    pattern = info.pattern;
+	    cryptBlocks = info.cryptBlocks;
+	    skipBlocks = info.skipBlocks;
 
-	    value = gst_structure_get_value(protectionMeta->info, "iv");
-	    if (!value)
-	    {
-	        GST_ERROR_OBJECT(aampcdmidecryptor, "Failed to get IV for sample");
-	        result = GST_FLOW_NOT_SUPPORTED;
-	        goto free_resources;
-	    }
+	    session = state->drmSession;
+	    subsampleDecryptor = state->subsampleDecryptor;
+	    patternDecryptor = state->patternDecryptor;
 
-	    ivBuffer = gst_value_get_buffer(value);
-	    if (!gst_buffer_map(ivBuffer, &ivMap, GST_MAP_READ))
-	    {
-	        GST_ERROR_OBJECT(aampcdmidecryptor, "Failed to map IV");
-	        result = GST_FLOW_NOT_SUPPORTED;
-	        goto free_resources;
-	    }
+	    // reads the subsample table in place
+	    gst_byte_reader_init(reader, info.subsamples, info.subsamplesSize);
 
-	    if (subSampleCount)
+	    GST_TRACE_OBJECT(aampcdmidecryptor, "position: %d, size: %d", position,
+	            map.size);
+
+	    // cbcs: only the crypt blocks of the pattern are encrypted and the CBC chain restarts
+	    // from the IV in every subsample, always decrypted in place
+	    if (pattern)
 	    {
-	        value = gst_structure_get_value(protectionMeta->info, "subsamples");
-	        if (!value)
+	        // AampDrmSession::decrypt has no cipher mode, it would decrypt the blocks as cenc
+	        if (!patternDecryptor)
 	        {
-	            GST_ERROR_OBJECT(aampcdmidecryptor,
-	                    "Failed to get subsamples");
+	            GST_ERROR_OBJECT(aampcdmidecryptor, "cbcs needs a pattern capable session");
 	            result = GST_FLOW_NOT_SUPPORTED;
 	            goto free_resources;
 	        }
-	        subsamplesBuffer = gst_value_get_buffer(value);
-	        if (!gst_buffer_map(subsamplesBuffer, &subSamplesMap, GST_MAP_READ))
+	        rangeCount = subSampleCount ? subSampleCount : 1;
+	        if (rangeCount > aampcdmidecryptor->rangesSize)
+	        {
+	            aampcdmidecryptor->ranges = g_renew(AampDecryptRange, aampcdmidecryptor->ranges, rangeCount);
+	            aampcdmidecryptor->rangesSize = rangeCount;
+	            gst_aampcdmidecryptor_stats_alloc(aampcdmidecryptor, 1);
+	        }
+	        aampcdmidecryptor->ranges[0].clearBytes = 0;
+	        aampcdmidecryptor->ranges[0].encryptedBytes = map.size;
+
+	        gsize total = subSampleCount ? 0 : map.size;
+	        for (i = 0; i < subSampleCount; i++)
+	        {
+	            if (!gst_byte_reader_get_uint16_be(reader, &nBytesClear)
+	                    || !gst_byte_reader_get_uint32_be(reader, &nBytesEncrypted))
+	            {
+	                result = GST_FLOW_NOT_SUPPORTED;
+	                GST_INFO_OBJECT(aampcdmidecryptor, "unsupported");
+	                goto free_resources;
+	            }
+	            total += (gsize)nBytesClear + nBytesEncrypted;
+	            aampcdmidecryptor->ranges[i].clearBytes = nBytesClear;
+	            aampcdmidecryptor->ranges[i].encryptedBytes = nBytesEncrypted;
+	        }
+	        if (total > map.size)
 	        {
-	            GST_ERROR_OBJECT(aampcdmidecryptor,
-	                    "Failed to map subsample buffer");
+	            GST_ERROR_OBJECT(aampcdmidecryptor, "subsamples cover %" G_GSIZE_FORMAT " bytes of %" G_GSIZE_FORMAT " byte sample", total, map.size);
 	            result = GST_FLOW_NOT_SUPPORTED;
 	            goto free_resources;
 	        }
+	        for (i = 0; i < rangeCount; i++)
+	        {
+	            cbData += gst_aampcdmidecryptor_pattern_bytes(aampcdmidecryptor->ranges[i].encryptedBytes, cryptBlocks, skipBlocks);
+	        }
+	        inPlace = TRUE;
 	    }
-
-	    reader = gst_byte_reader_new(subSamplesMap.data, subSamplesMap.size);
-	    if (!reader)
+	    // decrypt the encrypted ranges in place when the session supports it,
+	    // avoiding the gather and scatter copies below
+	    else if (subSampleCount > 0 && subsampleDecryptor
+	#if defined(USE_SAGE_SVP) && defined(USE_OPENCDM)
+	            && aampcdmidecryptor->ignoreSVP
+	#endif
+	            )
 	    {
-	        GST_ERROR_OBJECT(aampcdmidecryptor,
-	                "Failed to allocate subsample reader");
-	        result = GST_FLOW_NOT_SUPPORTED;
-	        goto free_resources;
-	    }
-
-	    GST_TRACE_OBJECT(aampcdmidecryptor, "position: %d, size: %d", position,
-	            map.size);
+	        if (subSampleCount > aampcdmidecryptor->rangesSize)
+	        {
+	            aampcdmidecryptor->ranges = g_renew(AampDecryptRange, aampcdmidecryptor->ranges, subSampleCount);
+	            aampcdmidecryptor->rangesSize = subSampleCount;
+	            gst_aampcdmidecryptor_stats_alloc(aampcdmidecryptor, 1);
+	        }
 
+	        gsize total = 0;
+	        for (i = 0; i < subSampleCount; i++)
+	        {
+	            if (!gst_byte_reader_get_uint16_be(reader, &nBytesClear)
+	                    || !gst_byte_reader_get_uint32_be(reader, &nBytesEncrypted))
+	            {
+	                result = GST_FLOW_NOT_SUPPORTED;
+	                GST_INFO_OBJECT(aampcdmidecryptor, "unsupported");
+	                goto free_resources;
+	            }
+	            total += (gsize)nBytesClear + nBytesEncrypted;
+	            aampcdmidecryptor->ranges[i].clearBytes = nBytesClear;
+	            aampcdmidecryptor->ranges[i].encryptedBytes = nBytesEncrypted;
+	            cbData += nBytesEncrypted;
+	        }
+	        if (total > map.size)
+	        {
+	            GST_ERROR_OBJECT(aampcdmidecryptor, "subsamples cover %" G_GSIZE_FORMAT " bytes of %" G_GSIZE_FORMAT " byte sample", total, map.size);
+	            result = GST_FLOW_NOT_SUPPORTED;
+	            goto free_resources;
+	        }
+	        inPlace = TRUE;
+	    }
 	    // collect all the encrypted bytes into one contiguous buffer
 	    // we need to call decrypt once for all encrypted bytes.
-	    if (subSampleCount > 0)
+	    else if (subSampleCount > 0)
 	    {
 	#if defined(USE_SAGE_SVP) && defined(USE_OPENCDM)
 			if(aampcdmidecryptor->ignoreSVP)
 			{
-				pbData = g_malloc0(map.size);
+				pbData = gst_aampcdmidecryptor_get_scratch(aampcdmidecryptor, map.size);
 			}
 			else
 			{
-				pbData = g_malloc0(map.size + sizeof(Rpc_Secbuf_Info));
+				pbData = gst_aampcdmidecryptor_get_scratch(aampcdmidecryptor, map.size + sizeof(Rpc_Secbuf_Info));
 			}
 	#else
-	        pbData = g_malloc0(map.size);
+	        pbData = gst_aampcdmidecryptor_get_scratch(aampcdmidecryptor, map.size);
 	#endif
+	        if (!pbData)
+	        {
+	            result = GST_FLOW_ERROR;
+	            goto free_resources;
+	        }
 	        uint8_t *pbCurrTarget = (uint8_t *) pbData;
 
 	        uint32_t iCurrSource = 0;
@@ -954,7 +1933,12 @@ static GstFlowReturn gst_aampcdmidecryptor_transform_ip(
 			}
 			else
 			{
-				pbData = g_malloc0(map.size + sizeof(Rpc_Secbuf_Info));
+				pbData = gst_aampcdmidecryptor_get_scratch(aampcdmidecryptor, map.size + sizeof(Rpc_Secbuf_Info));
+				if (!pbData)
+				{
+					result = GST_FLOW_ERROR;
+					goto free_resources;
+				}
 				memcpy(pbData, map.data, map.size);
 			}
 	#else
@@ -965,62 +1949,56 @@ static GstFlowReturn gst_aampcdmidecryptor_transform_ip(
 	    if (cbData == 0)
 	    {
 		// Free resources for unencrypted bytes.
+	        gst_aampcdmidecryptor_stats_clear(aampcdmidecryptor, map.size);
 	        goto free_resources;
 	    }
+	    encryptedBytes = cbData;
 
 	#if defined(USE_SAGE_SVP) && defined(USE_OPENCDM)
-			if(!aampcdmidecryptor->ignoreSVP)
+			if(!aampcdmidecryptor->ignoreSVP && !inPlace)
 			{
+				// the arena is not zero filled, only the secure buffer info trailer needs clearing
+				memset((uint8_t *)pbData + cbData, 0, sizeof(Rpc_Secbuf_Info));
 				cbData += sizeof(Rpc_Secbuf_Info);
 			}
 	#endif
 
-	    errorCode = aampcdmidecryptor->drmSession->decrypt(
-	            static_cast<uint8_t *>(ivMap.data), static_cast<uint32_t>(ivMap.size),
-	            (uint8_t *)pbData, cbData, &pOpaqueData);
-
-	    if (errorCode != 0 || aampcdmidecryptor->hdcpOpProtectionFailCount)
+	    start = g_get_monotonic_time();
+	    if (pattern)
 	    {
-
-			if(errorCode == HDCP_OUTPUT_PROTECTION_FAILURE)
-			{
-				aampcdmidecryptor->hdcpOpProtectionFailCount++;
-			}
-			else if(aampcdmidecryptor->hdcpOpProtectionFailCount)
-			{
-				if(aampcdmidecryptor->hdcpOpProtectionFailCount >= DECRYPT_FAILURE_THRESHOLD) {
-					GstStructure *newmsg = gst_structure_new("HDCPProtectionFailure", "message", G_TYPE_STRING,"HDCP Output Protection Error", NULL);
-					gst_element_post_message(reinterpret_cast<GstElement*>(aampcdmidecryptor),gst_message_new_application (GST_OBJECT (aampcdmidecryptor), newmsg));
-				}
-				aampcdmidecryptor->hdcpOpProtectionFailCount = 0;
-			}
-			else
-			{
-				GST_ERROR_OBJECT(aampcdmidecryptor, "decryption failed; error code %d\n",errorCode);
-				aampcdmidecryptor->decryptFailCount++;
-				if(aampcdmidecryptor->decryptFailCount >= DECRYPT_FAILURE_THRESHOLD && aampcdmidecryptor->notifyDecryptError )
-				{
-					aampcdmidecryptor->notifyDecryptError = false;
-					GError *error;
-					if(errorCode == HDCP_COMPLIANCE_CHECK_FAILURE)
-					{
-						// Failure - 2.2 vs 1.4 HDCP
-						error = g_error_new(GST_STREAM_ERROR , GST_STREAM_ERROR_FAILED, "HDCP Compliance Check Failure");
-					}
-					else
-					{
-						error = g_error_new(GST_STREAM_ERROR , GST_STREAM_ERROR_FAILED, "Decrypt Error: code %d", errorCode);
-					}
-					gst_element_post_message(reinterpret_cast<GstElement*>(aampcdmidecryptor), gst_message_new_error (GST_OBJECT (aampcdmidecryptor), error, "Decrypt Failed"));
-					result = GST_FLOW_ERROR;
-				}
-				goto free_resources;
-			}
+	        errorCode = patternDecryptor->decryptPattern(
+	                const_cast<uint8_t *>(info.iv), static_cast<uint32_t>(info.ivLength),
+	                map.data, static_cast<uint32_t>(map.size), aampcdmidecryptor->ranges, rangeCount,
+	                cryptBlocks, skipBlocks, &pOpaqueData);
+	    }
+	    else if (inPlace)
+	    {
+	        errorCode = subsampleDecryptor->decryptSubsamples(
+	                const_cast<uint8_t *>(info.iv), static_cast<uint32_t>(info.ivLength),
+	                map.data, static_cast<uint32_t>(map.size), aampcdmidecryptor->ranges, subSampleCount, &pOpaqueData);
 	    }
 	    else
 	    {
-	        aampcdmidecryptor->decryptFailCount = 0;
-		aampcdmidecryptor->hdcpOpProtectionFailCount = 0;
+	        errorCode = session->decrypt(
+	                const_cast<uint8_t *>(info.iv), static_cast<uint32_t>(info.ivLength),
+	                (uint8_t *)pbData, cbData, &pOpaqueData);
+	    }
+	    gst_aampcdmidecryptor_stats_call(aampcdmidecryptor, start);
+	    gst_aampcdmidecryptor_stats_sample(aampcdmidecryptor, map.size, encryptedBytes, subSampleCount, errorCode);
+
+	    // failure counters and profiling are shared with the batch path
+	    gst_aampcdmidecryptor_lock_decrypt(aampcdmidecryptor);
+	    mutexLocked = TRUE;
+
+	    hdcpFailing = (aampcdmidecryptor->hdcpOpProtectionFailCount != 0);
+	    result = gst_aampcdmidecryptor_decrypt_result(aampcdmidecryptor, errorCode);
+	    // samples failing HDCP output protection are still passed on
+	    if (errorCode != 0 && errorCode != HDCP_OUTPUT_PROTECTION_FAILURE && !hdcpFailing)
+	    {
+	        goto free_resources;
+	    }
+	    if (errorCode == 0)
+	    {
 	        if (aampcdmidecryptor->streamtype == eMEDIATYPE_AUDIO)
 	        {
 	            GST_DEBUG_OBJECT(aampcdmidecryptor, "Decryption successful for Audio packets");
@@ -1046,99 +2024,847 @@ static GstFlowReturn gst_aampcdmidecryptor_transform_ip(
 	        aampcdmidecryptor->firstsegprocessed = true;
 	    }
 
-	    if(pOpaqueData)
-	    {
-	#if defined(USE_SAGE_SVP) && defined(USE_OPENCDM)
-			//Need the real size for the following call.
-			cbData -= sizeof(Rpc_Secbuf_Info);
-	#endif
-	        // If there is opaque data then SVP is enabled and append
-	        // the sample buffer with the SVP data.  There is no encryped
-	        // data that can be copied back into host memory
+	    if(pOpaqueData)
+	    {
+	#if defined(USE_SAGE_SVP) && defined(USE_OPENCDM)
+			//Need the real size for the following call.
+			if (!inPlace)
+			{
+				cbData -= sizeof(Rpc_Secbuf_Info);
+			}
+	#endif
+	        // If there is opaque data then SVP is enabled and append
+	        // the sample buffer with the SVP data.  There is no encryped
+	        // data that can be copied back into host memory
+
+	        // a whole cbcs sample is one secure chunk of the sample size
+	        gst_add_svp_meta_data(buffer, pOpaqueData, pattern ? map.size : cbData, subSampleCount, reader);
+	    }
+	    else if (subSampleCount > 0 && !inPlace)
+	    {
+	        // If subsample mapping is used, copy decrypted bytes back
+	        // to the original buffer.
+	        gst_byte_reader_set_pos(reader, 0);
+
+	        uint8_t *pbCurrTarget = map.data;
+	        uint32_t iCurrSource = 0;
+
+	        for (int i = 0; i < subSampleCount; i++)
+	        {
+	            if (!gst_byte_reader_get_uint16_be(reader, &nBytesClear)
+	                    || !gst_byte_reader_get_uint32_be(reader, &nBytesEncrypted))
+	            {
+	                result = GST_FLOW_NOT_SUPPORTED;
+	                GST_INFO_OBJECT(aampcdmidecryptor, "unsupported");
+	                goto free_resources;
+	            }
+	            // Skip the clear byte range from target buffer.
+	            pbCurrTarget += nBytesClear;
+
+	            //gst_util_dump_mem(pbData,cbData);
+	            // Copy decrypted bytes from pbData to target buffer.
+	            memcpy(pbCurrTarget, (uint8_t*)pbData + iCurrSource, nBytesEncrypted);
+
+	            // Adjust current pointer of target buffer.
+	            pbCurrTarget += nBytesEncrypted;
+
+	            // Adjust current offset of source buffer.
+	            iCurrSource += nBytesEncrypted;
+	        }
+	    }
+
+	    free_resources:
+
+	    if (!aampcdmidecryptor->firstsegprocessed
+	            && aampcdmidecryptor->aamp)
+	    {
+           if (aampcdmidecryptor->streamtype == eMEDIATYPE_VIDEO)
+           {
+               aampcdmidecryptor->aamp->profiler.ProfileError(PROFILE_BUCKET_DECRYPT_VIDEO, (int)result);
+           }
+           else if (aampcdmidecryptor->streamtype == eMEDIATYPE_AUDIO)
+           {
+               aampcdmidecryptor->aamp->profiler.ProfileError(PROFILE_BUCKET_DECRYPT_AUDIO, (int)result);
+           }
+	       aampcdmidecryptor->firstsegprocessed = true;
+        }
+
+	    if (bufferMapped)
+	        gst_buffer_unmap(buffer, &map);
+
+	    gst_aampcdmidecryptor_release_info(&info);
+
+	    if (info.meta)
+	        gst_buffer_remove_meta(buffer, info.meta);
+
+	    if (mutexLocked)
+	        g_mutex_unlock(&aampcdmidecryptor->mutex);
+	    gst_aampcdmidecryptor_state_unref(state);
+	    return result;
+	}
+
+#endif
+
+
+/*
+ Reports the outcome of a decrypt call: counts failures, posts HDCP and decrypt error
+ messages past DECRYPT_FAILURE_THRESHOLD. Returns GST_FLOW_ERROR once the error is posted.
+ Called with mutex held.
+ */
+static GstFlowReturn gst_aampcdmidecryptor_decrypt_result(GstAampCDMIDecryptor* aampcdmidecryptor, int errorCode)
+{
+    GstFlowReturn result = GST_FLOW_OK;
+
+    if (errorCode != 0 || aampcdmidecryptor->hdcpOpProtectionFailCount)
+    {
+        if (errorCode == HDCP_OUTPUT_PROTECTION_FAILURE)
+        {
+            aampcdmidecryptor->hdcpOpProtectionFailCount++;
+        }
+        else if (aampcdmidecryptor->hdcpOpProtectionFailCount)
+        {
+            if (aampcdmidecryptor->hdcpOpProtectionFailCount >= DECRYPT_FAILURE_THRESHOLD)
+            {
+                GstStructure *newmsg = gst_structure_new("HDCPProtectionFailure", "message", G_TYPE_STRING, "HDCP Output Protection Error", NULL);
+                gst_element_post_message(reinterpret_cast<GstElement*>(aampcdmidecryptor), gst_message_new_application(GST_OBJECT(aampcdmidecryptor), newmsg));
+            }
+            aampcdmidecryptor->hdcpOpProtectionFailCount = 0;
+        }
+        else
+        {
+            GST_ERROR_OBJECT(aampcdmidecryptor, "decryption failed; error code %d\n", errorCode);
+            aampcdmidecryptor->decryptFailCount++;
+            if (aampcdmidecryptor->decryptFailCount >= DECRYPT_FAILURE_THRESHOLD && aampcdmidecryptor->notifyDecryptError)
+            {
+                aampcdmidecryptor->notifyDecryptError = false;
+                GError *error;
+                if (errorCode == HDCP_COMPLIANCE_CHECK_FAILURE)
+                {
+                    // Failure - 2.2 vs 1.4 HDCP
+                    error = g_error_new(GST_STREAM_ERROR, GST_STREAM_ERROR_FAILED, "HDCP Compliance Check Failure");
+                }
+                else
+                {
+                    error = g_error_new(GST_STREAM_ERROR, GST_STREAM_ERROR_FAILED, "Decrypt Error: code %d", errorCode);
+                }
+                gst_element_post_message(reinterpret_cast<GstElement*>(aampcdmidecryptor), gst_message_new_error(GST_OBJECT(aampcdmidecryptor), error, "Decrypt Failed"));
+                result = GST_FLOW_ERROR;
+            }
+        }
+    }
+    else
+    {
+        aampcdmidecryptor->decryptFailCount = 0;
+        aampcdmidecryptor->hdcpOpProtectionFailCount = 0;
+    }
+    return result;
+}
+
+/*
+ Releases the resources held by a pending sample and strips its protection meta.
+ Returns the sample's buffer.
+ */
+static GstBuffer* gst_aampcdmidecryptor_release_sample(AampCDMIPendingSample* sample)
+{
+    GstBuffer* buffer = sample->buffer;
+
+    gst_aampcdmidecryptor_release_info(&sample->info);
+    gst_buffer_unmap(buffer, &sample->map);
+    gst_buffer_remove_meta(buffer, sample->info.meta);
+    g_free(sample->ranges);
+    gst_aampcdmidecryptor_state_unref(sample->state);
+    g_slice_free(AampCDMIPendingSample, sample);
+    return buffer;
+}
+
+/*
+ Checks if buffer can join a batch and prepares it for decryption. Returns NULL for clear
+ samples and anything the regular path should handle, leaving buffer untouched.
+ */
+static AampCDMIPendingSample* gst_aampcdmidecryptor_prepare_sample(GstAampCDMIDecryptor* aampcdmidecryptor, GstBuffer** buffer)
+{
+    // in element decryption takes the regular path
+    if (aampcdmidecryptor->localDecrypt)
+    {
+        return NULL;
+    }
+
+    GstAampCDMISessionState* state = gst_aampcdmidecryptor_state_get(aampcdmidecryptor);
+    AampCDMIPendingSample* sample = g_slice_new0(AampCDMIPendingSample);
+    AampCDMISampleInfo* info = &sample->info;
+    sample->state = state;
+
+    // clear, malformed and cbcs samples take the regular path
+    if (!state->drmSession || !gst_aampcdmidecryptor_parse_info(aampcdmidecryptor, *buffer, info)
+            || !info->encrypted || !info->kid || info->pattern)
+    {
+        gst_aampcdmidecryptor_release_info(info);
+        gst_aampcdmidecryptor_state_unref(state);
+        g_slice_free(AampCDMIPendingSample, sample);
+        return NULL;
+    }
+    gst_aampcdmidecryptor_stats_alloc(aampcdmidecryptor, 1);
+
+    if (info->subSampleCount)
+    {
+        GstByteReader reader;
+        gst_byte_reader_init(&reader, info->subsamples, info->subsamplesSize);
+        sample->ranges = g_new(AampDecryptRange, info->subSampleCount);
+        sample->rangeCount = info->subSampleCount;
+        gst_aampcdmidecryptor_stats_alloc(aampcdmidecryptor, 1);
+        for (guint i = 0; i < info->subSampleCount; i++)
+        {
+            guint16 nBytesClear = 0;
+            guint32 nBytesEncrypted = 0;
+            if (!gst_byte_reader_get_uint16_be(&reader, &nBytesClear)
+                    || !gst_byte_reader_get_uint32_be(&reader, &nBytesEncrypted))
+            {
+                gst_aampcdmidecryptor_release_info(info);
+                g_free(sample->ranges);
+                gst_aampcdmidecryptor_state_unref(state);
+                g_slice_free(AampCDMIPendingSample, sample);
+                return NULL;
+            }
+            sample->ranges[i].clearBytes = nBytesClear;
+            sample->ranges[i].encryptedBytes = nBytesEncrypted;
+        }
+    }
+
+    // decrypting in place, the payload must not be shared. A copy has its own meta
+    // to parse, the views into the old one are dropped first
+    if (!gst_buffer_is_writable(*buffer))
+    {
+        gst_aampcdmidecryptor_release_info(info);
+        *buffer = gst_buffer_make_writable(*buffer);
+        gst_aampcdmidecryptor_parse_info(aampcdmidecryptor, *buffer, info);
+    }
+    sample->buffer = *buffer;
+
+    if (!info->encrypted || !gst_buffer_map(*buffer, &sample->map, static_cast<GstMapFlags>(GST_MAP_READWRITE)))
+    {
+        gst_aampcdmidecryptor_release_info(info);
+        g_free(sample->ranges);
+        gst_aampcdmidecryptor_state_unref(state);
+        g_slice_free(AampCDMIPendingSample, sample);
+        return NULL;
+    }
+    return sample;
+}
+
+/*
+ Checks if two key ids are the same
+ */
+static gboolean gst_aampcdmidecryptor_same_kid(const AampCDMISampleInfo* info1, const AampCDMISampleInfo* info2)
+{
+    return info1->kidLength == info2->kidLength && !memcmp(info1->kid, info2->kid, info1->kidLength);
+}
+
+/*
+ Accounts for the decrypt result of a sample and queues its buffer for output, unless
+ result or the sample's outcome is an error. Returns the updated result. Called with mutex held.
+ */
+static GstFlowReturn gst_aampcdmidecryptor_complete_sample(GstAampCDMIDecryptor* aampcdmidecryptor,
+        AampCDMIPendingSample* sample, int errorCode, GstFlowReturn result)
+{
+    gsize encryptedBytes = sample->rangeCount ? 0 : sample->map.size;
+    for (guint i = 0; i < sample->rangeCount; i++)
+    {
+        encryptedBytes += sample->ranges[i].encryptedBytes;
+    }
+    gst_aampcdmidecryptor_stats_sample(aampcdmidecryptor, sample->map.size, encryptedBytes, sample->rangeCount, errorCode);
+
+    if (result == GST_FLOW_OK)
+    {
+        result = gst_aampcdmidecryptor_decrypt_result(aampcdmidecryptor, errorCode);
+    }
+    GstBuffer* buffer = gst_aampcdmidecryptor_release_sample(sample);
+    if (result == GST_FLOW_OK)
+    {
+        g_queue_push_tail(&aampcdmidecryptor->ready, buffer);
+    }
+    else
+    {
+        gst_buffer_unref(buffer);
+    }
+    return result;
+}
+
+/*
+ Decrypts the pending samples with one batch call and queues them, in order, for output.
+ */
+static GstFlowReturn gst_aampcdmidecryptor_process_batch(GstAampCDMIDecryptor* aampcdmidecryptor)
+{
+    GstFlowReturn result = GST_FLOW_OK;
+    guint count = g_queue_get_length(&aampcdmidecryptor->pending);
+
+    if (!count)
+    {
+        return GST_FLOW_OK;
+    }
+
+    AampDecryptSample* samples = g_newa(AampDecryptSample, count);
+    // samples of a batch share a KID, hence the session
+    GstAampCDMISessionState* state = ((AampCDMIPendingSample*) g_queue_peek_head(&aampcdmidecryptor->pending))->state;
+    guint index = 0;
+    for (GList* l = aampcdmidecryptor->pending.head; l; l = l->next, index++)
+    {
+        AampCDMIPendingSample* sample = (AampCDMIPendingSample*) l->data;
+        samples[index].iv = sample->info.iv;
+        samples[index].ivLen = sample->info.ivLength;
+        samples[index].data = sample->map.data;
+        samples[index].dataLen = sample->map.size;
+        samples[index].ranges = sample->ranges;
+        samples[index].rangeCount = sample->rangeCount;
+        samples[index].result = 0;
+    }
+
+    int errorCode = -1;
+    if (state->batchDecryptor)
+    {
+        gint64 start = g_get_monotonic_time();
+        errorCode = state->batchDecryptor->decryptBatch(samples, count);
+        gst_aampcdmidecryptor_stats_call(aampcdmidecryptor, start);
+    }
+    GST_TRACE_OBJECT(aampcdmidecryptor, "decrypted batch of %u samples, error code %d", count, errorCode);
+
+    gst_aampcdmidecryptor_lock_decrypt(aampcdmidecryptor);
+    for (index = 0; index < count; index++)
+    {
+        AampCDMIPendingSample* sample = (AampCDMIPendingSample*) g_queue_pop_head(&aampcdmidecryptor->pending);
+        result = gst_aampcdmidecryptor_complete_sample(aampcdmidecryptor, sample, errorCode ? errorCode : samples[index].result, result);
+    }
+    g_mutex_unlock(&aampcdmidecryptor->mutex);
+    return result;
+}
+
+/*
+ Decrypts one sample on a worker thread. Uses the session's in place interface when
+ available, otherwise gathers the encrypted ranges into the worker's scratch buffer.
+ */
+static int gst_aampcdmidecryptor_decrypt_sample(GstAampCDMIDecryptor* aampcdmidecryptor, AampCDMIPendingSample* sample)
+{
+    uint8_t* pOpaqueData = NULL;
+    int errorCode;
+
+    if (sample->state->subsampleDecryptor && sample->rangeCount)
+    {
+        return sample->state->subsampleDecryptor->decryptSubsamples(const_cast<uint8_t *>(sample->info.iv), sample->info.ivLength,
+                sample->map.data, sample->map.size, sample->ranges, sample->rangeCount, &pOpaqueData);
+    }
+    if (!sample->rangeCount)
+    {
+        return sample->state->drmSession->decrypt(const_cast<uint8_t *>(sample->info.iv), sample->info.ivLength,
+                sample->map.data, sample->map.size, &pOpaqueData);
+    }
+
+    AampCDMIWorkerScratch* scratch = (AampCDMIWorkerScratch*) g_private_get(&workerScratch);
+    if (!scratch)
+    {
+        scratch = g_slice_new0(AampCDMIWorkerScratch);
+        g_private_set(&workerScratch, scratch);
+    }
+    if (sample->map.size > scratch->size)
+    {
+        g_free(scratch->data);
+        scratch->size = (sample->map.size + SCRATCH_GRANULARITY - 1) & ~((gsize)SCRATCH_GRANULARITY - 1);
+        scratch->data = (guint8*) g_malloc(scratch->size);
+        gst_aampcdmidecryptor_stats_alloc(aampcdmidecryptor, 1);
+    }
+
+    gsize offset = 0;
+    uint32_t cbData = 0;
+    for (guint i = 0; i < sample->rangeCount; i++)
+    {
+        offset += sample->ranges[i].clearBytes;
+        if (offset + sample->ranges[i].encryptedBytes > sample->map.size)
+        {
+            return -1;
+        }
+        memcpy(scratch->data + cbData, sample->map.data + offset, sample->ranges[i].encryptedBytes);
+        offset += sample->ranges[i].encryptedBytes;
+        cbData += sample->ranges[i].encryptedBytes;
+    }
+    if (!cbData)
+    {
+        return 0;
+    }
+
+    errorCode = sample->state->drmSession->decrypt(const_cast<uint8_t *>(sample->info.iv), sample->info.ivLength,
+            scratch->data, cbData, &pOpaqueData);
+    if (errorCode == 0)
+    {
+        offset = 0;
+        cbData = 0;
+        for (guint i = 0; i < sample->rangeCount; i++)
+        {
+            offset += sample->ranges[i].clearBytes;
+            memcpy(sample->map.data + offset, scratch->data + cbData, sample->ranges[i].encryptedBytes);
+            offset += sample->ranges[i].encryptedBytes;
+            cbData += sample->ranges[i].encryptedBytes;
+        }
+    }
+    return errorCode;
+}
+
+static void gst_aampcdmidecryptor_worker(gpointer data, gpointer user_data)
+{
+    AampCDMIPendingSample* sample = (AampCDMIPendingSample*) data;
+    GstAampCDMIDecryptor* aampcdmidecryptor = GST_AAMP_CDMI_DECRYPTOR(user_data);
+
+    gint64 start = g_get_monotonic_time();
+    int errorCode = gst_aampcdmidecryptor_decrypt_sample(aampcdmidecryptor, sample);
+    gst_aampcdmidecryptor_stats_call(aampcdmidecryptor, start);
+
+    g_mutex_lock(&aampcdmidecryptor->workMutex);
+    sample->errorCode = errorCode;
+    sample->done = TRUE;
+    g_cond_broadcast(&aampcdmidecryptor->workDone);
+    g_mutex_unlock(&aampcdmidecryptor->workMutex);
+}
+
+/*
+ Moves samples finished by the workers to the output queue, in arrival order, waiting
+ until no more than keep samples are in flight.
+ */
+static GstFlowReturn gst_aampcdmidecryptor_collect(GstAampCDMIDecryptor* aampcdmidecryptor, guint keep)
+{
+    GstFlowReturn result = GST_FLOW_OK;
+
+    g_mutex_lock(&aampcdmidecryptor->workMutex);
+    for (;;)
+    {
+        AampCDMIPendingSample* sample = (AampCDMIPendingSample*) g_queue_peek_head(&aampcdmidecryptor->inflight);
+        if (!sample)
+        {
+            break;
+        }
+        if (!sample->done)
+        {
+            if (g_queue_get_length(&aampcdmidecryptor->inflight) <= keep)
+            {
+                break;
+            }
+            g_cond_wait(&aampcdmidecryptor->workDone, &aampcdmidecryptor->workMutex);
+            continue;
+        }
+        g_queue_pop_head(&aampcdmidecryptor->inflight);
+        g_mutex_unlock(&aampcdmidecryptor->workMutex);
+
+        gst_aampcdmidecryptor_lock_decrypt(aampcdmidecryptor);
+        result = gst_aampcdmidecryptor_complete_sample(aampcdmidecryptor, sample, sample->errorCode, result);
+        g_mutex_unlock(&aampcdmidecryptor->mutex);
+
+        g_mutex_lock(&aampcdmidecryptor->workMutex);
+    }
+    g_mutex_unlock(&aampcdmidecryptor->workMutex);
+    return result;
+}
+
+/*
+ Decrypts the samples held while a license was being acquired and queues them for output.
+ With wait set, waits for the pending session first; otherwise returns without releasing
+ anything while it is still pending. Called on the streaming thread.
+ */
+static GstFlowReturn gst_aampcdmidecryptor_release_held(GstAampCDMIDecryptor* aampcdmidecryptor, gboolean wait)
+{
+    GstFlowReturn result = GST_FLOW_OK;
+    GstBuffer* buffer;
+
+    if (g_queue_is_empty(&aampcdmidecryptor->licenseWait))
+    {
+        return GST_FLOW_OK;
+    }
+
+    g_mutex_lock(&aampcdmidecryptor->mutex);
+    if (wait && aampcdmidecryptor->licensePending && aampcdmidecryptor->canWait)
+    {
+        gint64 start = g_get_monotonic_time();
+        do
+        {
+            g_cond_wait(&aampcdmidecryptor->condition, &aampcdmidecryptor->mutex);
+        } while (aampcdmidecryptor->licensePending && aampcdmidecryptor->canWait);
+        gst_aampcdmidecryptor_stats_key_wait(aampcdmidecryptor, start);
+    }
+    gboolean pending = aampcdmidecryptor->licensePending && aampcdmidecryptor->canWait;
+    g_mutex_unlock(&aampcdmidecryptor->mutex);
+    if (pending)
+    {
+        return GST_FLOW_OK;
+    }
+
+    GST_DEBUG_OBJECT(aampcdmidecryptor, "releasing %u samples held for license",
+            g_queue_get_length(&aampcdmidecryptor->licenseWait));
+    while ((buffer = (GstBuffer*) g_queue_pop_head(&aampcdmidecryptor->licenseWait)) != NULL)
+    {
+        if (result == GST_FLOW_OK)
+        {
+            result = gst_aampcdmidecryptor_transform_ip(GST_BASE_TRANSFORM(aampcdmidecryptor), buffer);
+        }
+        if (result == GST_FLOW_OK)
+        {
+            g_queue_push_tail(&aampcdmidecryptor->ready, buffer);
+        }
+        else
+        {
+            gst_buffer_unref(buffer);
+        }
+    }
+    return result;
+}
+
+/*
+ Decrypts pending samples and pushes everything queued for output. Used before serialized
+ events so that buffers and events keep their order. Called on the streaming thread.
+ */
+static GstFlowReturn gst_aampcdmidecryptor_drain(GstAampCDMIDecryptor* aampcdmidecryptor)
+{
+    GstFlowReturn result = gst_aampcdmidecryptor_release_held(aampcdmidecryptor, TRUE);
+    GstFlowReturn batched = gst_aampcdmidecryptor_process_batch(aampcdmidecryptor);
+    GstFlowReturn collected = gst_aampcdmidecryptor_collect(aampcdmidecryptor, 0);
+    GstBuffer* buffer;
+
+    if (result == GST_FLOW_OK)
+    {
+        result = batched;
+    }
+
+    if (result == GST_FLOW_OK)
+    {
+        result = collected;
+    }
+    while ((buffer = (GstBuffer*) g_queue_pop_head(&aampcdmidecryptor->ready)) != NULL)
+    {
+        if (result == GST_FLOW_OK)
+        {
+            result = gst_pad_push(GST_BASE_TRANSFORM_SRC_PAD(aampcdmidecryptor), buffer);
+        }
+        else
+        {
+            gst_buffer_unref(buffer);
+        }
+    }
+    return result;
+}
+
+/*
+ Drops pending and decrypted samples, on flush and shutdown
+ */
+static void gst_aampcdmidecryptor_discard_pending(GstAampCDMIDecryptor* aampcdmidecryptor)
+{
+    AampCDMIPendingSample* sample;
+    GstBuffer* buffer;
+
+    while ((sample = (AampCDMIPendingSample*) g_queue_pop_head(&aampcdmidecryptor->pending)) != NULL)
+    {
+        gst_buffer_unref(gst_aampcdmidecryptor_release_sample(sample));
+    }
+    while ((buffer = (GstBuffer*) g_queue_pop_head(&aampcdmidecryptor->licenseWait)) != NULL)
+    {
+        gst_buffer_unref(buffer);
+    }
+    // workers may still be writing into samples in flight
+    g_mutex_lock(&aampcdmidecryptor->workMutex);
+    while ((sample = (AampCDMIPendingSample*) g_queue_peek_head(&aampcdmidecryptor->inflight)) != NULL)
+    {
+        if (!sample->done)
+        {
+            g_cond_wait(&aampcdmidecryptor->workDone, &aampcdmidecryptor->workMutex);
+            continue;
+        }
+        g_queue_pop_head(&aampcdmidecryptor->inflight);
+        gst_buffer_unref(gst_aampcdmidecryptor_release_sample(sample));
+    }
+    g_mutex_unlock(&aampcdmidecryptor->workMutex);
+    while ((buffer = (GstBuffer*) g_queue_pop_head(&aampcdmidecryptor->ready)) != NULL)
+    {
+        gst_buffer_unref(buffer);
+    }
+}
+
+static GstFlowReturn gst_aampcdmidecryptor_submit_input_buffer(
+        GstBaseTransform * trans, gboolean is_discont, GstBuffer * input)
+{
+    GstAampCDMIDecryptor *aampcdmidecryptor = GST_AAMP_CDMI_DECRYPTOR(trans);
+    GstFlowReturn result = GST_FLOW_OK;
+
+    // While the license worker creates a session, encrypted samples (and anything after
+    // them, to keep order) are held. Clear lead samples flow through.
+    if (!g_queue_is_empty(&aampcdmidecryptor->licenseWait)
+            || (aampcdmidecryptor->licenseQueueSize && gst_buffer_get_protection_meta(input)))
+    {
+        g_mutex_lock(&aampcdmidecryptor->mutex);
+        gboolean pending = aampcdmidecryptor->licensePending && aampcdmidecryptor->canWait;
+        if (pending)
+        {
+            g_queue_push_tail(&aampcdmidecryptor->licenseWait, gst_buffer_make_writable(input));
+            input = NULL;
+            if (aampcdmidecryptor->licensePending && aampcdmidecryptor->canWait
+                    && g_queue_get_length(&aampcdmidecryptor->licenseWait) >= aampcdmidecryptor->licenseQueueSize)
+            {
+                gint64 start = g_get_monotonic_time();
+                do
+                {
+                    g_cond_wait(&aampcdmidecryptor->condition, &aampcdmidecryptor->mutex);
+                } while (aampcdmidecryptor->licensePending && aampcdmidecryptor->canWait
+                        && g_queue_get_length(&aampcdmidecryptor->licenseWait) >= aampcdmidecryptor->licenseQueueSize);
+                gst_aampcdmidecryptor_stats_key_wait(aampcdmidecryptor, start);
+            }
+        }
+        g_mutex_unlock(&aampcdmidecryptor->mutex);
+
+        result = gst_aampcdmidecryptor_release_held(aampcdmidecryptor, FALSE);
+        if (!input)
+        {
+            return result;
+        }
+        if (result != GST_FLOW_OK)
+        {
+            gst_buffer_unref(input);
+            return result;
+        }
+    }
 
-	        gst_add_svp_meta_data(buffer, pOpaqueData, cbData, subSampleCount, reader);
-	    }
-	    else if (subSampleCount > 0)
-	    {
-	        // If subsample mapping is used, copy decrypted bytes back
-	        // to the original buffer.
-	        gst_byte_reader_set_pos(reader, 0);
+    // Parallel decryption, same preconditions as batching below. Host memory output only.
+    if (aampcdmidecryptor->decryptThreads && aampcdmidecryptor->drmSession && aampcdmidecryptor->hostOutput
+            && aampcdmidecryptor->streamReceived && aampcdmidecryptor->firstsegprocessed)
+    {
+        AampCDMIPendingSample* sample = gst_aampcdmidecryptor_prepare_sample(aampcdmidecryptor, &input);
+        if (sample)
+        {
+            if (!aampcdmidecryptor->workers)
+            {
+                aampcdmidecryptor->workers = g_thread_pool_new(gst_aampcdmidecryptor_worker, aampcdmidecryptor,
+                        aampcdmidecryptor->decryptThreads, FALSE, NULL);
+            }
+            g_mutex_lock(&aampcdmidecryptor->workMutex);
+            g_queue_push_tail(&aampcdmidecryptor->inflight, sample);
+            g_mutex_unlock(&aampcdmidecryptor->workMutex);
+            g_thread_pool_push(aampcdmidecryptor->workers, sample, NULL);
+            return gst_aampcdmidecryptor_collect(aampcdmidecryptor, aampcdmidecryptor->reorderWindow - 1);
+        }
+    }
 
-	        uint8_t *pbCurrTarget = map.data;
-	        uint32_t iCurrSource = 0;
+    // Batch only once a session with a batch interface is up and the first sample went through
+    // the regular path, which waits for the key and ends the decrypt profiling.
+    if (aampcdmidecryptor->batchSize > 1 && aampcdmidecryptor->batchDecryptor
+            && aampcdmidecryptor->streamReceived && aampcdmidecryptor->firstsegprocessed)
+    {
+        AampCDMIPendingSample* sample = gst_aampcdmidecryptor_prepare_sample(aampcdmidecryptor, &input);
+        if (sample)
+        {
+            AampCDMIPendingSample* first = (AampCDMIPendingSample*) g_queue_peek_head(&aampcdmidecryptor->pending);
+            if (first && !gst_aampcdmidecryptor_same_kid(&first->info, &sample->info))
+            {
+                result = gst_aampcdmidecryptor_process_batch(aampcdmidecryptor);
+            }
+            g_queue_push_tail(&aampcdmidecryptor->pending, sample);
+            if (result == GST_FLOW_OK && g_queue_get_length(&aampcdmidecryptor->pending) >= aampcdmidecryptor->batchSize)
+            {
+                result = gst_aampcdmidecryptor_process_batch(aampcdmidecryptor);
+            }
+            return result;
+        }
+    }
 
-	        for (int i = 0; i < subSampleCount; i++)
-	        {
-	            if (!gst_byte_reader_get_uint16_be(reader, &nBytesClear)
-	                    || !gst_byte_reader_get_uint32_be(reader, &nBytesEncrypted))
-	            {
-	                result = GST_FLOW_NOT_SUPPORTED;
-	                GST_INFO_OBJECT(aampcdmidecryptor, "unsupported");
-	                goto free_resources;
-	            }
-	            // Skip the clear byte range from target buffer.
-	            pbCurrTarget += nBytesClear;
+    // keep order: anything held back goes out before this buffer
+    result = gst_aampcdmidecryptor_process_batch(aampcdmidecryptor);
+    GstFlowReturn collected = gst_aampcdmidecryptor_collect(aampcdmidecryptor, 0);
+    if (result == GST_FLOW_OK)
+    {
+        result = collected;
+    }
+    if (result != GST_FLOW_OK)
+    {
+        gst_buffer_unref(input);
+        return result;
+    }
+    return GST_BASE_TRANSFORM_CLASS(gst_aampcdmidecryptor_parent_class)->submit_input_buffer(trans, is_discont, input);
+}
 
-	            //gst_util_dump_mem(pbData,cbData);
-	            // Copy decrypted bytes from pbData to target buffer.
-	            memcpy(pbCurrTarget, (uint8_t*)pbData + iCurrSource, nBytesEncrypted);
+static GstFlowReturn gst_aampcdmidecryptor_generate_output(
+        GstBaseTransform * trans, GstBuffer ** outbuf)
+{
+    GstAampCDMIDecryptor *aampcdmidecryptor = GST_AAMP_CDMI_DECRYPTOR(trans);
 
-	            // Adjust current pointer of target buffer.
-	            pbCurrTarget += nBytesEncrypted;
+    *outbuf = (GstBuffer*) g_queue_pop_head(&aampcdmidecryptor->ready);
+    if (*outbuf)
+    {
+        return GST_FLOW_OK;
+    }
+    return GST_BASE_TRANSFORM_CLASS(gst_aampcdmidecryptor_parent_class)->generate_output(trans, outbuf);
+}
 
-	            // Adjust current offset of source buffer.
-	            iCurrSource += nBytesEncrypted;
-	        }
-	    }
+/*
+ Creates, or attaches to another track's, DRM session for a protection event and installs it.
+ Session creation includes the license round trip and runs without holding mutex.
+ */
+static void gst_aampcdmidecryptor_create_session(GstAampCDMIDecryptor* aampcdmidecryptor, AampCDMILicenseRequest* request)
+{
+    PrivateInstanceAAMP* aamp = aampcdmidecryptor->aamp;
+    AampDRMSessionManager* sessionManager = aamp->mDRMSessionManager;
+    DrmMetaDataEventPtr e = std::make_shared<DrmMetaDataEvent>(AAMP_TUNE_FAILURE_UNKNOWN, "", 0, 0, false);
+    gsize initDataLen = 0;
+    const guint8 *initData = (const guint8 *) g_bytes_get_data(request->initData, &initDataLen);
+    guint8 kids[MAX_KID_ENTRIES][KID_SIZE];
+    guint kidCount = gst_aampcdmidecryptor_parse_kids(initData, initDataLen, kids, MAX_KID_ENTRIES);
+    AampDrmSession *session = NULL;
+    GstAampDrmSessionShare *oldShare = NULL;
+    gboolean creator = TRUE;
+
+    // waits while another track is acquiring the license for these keys
+    GstAampDrmSessionShare *share = gst_aamp_drm_session_share_acquire(sessionManager, request->systemId,
+            kids, kidCount, &creator);
+    if (!creator)
+    {
+        // the manager returns the session it holds for the keys, or acquires a new license
+        // if it freed that session since
+        GST_INFO_OBJECT(aampcdmidecryptor, "Attaching to DRM session of another track");
+    }
+    session = sessionManager->createDrmSession(
+            reinterpret_cast<const char *>(request->systemId), eMEDIAFORMAT_DASH,
+            reinterpret_cast<const unsigned char *>(initData), initDataLen,
+            request->streamtype, aamp, e, nullptr, false);
+    if (share && creator)
+    {
+        gst_aamp_drm_session_share_complete(share, NULL != session);
+    }
 
-	    free_resources:
+    g_mutex_lock(&aampcdmidecryptor->mutex);
+    GST_DEBUG_OBJECT(aampcdmidecryptor, "\n acquired lock for mutex\n");
+    oldShare = aampcdmidecryptor->sessionShare;
+    aampcdmidecryptor->sessionShare = session ? share : NULL;
+    aampcdmidecryptor->sessionManager = sessionManager;
+    gst_aampcdmidecryptor_install_session(aampcdmidecryptor, session);
+    if (NULL == aampcdmidecryptor->drmSession)
+    {
+/* For DELIA-32832 - Avoided setting 'streamReceived' as FALSE if createDrmSession() failed after a successful case.
+ * Set to FALSE is already handled on gst_aampcdmidecryptor_init() as part of initialization.
+ */
+#if 0
+        aampcdmidecryptor->streamReceived = FALSE;
+#endif /* 0 */
 
-	    if (!aampcdmidecryptor->firstsegprocessed
-	            && aampcdmidecryptor->aamp)
-	    {
-           if (aampcdmidecryptor->streamtype == eMEDIATYPE_VIDEO)
-           {
-               aampcdmidecryptor->aamp->profiler.ProfileError(PROFILE_BUCKET_DECRYPT_VIDEO, (int)result);
-           }
-           else if (aampcdmidecryptor->streamtype == eMEDIATYPE_AUDIO)
-           {
-               aampcdmidecryptor->aamp->profiler.ProfileError(PROFILE_BUCKET_DECRYPT_AUDIO, (int)result);
-           }
-	       aampcdmidecryptor->firstsegprocessed = true;
+        /* DELIA-46675-Need to reset canWait to skip condional wait in "gst_aampcdmidecryptor_transform_ip to avoid deadlock
+         *		scenario on drm session failure
+         */
+        aampcdmidecryptor->canWait = false;
+        if (aampcdmidecryptor->initDataFingerprint == request->fingerprint
+                && aampcdmidecryptor->initDataLength == request->receivedLength)
+        {
+            aampcdmidecryptor->initDataLength = 0;
+        }
+	/* session manager fails to create session when state is inactive. Skip sending error event
+	 * in this scenario. Later player will change it to active after processing SetLanguage(), or for the next Tune.
+	 */
+	if(SessionMgrState::eSESSIONMGR_ACTIVE == sessionManager->getSessionMgrState())
+	{
+		if(!aamp->licenceFromManifest)
+		{
+			AAMPTuneFailure failure = e->getFailure();
+			if(AAMP_TUNE_FAILURE_UNKNOWN != failure)
+			{
+				long responseCode = e->getResponseCode();
+				bool selfAbort = (failure == AAMP_TUNE_LICENCE_REQUEST_FAILED && (responseCode == CURLE_ABORTED_BY_CALLBACK || responseCode == CURLE_WRITE_ERROR));
+				if (!selfAbort)
+				{
+					aamp->SendErrorEvent(failure);
+				}
+				aamp->profiler.ProfileError(PROFILE_BUCKET_LA_TOTAL, (int)failure);
+				aamp->profiler.SetDrmErrorCode((int)failure);
+			}
+			else
+			{
+				aamp->profiler.ProfileError(PROFILE_BUCKET_LA_TOTAL);
+			}
+		}
+		GST_ERROR_OBJECT(aampcdmidecryptor,"Failed to create DRM Session\n");
+	}
+    }
+    else
+    {
+        aampcdmidecryptor->streamReceived = TRUE;
+        GST_DEBUG_OBJECT(aampcdmidecryptor, "DRM session %s in place subsample decryption",
+                aampcdmidecryptor->subsampleDecryptor ? "supports" : "does not support");
+        if(!aamp->licenceFromManifest)
+        {
+            aamp->profiler.ProfileEnd(
+                    PROFILE_BUCKET_LA_TOTAL);
         }
 
-	    if (bufferMapped)
-	        gst_buffer_unmap(buffer, &map);
-
-	    if (reader)
-	        gst_byte_reader_free(reader);
+        if (!aampcdmidecryptor->firstsegprocessed)
+        {
+            if (aampcdmidecryptor->streamtype == eMEDIATYPE_VIDEO)
+            {
+                aamp->profiler.ProfileBegin(
+                        PROFILE_BUCKET_DECRYPT_VIDEO);
+            } else if (aampcdmidecryptor->streamtype == eMEDIATYPE_AUDIO)
+            {
+                aamp->profiler.ProfileBegin(
+                        PROFILE_BUCKET_DECRYPT_AUDIO);
+            }
+        }
+    }
+    g_cond_broadcast(&aampcdmidecryptor->condition);
+    g_mutex_unlock(&aampcdmidecryptor->mutex);
+    GST_DEBUG_OBJECT(aampcdmidecryptor, "\n releasing ...................... mutex\n");
+    gst_aamp_drm_session_share_release(oldShare);
+    if (!session)
+    {
+        // a failed creation is retried by the next track asking for these keys
+        gst_aamp_drm_session_share_release(share);
+    }
+}
 
-	    if (subsamplesBuffer)
-	        gst_buffer_unmap(subsamplesBuffer, &subSamplesMap);
+static void gst_aampcdmidecryptor_free_license_request(AampCDMILicenseRequest* request)
+{
+    g_free(request->systemId);
+    g_bytes_unref(request->initData);
+    g_slice_free(AampCDMILicenseRequest, request);
+}
 
-	    if (ivBuffer)
-	        gst_buffer_unmap(ivBuffer, &ivMap);
+static void gst_aampcdmidecryptor_license_worker(gpointer data, gpointer user_data)
+{
+    AampCDMILicenseRequest* request = (AampCDMILicenseRequest*) data;
+    GstAampCDMIDecryptor* aampcdmidecryptor = GST_AAMP_CDMI_DECRYPTOR(user_data);
 
-	    if (protectionMeta)
-	        gst_buffer_remove_meta(buffer,
-	                reinterpret_cast<GstMeta*>(protectionMeta));
+    gst_aampcdmidecryptor_create_session(aampcdmidecryptor, request);
+    gst_aampcdmidecryptor_free_license_request(request);
 
-	#if defined(USE_SAGE_SVP) && defined(USE_OPENCDM)
-	    if ((pbData && !(aampcdmidecryptor->ignoreSVP)) || (subSampleCount > 0 ))
-	        g_free(pbData);
-	#else
-	    if (subSampleCount > 0)
-	        g_free(pbData);
-	#endif
-	    if (mutexLocked)
-	        g_mutex_unlock(&aampcdmidecryptor->mutex);
-	    return result;
-	}
+    // held samples wait for the last queued request, not the first to complete
+    g_mutex_lock(&aampcdmidecryptor->mutex);
+    aampcdmidecryptor->licensePending--;
+    g_cond_broadcast(&aampcdmidecryptor->condition);
+    g_mutex_unlock(&aampcdmidecryptor->mutex);
+    gst_object_unref(aampcdmidecryptor);
+}
 
-#endif
+/* sink event handlers */
+/*
+ Checks if a protection event repeats the init data of the active session. Packagers repeat
+ the PSSH in every fragment. Protection events are serialized, so the fingerprint is read on
+ the streaming thread.
+ */
+static gboolean gst_aampcdmidecryptor_repeated_protection(GstAampCDMIDecryptor* aampcdmidecryptor,
+        GstEvent* event)
+{
+    GstBuffer* initdatabuffer = NULL;
+    GstMapInfo mapInfo;
+    gboolean repeated = FALSE;
 
+    if (!aampcdmidecryptor->initDataLength)
+    {
+        return FALSE;
+    }
+    gst_event_parse_protection(event, NULL, &initdatabuffer, NULL);
+    if (initdatabuffer && gst_buffer_map(initdatabuffer, &mapInfo, GST_MAP_READ))
+    {
+        repeated = aampcdmidecryptor->initDataLength == mapInfo.size
+                && aampcdmidecryptor->initDataFingerprint == gst_aamp_drm_init_data_fingerprint(mapInfo.data, mapInfo.size);
+        gst_buffer_unmap(initdatabuffer, &mapInfo);
+    }
+    return repeated;
+}
 
-/* sink event handlers */
 static gboolean gst_aampcdmidecryptor_sink_event(GstBaseTransform * trans,
         GstEvent * event)
 {
@@ -1148,6 +2874,34 @@ static gboolean gst_aampcdmidecryptor_sink_event(GstBaseTransform * trans,
             GST_AAMP_CDMI_DECRYPTOR(trans);
     gboolean result = FALSE;
 
+    // checked ahead of the drain, which waits for a pending license
+    if (GST_EVENT_TYPE(event) == GST_EVENT_PROTECTION
+            && gst_aampcdmidecryptor_repeated_protection(aampcdmidecryptor, event))
+    {
+        GST_TRACE_OBJECT(aampcdmidecryptor, "init data unchanged, session already active");
+        gst_event_unref(event);
+        return TRUE;
+    }
+
+    if (GST_EVENT_TYPE(event) == GST_EVENT_FLUSH_STOP)
+    {
+        gst_aampcdmidecryptor_discard_pending(aampcdmidecryptor);
+    }
+    else if (GST_EVENT_IS_SERIALIZED(event))
+    {
+        gst_aampcdmidecryptor_drain(aampcdmidecryptor);
+    }
+
+    // A seek or retune flushes, a new stream starts with stream-start: the session manager may
+    // have torn down the session meanwhile, so the next protection event is processed even if
+    // its init data is unchanged.
+    if (GST_EVENT_TYPE(event) == GST_EVENT_FLUSH_STOP || GST_EVENT_TYPE(event) == GST_EVENT_STREAM_START)
+    {
+        g_mutex_lock(&aampcdmidecryptor->mutex);
+        aampcdmidecryptor->initDataLength = 0;
+        g_mutex_unlock(&aampcdmidecryptor->mutex);
+    }
+
     switch (GST_EVENT_TYPE(event))
     {
 
@@ -1220,6 +2974,9 @@ static gboolean gst_aampcdmidecryptor_sink_event(GstBaseTransform * trans,
         GstMapInfo mapInfo;
         if (!gst_buffer_map(initdatabuffer, &mapInfo, GST_MAP_READ))
             break;
+
+        // repeats of the active session's init data were dropped before draining
+        guint64 fingerprint = gst_aamp_drm_init_data_fingerprint(mapInfo.data, mapInfo.size);
         GST_DEBUG_OBJECT(aampcdmidecryptor, "scheduling keyNeeded event");
         
         if (eMEDIATYPE_MANIFEST == aampcdmidecryptor->streamtype)
@@ -1272,91 +3029,43 @@ static gboolean gst_aampcdmidecryptor_sink_event(GstBaseTransform * trans,
             aampcdmidecryptor->aamp->profiler.ProfileBegin(
                     PROFILE_BUCKET_LA_TOTAL);
         }
-        g_mutex_lock(&aampcdmidecryptor->mutex);
-        GST_DEBUG_OBJECT(aampcdmidecryptor, "\n acquired lock for mutex\n");
-        aampcdmidecryptor->sessionManager = aampcdmidecryptor->aamp->mDRMSessionManager;
-        DrmMetaDataEventPtr e = std::make_shared<DrmMetaDataEvent>(AAMP_TUNE_FAILURE_UNKNOWN, "", 0, 0, false);
-        if (aampcdmidecryptor->aamp->mIsWVKIDWorkaround){
-            aampcdmidecryptor->drmSession =
-                aampcdmidecryptor->sessionManager->createDrmSession(
-                        reinterpret_cast<const char *>(systemId), eMEDIAFORMAT_DASH,
-                        outData, outDataLen, aampcdmidecryptor->streamtype, aampcdmidecryptor->aamp, e, nullptr, false);
-        }else{
-            aampcdmidecryptor->drmSession =
-                aampcdmidecryptor->sessionManager->createDrmSession(
-                        reinterpret_cast<const char *>(systemId), eMEDIAFORMAT_DASH,
-                        reinterpret_cast<const unsigned char *>(mapInfo.data),
-                        mapInfo.size, aampcdmidecryptor->streamtype, aampcdmidecryptor->aamp, e, nullptr, false);
-        }
-        if (NULL == aampcdmidecryptor->drmSession)
-        {
-/* For DELIA-32832 - Avoided setting 'streamReceived' as FALSE if createDrmSession() failed after a successful case.
- * Set to FALSE is already handled on gst_aampcdmidecryptor_init() as part of initialization.
- */
-#if 0
-            aampcdmidecryptor->streamReceived = FALSE;
-#endif /* 0 */
 
-            /* DELIA-46675-Need to reset canWait to skip condional wait in "gst_aampcdmidecryptor_transform_ip to avoid deadlock
-             *		scenario on drm session failure
-             */
-            aampcdmidecryptor->canWait = false;
-	    /* session manager fails to create session when state is inactive. Skip sending error event
-	     * in this scenario. Later player will change it to active after processing SetLanguage(), or for the next Tune.
-	     */
-	    if(SessionMgrState::eSESSIONMGR_ACTIVE == aampcdmidecryptor->sessionManager->getSessionMgrState())
-	    {
-		    if(!aampcdmidecryptor->aamp->licenceFromManifest)
-		    {
-			AAMPTuneFailure failure = e->getFailure();
-			if(AAMP_TUNE_FAILURE_UNKNOWN != failure)
-				 {
-			    long responseCode = e->getResponseCode();
-			    bool selfAbort = (failure == AAMP_TUNE_LICENCE_REQUEST_FAILED && (responseCode == CURLE_ABORTED_BY_CALLBACK || responseCode == CURLE_WRITE_ERROR));
-			    if (!selfAbort)
-			    {
-				aampcdmidecryptor->aamp->SendErrorEvent(failure);
-			    }
-			    aampcdmidecryptor->aamp->profiler.ProfileError(PROFILE_BUCKET_LA_TOTAL, (int)failure);
-			    aampcdmidecryptor->aamp->profiler.SetDrmErrorCode((int)failure);
-			}
-			else
-			{
-			    aampcdmidecryptor->aamp->profiler.ProfileError(PROFILE_BUCKET_LA_TOTAL);
-			}
-		    }
-		    GST_ERROR_OBJECT(aampcdmidecryptor,"Failed to create DRM Session\n");
-	    }
-            result = TRUE;
-        } 
-	else
+        AampCDMILicenseRequest* request = g_slice_new0(AampCDMILicenseRequest);
+        request->systemId = g_strdup(systemId);
+        if (aampcdmidecryptor->aamp->mIsWVKIDWorkaround)
         {
-            aampcdmidecryptor->streamReceived = TRUE;
-            if(!aampcdmidecryptor->aamp->licenceFromManifest)
-            {
-                aampcdmidecryptor->aamp->profiler.ProfileEnd(
-                        PROFILE_BUCKET_LA_TOTAL);
-            }
-
-            if (!aampcdmidecryptor->firstsegprocessed
-                    && aampcdmidecryptor->aamp)
+            request->initData = g_bytes_new(outData, outDataLen);
+        }
+        else
+        {
+            request->initData = g_bytes_new(mapInfo.data, mapInfo.size);
+        }
+        request->fingerprint = fingerprint;
+        request->receivedLength = mapInfo.size;
+        request->streamtype = aampcdmidecryptor->streamtype;
+        // repeats of this init data are dropped while the session is being created
+        aampcdmidecryptor->initDataFingerprint = fingerprint;
+        aampcdmidecryptor->initDataLength = mapInfo.size;
+
+        if (aampcdmidecryptor->licenseQueueSize)
+        {
+            if (!aampcdmidecryptor->licenseWorker)
             {
-                if (aampcdmidecryptor->streamtype == eMEDIATYPE_VIDEO)
-                {
-                    aampcdmidecryptor->aamp->profiler.ProfileBegin(
-                            PROFILE_BUCKET_DECRYPT_VIDEO);
-                } else if (aampcdmidecryptor->streamtype == eMEDIATYPE_AUDIO)
-                {
-                    aampcdmidecryptor->aamp->profiler.ProfileBegin(
-                            PROFILE_BUCKET_DECRYPT_AUDIO);
-                }
+                aampcdmidecryptor->licenseWorker = g_thread_pool_new(gst_aampcdmidecryptor_license_worker,
+                        aampcdmidecryptor, 1, FALSE, NULL);
             }
-
-            result = TRUE;
+            g_mutex_lock(&aampcdmidecryptor->mutex);
+            aampcdmidecryptor->licensePending++;
+            g_mutex_unlock(&aampcdmidecryptor->mutex);
+            gst_object_ref(aampcdmidecryptor);
+            g_thread_pool_push(aampcdmidecryptor->licenseWorker, request, NULL);
         }
-        g_cond_signal(&aampcdmidecryptor->condition);
-        g_mutex_unlock(&aampcdmidecryptor->mutex);
-        GST_DEBUG_OBJECT(aampcdmidecryptor, "\n releasing ...................... mutex\n");
+        else
+        {
+            gst_aampcdmidecryptor_create_session(aampcdmidecryptor, request);
+            gst_aampcdmidecryptor_free_license_request(request);
+        }
+        result = TRUE;
 
         gst_object_unref(sinkpad);
         gst_buffer_unmap(initdatabuffer, &mapInfo);
@@ -1399,6 +3108,8 @@ static GstStateChangeReturn gst_aampcdmidecryptor_changestate(
         GST_DEBUG_OBJECT(aampcdmidecryptor, "PAUSED->READY");
         g_mutex_lock(&aampcdmidecryptor->mutex);
         aampcdmidecryptor->canWait = false;
+        // sessions may be torn down with the pipeline, revalidate on the next protection event
+        aampcdmidecryptor->initDataLength = 0;
         g_cond_signal(&aampcdmidecryptor->condition);
         g_mutex_unlock(&aampcdmidecryptor->mutex);
         break;
@@ -1423,6 +3134,21 @@ static GstStateChangeReturn gst_aampcdmidecryptor_changestate(
     ret =
             GST_ELEMENT_CLASS(gst_aampcdmidecryptor_parent_class)->change_state(
                     element, transition);
+
+    if (transition == GST_STATE_CHANGE_PAUSED_TO_READY)
+    {
+        // streaming thread has stopped, drop anything held back
+        gst_aampcdmidecryptor_discard_pending(aampcdmidecryptor);
+        // the next stream may be linked to different peers
+        gst_aampcdmidecryptor_caps_cache_clear(aampcdmidecryptor);
+        GstAampDrmSessionShare *share;
+        g_mutex_lock(&aampcdmidecryptor->mutex);
+        // the session may be torn down with the pipeline, let other tracks create a new one
+        share = aampcdmidecryptor->sessionShare;
+        aampcdmidecryptor->sessionShare = NULL;
+        g_mutex_unlock(&aampcdmidecryptor->mutex);
+        gst_aamp_drm_session_share_release(share);
+    }
     return ret;
 }
 
@@ -1444,18 +3170,130 @@ static void gst_aampcdmidecryptor_set_property(GObject * object,
         GST_OBJECT_UNLOCK(aampcdmidecryptor);
         break;
 
+    case PROP_BATCH_SIZE:
+        aampcdmidecryptor->batchSize = g_value_get_uint(value);
+        GST_DEBUG_OBJECT(aampcdmidecryptor, "batch-size %u", aampcdmidecryptor->batchSize);
+        break;
+
+    case PROP_DECRYPT_THREADS:
+        if (aampcdmidecryptor->workers)
+        {
+            GST_WARNING_OBJECT(aampcdmidecryptor, "decrypt-threads can't be changed once workers are running");
+        }
+        else
+        {
+            aampcdmidecryptor->decryptThreads = g_value_get_uint(value);
+            GST_DEBUG_OBJECT(aampcdmidecryptor, "decrypt-threads %u", aampcdmidecryptor->decryptThreads);
+        }
+        break;
+
+    case PROP_REORDER_WINDOW:
+        aampcdmidecryptor->reorderWindow = g_value_get_uint(value);
+        GST_DEBUG_OBJECT(aampcdmidecryptor, "reorder-window %u", aampcdmidecryptor->reorderWindow);
+        break;
+
+    case PROP_LICENSE_QUEUE_SIZE:
+        aampcdmidecryptor->licenseQueueSize = g_value_get_uint(value);
+        GST_DEBUG_OBJECT(aampcdmidecryptor, "license-queue-size %u", aampcdmidecryptor->licenseQueueSize);
+        break;
+
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+        break;
+    }
+}
+
+static void gst_aampcdmidecryptor_get_property(GObject * object,
+        guint prop_id, GValue * value, GParamSpec * pspec)
+{
+    DEBUG_FUNC();
+
+    GstAampCDMIDecryptor* aampcdmidecryptor =
+            GST_AAMP_CDMI_DECRYPTOR(object);
+    switch (prop_id)
+    {
+    case PROP_BATCH_SIZE:
+        g_value_set_uint(value, aampcdmidecryptor->batchSize);
+        break;
+
+    case PROP_DECRYPT_THREADS:
+        g_value_set_uint(value, aampcdmidecryptor->decryptThreads);
+        break;
+
+    case PROP_REORDER_WINDOW:
+        g_value_set_uint(value, aampcdmidecryptor->reorderWindow);
+        break;
+
+    case PROP_LICENSE_QUEUE_SIZE:
+        g_value_set_uint(value, aampcdmidecryptor->licenseQueueSize);
+        break;
+
+    case PROP_STATS:
+        g_value_take_boxed(value, gst_aampcdmidecryptor_stats_structure(aampcdmidecryptor));
+        break;
+
     default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
         break;
     }
 }
 
+/*
+ Adds cbcs to the caps of the sink pad while cbcs samples can be decrypted. The sink pad
+ templates only list cenc, the element is not autoplugged for cbcs streams it cannot decrypt.
+ */
+static gboolean gst_aampcdmidecryptor_query(GstBaseTransform * trans, GstPadDirection direction,
+        GstQuery * query)
+{
+    GstAampCDMIDecryptor *aampcdmidecryptor = GST_AAMP_CDMI_DECRYPTOR(trans);
+
+    if (direction != GST_PAD_SINK || GST_QUERY_TYPE(query) != GST_QUERY_CAPS
+            || !gst_aampcdmidecryptor_can_decrypt_cbcs(aampcdmidecryptor))
+    {
+        return GST_BASE_TRANSFORM_CLASS(gst_aampcdmidecryptor_parent_class)->query(trans, direction, query);
+    }
+
+    // a cbcs filter would empty the template filtered cenc caps, filter afterwards
+    GstCaps* filter = NULL;
+    GstQuery* unfiltered = gst_query_new_caps(NULL);
+    gboolean ret = GST_BASE_TRANSFORM_CLASS(gst_aampcdmidecryptor_parent_class)->query(trans, direction, unfiltered);
+    if (ret)
+    {
+        GstCaps* caps = NULL;
+        gst_query_parse_caps(query, &filter);
+        gst_query_parse_caps_result(unfiltered, &caps);
+        GstCaps* result = gst_aampcdmidecryptor_add_cbcs(caps);
+        if (filter)
+        {
+            GstCaps* intersection = gst_caps_intersect_full(filter, result, GST_CAPS_INTERSECT_FIRST);
+            gst_caps_unref(result);
+            result = intersection;
+        }
+        GST_LOG_OBJECT(trans, "sink caps with cbcs %" GST_PTR_FORMAT, result);
+        gst_query_set_caps_result(query, result);
+        gst_caps_unref(result);
+    }
+    gst_query_unref(unfiltered);
+    return ret;
+}
+
 static gboolean gst_aampcdmidecryptor_accept_caps(GstBaseTransform * trans,
         GstPadDirection direction, GstCaps * caps)
 {
+    GstAampCDMIDecryptor *aampcdmidecryptor = GST_AAMP_CDMI_DECRYPTOR(trans);
     gboolean ret = TRUE;
     GST_DEBUG_OBJECT (trans, "received accept caps with direction: %s caps: %" GST_PTR_FORMAT, (direction == GST_PAD_SRC) ? "src" : "sink", caps);
 
+    g_mutex_lock(&aampcdmidecryptor->capsCacheMutex);
+    AampCDMICapsCacheEntry* entry = gst_aampcdmidecryptor_caps_cache_find(aampcdmidecryptor, direction, caps);
+    ret = entry && entry->accepted;
+    g_mutex_unlock(&aampcdmidecryptor->capsCacheMutex);
+    if (ret)
+    {
+        GST_DEBUG_OBJECT(trans, "caps accepted before");
+        return TRUE;
+    }
+
     GstCaps *allowedCaps = NULL;
 
     if (direction == GST_PAD_SINK)
@@ -1498,6 +3336,12 @@ static gboolean gst_aampcdmidecryptor_accept_caps(GstBaseTransform * trans,
             }
         }
     }
+    if (ret)
+    {
+        g_mutex_lock(&aampcdmidecryptor->capsCacheMutex);
+        gst_aampcdmidecryptor_caps_cache_add(aampcdmidecryptor, direction, caps)->accepted = TRUE;
+        g_mutex_unlock(&aampcdmidecryptor->capsCacheMutex);
+    }
     GST_DEBUG_OBJECT(trans, "Return from accept_caps: %d", ret);
     return ret;
 }
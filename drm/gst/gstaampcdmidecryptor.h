@@ -24,10 +24,144 @@
 
 #include <gst/gst.h>
 #include <gst/base/gstbasetransform.h>
+#include <stdint.h>
 #include "AampDRMSessionManager.h"
 #include "priv_aamp.h"
 
 
+/**
+ * @struct AampDecryptRange
+ * @brief One subsample of an encrypted sample: clear bytes followed by encrypted bytes
+ */
+struct AampDecryptRange
+{
+    uint32_t clearBytes;
+    uint32_t encryptedBytes;
+};
+
+/**
+ * @class AampSubsampleDecryptor
+ * @brief Optional interface of DRM sessions able to decrypt the encrypted ranges of a sample in place
+ *
+ * A session implementing it in addition to AampDrmSession lets the decryptor skip gathering
+ * the encrypted bytes into contiguous memory and scattering the result back. No libaamp
+ * session implements it yet, until one does every sample takes the gather/scatter path.
+ */
+class AampSubsampleDecryptor
+{
+public:
+    virtual ~AampSubsampleDecryptor() {}
+
+    /**
+     * @brief Decrypt the encrypted ranges of a sample in place
+     * @param[in] iv initialization vector
+     * @param[in] ivLen length of iv
+     * @param[in,out] data sample data
+     * @param[in] dataLen length of data
+     * @param[in] ranges subsample ranges, covering at most dataLen bytes
+     * @param[in] rangeCount number of ranges
+     * @param[out] ppOpaqueData secure buffer handle when the output is kept in secure memory
+     * @retval 0 on success, same error codes as AampDrmSession::decrypt otherwise
+     */
+    virtual int decryptSubsamples(const uint8_t *iv, uint32_t ivLen, uint8_t *data, uint32_t dataLen,
+            const AampDecryptRange *ranges, uint32_t rangeCount, uint8_t **ppOpaqueData) = 0;
+};
+
+/**
+ * @class AampPatternDecryptor
+ * @brief Optional interface of DRM sessions able to decrypt cbcs pattern encrypted samples in place
+ *
+ * AampDrmSession::decrypt has no cipher mode, so without it cbcs samples are refused with
+ * GST_FLOW_NOT_SUPPORTED. No libaamp session implements it yet, the PlayReady and Widevine
+ * decryptors do not advertise application/x-cbcs until one does.
+ */
+class AampPatternDecryptor
+{
+public:
+    virtual ~AampPatternDecryptor() {}
+
+    /**
+     * @brief Decrypt the encrypted blocks of a cbcs sample in place
+     * @param[in] iv initialization vector, restarting with each subsample
+     * @param[in] ivLen length of iv
+     * @param[in,out] data sample data
+     * @param[in] dataLen length of data
+     * @param[in] ranges subsample ranges, covering at most dataLen bytes
+     * @param[in] rangeCount number of ranges
+     * @param[in] cryptBlocks encrypted 16 byte blocks of the pattern, 0 if every block is encrypted
+     * @param[in] skipBlocks clear 16 byte blocks of the pattern
+     * @param[out] ppOpaqueData secure buffer handle when the output is kept in secure memory
+     * @retval 0 on success, same error codes as AampDrmSession::decrypt otherwise
+     */
+    virtual int decryptPattern(const uint8_t *iv, uint32_t ivLen, uint8_t *data, uint32_t dataLen,
+            const AampDecryptRange *ranges, uint32_t rangeCount, uint32_t cryptBlocks, uint32_t skipBlocks,
+            uint8_t **ppOpaqueData) = 0;
+};
+
+/**
+ * @struct AampDecryptSample
+ * @brief One sample of a batch decrypt request
+ */
+struct AampDecryptSample
+{
+    const uint8_t*          iv;
+    uint32_t                ivLen;
+    uint8_t*                data;           // decrypted in place
+    uint32_t                dataLen;
+    const AampDecryptRange* ranges;         // NULL if the whole sample is encrypted
+    uint32_t                rangeCount;
+    int                     result;         // set by the session, 0 on success
+};
+
+/**
+ * @class AampBatchDecryptor
+ * @brief Optional interface of DRM sessions able to decrypt several samples sharing a key in one call
+ *
+ * Amortises the per call cost of CDMs living in another process. No libaamp session
+ * implements it yet, until one does samples are decrypted one call at a time.
+ */
+class AampBatchDecryptor
+{
+public:
+    virtual ~AampBatchDecryptor() {}
+
+    /**
+     * @brief Decrypt samples in place, reporting per sample status in AampDecryptSample::result
+     * @param[in,out] samples samples to decrypt, all using the session's current key
+     * @param[in] count number of samples
+     * @retval 0 if the call was carried out, error code applying to every sample otherwise
+     */
+    virtual int decryptBatch(AampDecryptSample *samples, uint32_t count) = 0;
+};
+
+#define GST_AAMP_DECRYPT_LATENCY_BUCKETS   8
+#define GST_AAMP_DECRYPT_SUBSAMPLE_BUCKETS 6
+
+/**
+ * @struct GstAampCDMIDecryptorStats
+ * @brief Decryption counters since the element was created, read through the "stats" property
+ */
+struct GstAampCDMIDecryptorStats
+{
+    guint64     samples;            // encrypted samples given to the CDM
+    guint64     clearSamples;       // samples passed through without decryption
+    guint64     bytes;              // size of encrypted samples
+    guint64     encryptedBytes;     // encrypted part of encrypted samples
+    guint64     clearBytes;         // clear part of encrypted samples and size of clear samples
+    guint64     subsamples[GST_AAMP_DECRYPT_SUBSAMPLE_BUCKETS]; // encrypted samples by subsample count: 0, 1, 2-3, 4-7, 8-15, 16+
+    guint64     calls;              // decrypt calls, a batch counts once
+    guint64     latency[GST_AAMP_DECRYPT_LATENCY_BUCKETS];     // decrypt calls by duration, bounds in the "latency-bounds-us" stats field
+    guint64     latencyTotal;       // us
+    guint64     latencyMax;         // us
+    guint64     keyWaits;           // times a sample was held waiting for a key
+    guint64     keyWaitTime;        // us
+    guint64     failures;           // samples the CDM failed to decrypt
+    guint64     hdcpFailures;       // of which failed on output protection
+    guint64     allocations;        // heap allocations on the decrypt path: scratch and range list growth, batched samples
+    guint64     lockContentions;    // times the decrypt path found the decryptor mutex taken
+    guint64     lockWaitTime;       // us blocked on it
+};
+
 G_BEGIN_DECLS
 
 #define GST_TYPE_AAMP_CDMI_DECRYPTOR            (gst_aampcdmidecryptor_get_type())
@@ -35,6 +169,37 @@ G_BEGIN_DECLS
 #define GST_AAMP_CDMI_DECRYPTOR_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST((klass), GST_TYPE_AAMP_CDMI_DECRYPTOR, GstAampCDMIDecryptorClass))
 #define GST_IS_AAMP_CDMI_DECRYPTOR(obj)         (G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_AAMP_CDMI_DECRYPTOR))
 #define GST_IS_AAMP_CDMI_DECRYPTOR_CLASS(obj)   (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_AAMP_CDMI_DECRYPTOR))
+#define GST_AAMP_CDMI_DECRYPTOR_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS((obj), GST_TYPE_AAMP_CDMI_DECRYPTOR, GstAampCDMIDecryptorClass))
+
+struct GstAampCDMISessionState;
+
+/**
+ * @struct AampCDMISampleInfo
+ * @brief Protection parameters of one sample, parsed once from its protection meta
+ *
+ * iv, kid and subsamples point into the meta and stay valid until it is removed.
+ */
+struct AampCDMISampleInfo
+{
+    GstMeta*            meta;               // GstAampProtectionMeta or GstProtectionMeta, NULL for unprotected buffers
+    gboolean            encrypted;          // FALSE for clear samples
+    const guint8*       iv;                 // sample IV, or the constant IV of cbcs streams
+    gsize               ivLength;
+    const guint8*       kid;                // NULL if the sample has none
+    gsize               kidLength;
+    guint               subSampleCount;
+    const guint8*       subsamples;         // subSampleCount big endian (uint16 clear, uint32 encrypted) entries
+    gsize               subsamplesSize;
+    gboolean            pattern;            // cbcs crypt/skip pattern encryption
+    guint               cryptBlocks;
+    guint               skipBlocks;
+    GstBuffer*          ivBuffer;           // GstProtectionMeta buffers mapped for the views above
+    GstBuffer*          kidBuffer;
+    GstBuffer*          subsamplesBuffer;
+    GstMapInfo          ivMap;
+    GstMapInfo          kidMap;
+    GstMapInfo          subsamplesMap;
+};
 
 typedef struct _GstAampCDMIDecryptor GstAampCDMIDecryptor;
 typedef struct _GstAampCDMIDecryptorClass GstAampCDMIDecryptorClass;
@@ -48,6 +213,16 @@ struct _GstAampCDMIDecryptor
     GstBaseTransform                base_aampcdmidecryptor;
     class AampDRMSessionManager*    sessionManager;
     class AampDrmSession*           drmSession;
+    class AampSubsampleDecryptor*   subsampleDecryptor; // drmSession's in-place interface, NULL if not supported
+    class AampBatchDecryptor*       batchDecryptor;     // drmSession's batch interface, NULL if not supported
+    class AampPatternDecryptor*     patternDecryptor;   // drmSession's cbcs interface, NULL if not supported
+    gboolean                        hostOutput;         // drmSession decrypts to host memory, not to a secure buffer
+    gboolean                        localDecrypt;       // subclass decrypts in element, see local_decrypt and gst_aampcdmidecryptor_set_local_decrypt
+    struct _GstAampDrmSessionShare* sessionShare;       // registry entry of drmSession, shared with the other tracks
+    guint                           licenseQueueSize;   // encrypted samples held while a license is acquired, 0 acquires on the streaming thread
+    guint                           licensePending;     // session creations queued or in progress on licenseWorker
+    GThreadPool*                    licenseWorker;
+    GQueue                          licenseWait;        // samples held until the pending session is ready
     class PrivateInstanceAAMP *     aamp;
     gboolean                        streamReceived;
     gboolean                        canWait;
@@ -56,8 +231,12 @@ struct _GstAampCDMIDecryptor
 
     GMutex                          mutex;
     GCond                           condition;
+    GRWLock                         stateLock;      // write side taken only to publish sessionState
+    GstAampCDMISessionState*        sessionState;   // session and sink caps as read by the decrypt path, never NULL
 
     GstEvent*                       protectionEvent;
+    guint64                         initDataFingerprint;    // init data of the active session, see initDataLength
+    gsize                           initDataLength;         // 0 when no session was created from a protection event since the last flush or stream-start
     const gchar*                    selectedProtection;
     gushort                         decryptFailCount;
     gushort			    hdcpOpProtectionFailCount;
@@ -65,8 +244,25 @@ struct _GstAampCDMIDecryptor
     gboolean                        streamEncryped;
     gboolean                        ignoreSVP; //No need for svp for clearKey streams
     GstCaps*                        sinkCaps;
+    GMutex                          capsCacheMutex;
+    GQueue                          capsCache;      // AampCDMICapsCacheEntry, most recently used first
     //GstBuffer*                    initDataBuffer;
     void*                           svpCtx;
+    guint8*                         scratch;        // grow-only gather/scatter arena, reused across samples
+    gsize                           scratchSize;
+    AampDecryptRange*               ranges;         // grow-only subsample range list for subsampleDecryptor
+    guint                           rangesSize;
+    guint                           batchSize;      // samples per batch decrypt call, batching off when <= 1
+    GQueue                          pending;        // samples collected for the next batch
+    GQueue                          ready;          // decrypted buffers waiting to be pushed, in order
+    guint                           decryptThreads; // parallel decryption workers, parallel mode off when 0
+    guint                           reorderWindow;  // samples in flight in parallel mode
+    GThreadPool*                    workers;
+    GQueue                          inflight;       // samples handed to workers, in arrival order
+    GMutex                          workMutex;
+    GCond                           workDone;
+    GMutex                          statsMutex;
+    GstAampCDMIDecryptorStats       stats;
 };
 
 /**
@@ -76,6 +272,14 @@ struct _GstAampCDMIDecryptor
 struct _GstAampCDMIDecryptorClass
 {
     GstBaseTransformClass           base_aampcdmidecryptor_class;
+
+    /**
+     * Optional in element decryption, used while localDecrypt is set. Decrypts buffer in place
+     * and returns TRUE with the outcome in errorCode and the number of encrypted bytes in
+     * encryptedBytes, or returns FALSE to leave the sample to the DRM session.
+     */
+    gboolean (*local_decrypt)(GstAampCDMIDecryptor* decryptor, GstBuffer* buffer,
+            const AampCDMISampleInfo* info, int* errorCode, gsize* encryptedBytes);
 };
 
 /**
@@ -84,6 +288,27 @@ struct _GstAampCDMIDecryptorClass
  */
 GType gst_aampcdmidecryptor_get_type (void);
 
+/**
+ * @brief Installs a DRM session created by the caller, in place of one created from the
+ *        protection events, and wakes the streaming threads waiting for a key
+ *
+ * Used by the decryptor benchmark to run the session paths without a CDM. The session stays
+ * owned by the caller and must outlive the decryptor's use of it.
+ * @param[in] decryptor decryptor
+ * @param[in] session session decrypting the following samples, NULL to remove the current one
+ */
+void gst_aampcdmidecryptor_set_session(GstAampCDMIDecryptor* decryptor, AampDrmSession* session);
+
+/**
+ * @brief Turns in element decryption on or off, see local_decrypt
+ *
+ * application/x-cbcs sink caps are offered while in element decryption is on, upstream is
+ * asked to renegotiate when that changes.
+ * @param[in] decryptor decryptor
+ * @param[in] enabled TRUE when the subclass has keys to decrypt samples with
+ */
+void gst_aampcdmidecryptor_set_local_decrypt(GstAampCDMIDecryptor* decryptor, gboolean enabled);
+
 G_END_DECLS
 
 #endif
@@ -37,8 +37,22 @@
 #define DEBUG_FUNC()
 #endif
 
+#define PSSH_HEADER_SIZE 32     // size, type, version, flags and system id
+#define KID_SIZE 16
+
+enum
+{
+    PROP_0, PROP_KEYS
+};
+
 /* prototypes */
 static void gst_aampclearkeydecryptor_finalize(GObject*);
+static void gst_aampclearkeydecryptor_set_property(GObject * object,
+        guint prop_id, const GValue * value, GParamSpec * pspec);
+static gboolean gst_aampclearkeydecryptor_sink_event(GstBaseTransform * trans,
+        GstEvent * event);
+static gboolean gst_aampclearkeydecryptor_local_decrypt(GstAampCDMIDecryptor* decryptor, GstBuffer* buffer,
+        const AampCDMISampleInfo* info, int* errorCode, gsize* encryptedBytes);
 
 /* class initialization */
 #define gst_aampclearkeydecryptor_parent_class parent_class
@@ -76,10 +90,21 @@ static void gst_aampclearkeydecryptor_class_init(
 {
     GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
     GstElementClass* elementClass = GST_ELEMENT_CLASS(klass);
+    GstBaseTransformClass* baseTransformClass = GST_BASE_TRANSFORM_CLASS(klass);
+    GstAampCDMIDecryptorClass* decryptorClass = GST_AAMP_CDMI_DECRYPTOR_CLASS(klass);
 
     DEBUG_FUNC();
 
     gobject_class->finalize = gst_aampclearkeydecryptor_finalize;
+    gobject_class->set_property = gst_aampclearkeydecryptor_set_property;
+    baseTransformClass->sink_event = GST_DEBUG_FUNCPTR(gst_aampclearkeydecryptor_sink_event);
+    decryptorClass->local_decrypt = gst_aampclearkeydecryptor_local_decrypt;
+
+    g_object_class_install_property(gobject_class, PROP_KEYS,
+            g_param_spec_string("keys", "Keys",
+                    "Comma separated hex kid:key pairs decrypted in element without a DRM session, "
+                    "samples with other KIDs go through the DRM session",
+                    NULL, G_PARAM_WRITABLE));
 
     /* Setting up pads and setting metadata should be moved to
     base_class_init if you intend to subclass this class. */
@@ -100,6 +125,7 @@ static void gst_aampclearkeydecryptor_class_init(
 static void gst_aampclearkeydecryptor_init(GstAampclearkeydecryptor *aampclearkeydecryptor)
 {
     DEBUG_FUNC();
+    aampclearkeydecryptor->engine = gst_aamp_clearkey_engine_new();
 }
 
 
@@ -110,7 +136,180 @@ static void gst_aampclearkeydecryptor_init(GstAampclearkeydecryptor *aampclearke
 static void gst_aampclearkeydecryptor_finalize(GObject * object)
 {
     DEBUG_FUNC();
+    GstAampclearkeydecryptor* aampclearkeydecryptor = GST_AAMPCLEARKEYDECRYPTOR(object);
+    gst_aamp_clearkey_engine_free(aampclearkeydecryptor->engine);
+    aampclearkeydecryptor->engine = NULL;
     GST_CALL_PARENT(G_OBJECT_CLASS, finalize, (object));
 }
 
+/**
+ * @brief Sets property of the clearkey decryptor
+ * @param object clearkey decryptor element pointer
+ * @param prop_id property id
+ * @param value property value
+ * @param pspec property spec
+ */
+static void gst_aampclearkeydecryptor_set_property(GObject * object,
+        guint prop_id, const GValue * value, GParamSpec * pspec)
+{
+    GstAampclearkeydecryptor* aampclearkeydecryptor = GST_AAMPCLEARKEYDECRYPTOR(object);
+    GstAampCDMIDecryptor* aampcdmidecryptor = GST_AAMP_CDMI_DECRYPTOR(object);
+
+    switch (prop_id)
+    {
+    case PROP_KEYS:
+        gst_aamp_clearkey_engine_set_keys(aampclearkeydecryptor->engine, g_value_get_string(value));
+        gst_aampcdmidecryptor_set_local_decrypt(aampcdmidecryptor,
+                gst_aamp_clearkey_engine_has_keys(aampclearkeydecryptor->engine));
+        GST_INFO_OBJECT(aampclearkeydecryptor, "in element decryption %s",
+                aampcdmidecryptor->localDecrypt ? "enabled" : "disabled");
+        break;
+
+    default:
+        G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+        break;
+    }
+}
+
+/**
+ * @brief Checks if every KID listed in version 1 PSSH boxes of init data has a local key
+ * @param engine ClearKey engine
+ * @param data init data
+ * @param size size of data
+ * @retval TRUE if at least one KID is listed and all listed KIDs have keys
+ */
+static gboolean gst_aampclearkeydecryptor_keys_known(GstAampClearKeyEngine* engine, const guint8* data, gsize size)
+{
+    GstByteReader reader;
+    guint kids = 0;
+
+    gst_byte_reader_init(&reader, data, size);
+    while (gst_byte_reader_get_remaining(&reader) >= PSSH_HEADER_SIZE)
+    {
+        guint boxStart = gst_byte_reader_get_pos(&reader);
+        guint32 boxSize = 0;
+        guint8 version = 0;
+        guint32 kidCount = 0;
+        const guint8* kid;
+
+        gst_byte_reader_get_uint32_be(&reader, &boxSize);
+        if (boxSize < PSSH_HEADER_SIZE || boxSize > size - boxStart)
+        {
+            return FALSE;
+        }
+        gst_byte_reader_skip(&reader, 4);
+        gst_byte_reader_get_uint8(&reader, &version);
+        gst_byte_reader_skip(&reader, 3 + 16);
+        if (version >= 1)
+        {
+            if (!gst_byte_reader_get_uint32_be(&reader, &kidCount))
+            {
+                return FALSE;
+            }
+            for (guint32 i = 0; i < kidCount; i++)
+            {
+                if (!gst_byte_reader_get_data(&reader, KID_SIZE, &kid)
+                        || !gst_aamp_clearkey_engine_has_key(engine, kid, KID_SIZE))
+                {
+                    return FALSE;
+                }
+                kids++;
+            }
+        }
+        gst_byte_reader_set_pos(&reader, boxStart + boxSize);
+    }
+    return kids > 0;
+}
+
+/**
+ * @brief Drops protection events whose keys are all set locally, no license is needed for them
+ * @param trans clearkey decryptor element pointer
+ * @param event event to handle
+ * @retval TRUE if the event was handled
+ */
+static gboolean gst_aampclearkeydecryptor_sink_event(GstBaseTransform * trans,
+        GstEvent * event)
+{
+    GstAampclearkeydecryptor* aampclearkeydecryptor = GST_AAMPCLEARKEYDECRYPTOR(trans);
+
+    if (GST_EVENT_TYPE(event) == GST_EVENT_PROTECTION
+            && GST_AAMP_CDMI_DECRYPTOR(trans)->localDecrypt)
+    {
+        GstBuffer* initData = NULL;
+        GstMapInfo map;
+        gboolean known = FALSE;
+
+        gst_event_parse_protection(event, NULL, &initData, NULL);
+        if (initData && gst_buffer_map(initData, &map, GST_MAP_READ))
+        {
+            known = gst_aampclearkeydecryptor_keys_known(aampclearkeydecryptor->engine, map.data, map.size);
+            gst_buffer_unmap(initData, &map);
+        }
+        if (known)
+        {
+            GST_DEBUG_OBJECT(aampclearkeydecryptor, "all keys set locally, skipping license acquisition");
+            gst_event_unref(event);
+            return TRUE;
+        }
+    }
+    return GST_BASE_TRANSFORM_CLASS(parent_class)->sink_event(trans, event);
+}
+
+/**
+ * @brief Decrypts a sample with the ClearKey engine if its key was set locally
+ * @param decryptor clearkey decryptor element pointer
+ * @param buffer sample, decrypted in place
+ * @param info protection parameters of the sample
+ * @param errorCode outcome of the decryption
+ * @param encryptedBytes number of encrypted bytes in the sample
+ * @retval TRUE if the sample was handled, FALSE to use the DRM session
+ */
+static gboolean gst_aampclearkeydecryptor_local_decrypt(GstAampCDMIDecryptor* decryptor, GstBuffer* buffer,
+        const AampCDMISampleInfo* info, int* errorCode, gsize* encryptedBytes)
+{
+    GstAampclearkeydecryptor* aampclearkeydecryptor = GST_AAMPCLEARKEYDECRYPTOR(decryptor);
+    AampDecryptRange* ranges = NULL;
+    gboolean valid = TRUE;
+    GstMapInfo map;
+
+    if (!info->encrypted || !info->kid
+            || !gst_aamp_clearkey_engine_has_key(aampclearkeydecryptor->engine, info->kid, info->kidLength))
+    {
+        return FALSE;
+    }
+
+    *errorCode = -1;
+    *encryptedBytes = 0;
+    if (info->subSampleCount)
+    {
+        GstByteReader reader;
+        ranges = g_new(AampDecryptRange, info->subSampleCount);
+        gst_byte_reader_init(&reader, info->subsamples, info->subsamplesSize);
+        for (guint i = 0; i < info->subSampleCount && valid; i++)
+        {
+            guint16 nBytesClear = 0;
+            guint32 nBytesEncrypted = 0;
+            valid = gst_byte_reader_get_uint16_be(&reader, &nBytesClear)
+                    && gst_byte_reader_get_uint32_be(&reader, &nBytesEncrypted);
+            ranges[i].clearBytes = nBytesClear;
+            ranges[i].encryptedBytes = nBytesEncrypted;
+            *encryptedBytes += nBytesEncrypted;
+        }
+    }
+
+    if (valid && gst_buffer_map(buffer, &map, static_cast<GstMapFlags>(GST_MAP_READWRITE)))
+    {
+        if (!info->subSampleCount)
+        {
+            *encryptedBytes = map.size;
+        }
+        *errorCode = gst_aamp_clearkey_engine_decrypt(aampclearkeydecryptor->engine, info->kid, info->kidLength,
+                info->pattern ? GST_AAMP_CIPHER_CBCS : GST_AAMP_CIPHER_CENC, info->iv, info->ivLength,
+                map.data, map.size, ranges, info->subSampleCount, info->cryptBlocks, info->skipBlocks);
+        gst_buffer_unmap(buffer, &map);
+    }
+    g_free(ranges);
+    return TRUE;
+}
+
 
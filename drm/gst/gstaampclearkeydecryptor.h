@@ -33,6 +33,7 @@
 #include "priv_aamp.h"
 
 #include "gstaampcdmidecryptor.h"  // For base gobject
+#include "gstaampclearkeyengine.h"
 
 // Declared static here because this string exists in libaamp.so
 // and libgstaampplugin.so  This string needs to match the start
@@ -59,6 +60,7 @@ typedef struct _GstAampclearkeydecryptorClass GstAampclearkeydecryptorClass;
 struct _GstAampclearkeydecryptor
 {
     GstAampCDMIDecryptor                parent;
+    GstAampClearKeyEngine*              engine;     // in element decryption for keys set through "keys"
 };
 
 /**
@@ -0,0 +1,343 @@
+/*
+* Copyright 2018 RDK Management
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Library General Public
+* License as published by the Free Software Foundation, version 2
+* of the license.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Library General Public License for more details.
+*
+* You should have received a copy of the GNU Library General Public
+* License along with this library; if not, write to the
+* Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file gstaampclearkeyengine.cpp
+ * @brief Software AES engine decrypting ClearKey protected CENC samples in place
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <openssl/evp.h>
+#include "gstaampclearkeyengine.h"
+
+GST_DEBUG_CATEGORY_STATIC(gst_aamp_clearkey_engine_debug_category);
+#define GST_CAT_DEFAULT gst_aamp_clearkey_engine_debug_category
+
+#define AES_BLOCK_SIZE 16
+
+/**
+ * @struct GstAampClearKey
+ * @brief Content key and its id
+ */
+struct GstAampClearKey
+{
+    guint8                  kid[GST_AAMP_CLEARKEY_KEY_SIZE];
+    guint8                  key[GST_AAMP_CLEARKEY_KEY_SIZE];
+};
+
+/**
+ * @struct _GstAampClearKeyEngine
+ * @brief Engine state, keys replaced under mutex
+ */
+struct _GstAampClearKeyEngine
+{
+    GMutex                  mutex;
+    GArray*                 keys;       // GstAampClearKey
+};
+
+// cipher contexts are reused per thread, streaming and decrypt worker threads alike
+static GPrivate cipherContext = G_PRIVATE_INIT((GDestroyNotify) EVP_CIPHER_CTX_free);
+
+static EVP_CIPHER_CTX *gst_aamp_clearkey_engine_context(void)
+{
+    EVP_CIPHER_CTX *ctx = (EVP_CIPHER_CTX *) g_private_get(&cipherContext);
+    if (!ctx)
+    {
+        ctx = EVP_CIPHER_CTX_new();
+        g_private_set(&cipherContext, ctx);
+    }
+    return ctx;
+}
+
+/*
+ Parses hex digits into out, skipping dashes. Returns FALSE unless exactly len bytes are read.
+ */
+static gboolean gst_aamp_clearkey_engine_parse_hex(const gchar *hex, guint8 *out, gsize len)
+{
+    gsize count = 0;
+    gint high = -1;
+
+    for (; *hex; hex++)
+    {
+        if (*hex == '-' || g_ascii_isspace(*hex))
+        {
+            continue;
+        }
+        gint value = g_ascii_xdigit_value(*hex);
+        if (value < 0 || count == len)
+        {
+            return FALSE;
+        }
+        if (high < 0)
+        {
+            high = value;
+        }
+        else
+        {
+            out[count++] = (guint8) ((high << 4) | value);
+            high = -1;
+        }
+    }
+    return count == len && high < 0;
+}
+
+/*
+ Finds the key for a KID. Called with engine mutex held.
+ */
+static const GstAampClearKey *gst_aamp_clearkey_engine_find(GstAampClearKeyEngine *engine, const guint8 *kid, gsize kidLen)
+{
+    if (kidLen != GST_AAMP_CLEARKEY_KEY_SIZE)
+    {
+        return NULL;
+    }
+    for (guint i = 0; i < engine->keys->len; i++)
+    {
+        const GstAampClearKey *key = &g_array_index(engine->keys, GstAampClearKey, i);
+        if (!memcmp(key->kid, kid, GST_AAMP_CLEARKEY_KEY_SIZE))
+        {
+            return key;
+        }
+    }
+    return NULL;
+}
+
+/*
+ Decrypts len bytes in place, continuing the cipher state of ctx.
+ */
+static gboolean gst_aamp_clearkey_engine_update(EVP_CIPHER_CTX *ctx, guint8 *data, gsize len)
+{
+    while (len)
+    {
+        int chunk = (int) MIN(len, (gsize) (G_MAXINT / AES_BLOCK_SIZE) * AES_BLOCK_SIZE);
+        int outLen = 0;
+        if (!EVP_DecryptUpdate(ctx, data, &outLen, data, chunk))
+        {
+            return FALSE;
+        }
+        data += chunk;
+        len -= chunk;
+    }
+    return TRUE;
+}
+
+/*
+ Decrypts the encrypted part of a cbcs subsample: whole blocks following the crypt/skip
+ pattern, the chain continuing across skipped blocks. A trailing partial block stays clear.
+ */
+static gboolean gst_aamp_clearkey_engine_cbcs_range(EVP_CIPHER_CTX *ctx, const guint8 *iv, guint8 *data, gsize len,
+        guint cryptBlocks, guint skipBlocks)
+{
+    if (!EVP_DecryptInit_ex(ctx, NULL, NULL, NULL, iv))
+    {
+        return FALSE;
+    }
+    gsize blocks = len / AES_BLOCK_SIZE;
+    if (!cryptBlocks)
+    {
+        // no pattern, every whole block is encrypted
+        return gst_aamp_clearkey_engine_update(ctx, data, blocks * AES_BLOCK_SIZE);
+    }
+    while (blocks)
+    {
+        gsize crypt = MIN(blocks, (gsize) cryptBlocks);
+        if (!gst_aamp_clearkey_engine_update(ctx, data, crypt * AES_BLOCK_SIZE))
+        {
+            return FALSE;
+        }
+        blocks -= crypt;
+        data += crypt * AES_BLOCK_SIZE;
+
+        gsize skip = MIN(blocks, (gsize) skipBlocks);
+        blocks -= skip;
+        data += skip * AES_BLOCK_SIZE;
+    }
+    return TRUE;
+}
+
+/*
+ Installs a new key list, wiping the replaced one.
+ */
+static void gst_aamp_clearkey_engine_replace(GstAampClearKeyEngine *engine, GArray *keys)
+{
+    g_mutex_lock(&engine->mutex);
+    GArray *old = engine->keys;
+    engine->keys = keys;
+    g_mutex_unlock(&engine->mutex);
+
+    memset(old->data, 0, old->len * sizeof(GstAampClearKey));
+    g_array_free(old, TRUE);
+}
+
+GstAampClearKeyEngine* gst_aamp_clearkey_engine_new(void)
+{
+    static gsize initialized = 0;
+    if (g_once_init_enter(&initialized))
+    {
+        GST_DEBUG_CATEGORY_INIT(gst_aamp_clearkey_engine_debug_category, "aampclearkeyengine", 0,
+                "debug category for aamp ClearKey engine");
+        g_once_init_leave(&initialized, 1);
+    }
+
+    GstAampClearKeyEngine *engine = g_slice_new0(GstAampClearKeyEngine);
+    g_mutex_init(&engine->mutex);
+    engine->keys = g_array_new(FALSE, FALSE, sizeof(GstAampClearKey));
+    return engine;
+}
+
+void gst_aamp_clearkey_engine_free(GstAampClearKeyEngine *engine)
+{
+    if (engine)
+    {
+        // keys are secrets, do not leave them behind in freed memory
+        memset(engine->keys->data, 0, engine->keys->len * sizeof(GstAampClearKey));
+        g_array_free(engine->keys, TRUE);
+        g_mutex_clear(&engine->mutex);
+        g_slice_free(GstAampClearKeyEngine, engine);
+    }
+}
+
+gboolean gst_aamp_clearkey_engine_set_keys(GstAampClearKeyEngine *engine, const gchar *keys)
+{
+    GArray *parsed = g_array_new(FALSE, FALSE, sizeof(GstAampClearKey));
+    gboolean ret = TRUE;
+
+    if (keys && *keys)
+    {
+        gchar **pairs = g_strsplit(keys, ",", -1);
+        for (gchar **pair = pairs; *pair && ret; pair++)
+        {
+            gchar **parts = g_strsplit(*pair, ":", 2);
+            GstAampClearKey key;
+            ret = parts[0] && parts[1]
+                    && gst_aamp_clearkey_engine_parse_hex(parts[0], key.kid, sizeof(key.kid))
+                    && gst_aamp_clearkey_engine_parse_hex(parts[1], key.key, sizeof(key.key));
+            if (ret)
+            {
+                g_array_append_val(parsed, key);
+            }
+            memset(&key, 0, sizeof(key));
+            g_strfreev(parts);
+        }
+        g_strfreev(pairs);
+    }
+    if (!ret)
+    {
+        GST_ERROR("invalid ClearKey key list, expected comma separated hex kid:key pairs");
+        memset(parsed->data, 0, parsed->len * sizeof(GstAampClearKey));
+        g_array_set_size(parsed, 0);
+    }
+
+    gst_aamp_clearkey_engine_replace(engine, parsed);
+    GST_INFO("%u ClearKey keys set", parsed->len);
+    return ret;
+}
+
+void gst_aamp_clearkey_engine_set_key(GstAampClearKeyEngine *engine, const guint8 *kid, const guint8 *key)
+{
+    GArray *keys = g_array_new(FALSE, FALSE, sizeof(GstAampClearKey));
+
+    if (key)
+    {
+        GstAampClearKey entry;
+        memcpy(entry.kid, kid, sizeof(entry.kid));
+        memcpy(entry.key, key, sizeof(entry.key));
+        g_array_append_val(keys, entry);
+        memset(&entry, 0, sizeof(entry));
+    }
+    gst_aamp_clearkey_engine_replace(engine, keys);
+}
+
+gboolean gst_aamp_clearkey_engine_has_keys(GstAampClearKeyEngine *engine)
+{
+    g_mutex_lock(&engine->mutex);
+    gboolean ret = (engine->keys->len != 0);
+    g_mutex_unlock(&engine->mutex);
+    return ret;
+}
+
+gboolean gst_aamp_clearkey_engine_has_key(GstAampClearKeyEngine *engine, const guint8 *kid, gsize kidLen)
+{
+    g_mutex_lock(&engine->mutex);
+    gboolean ret = (NULL != gst_aamp_clearkey_engine_find(engine, kid, kidLen));
+    g_mutex_unlock(&engine->mutex);
+    return ret;
+}
+
+int gst_aamp_clearkey_engine_decrypt(GstAampClearKeyEngine *engine, const guint8 *kid, gsize kidLen,
+        GstAampCipherMode mode, const guint8 *iv, gsize ivLen, guint8 *data, gsize size,
+        const AampDecryptRange *ranges, guint rangeCount, guint cryptBlocks, guint skipBlocks)
+{
+    guint8 key[GST_AAMP_CLEARKEY_KEY_SIZE];
+    guint8 fullIv[AES_BLOCK_SIZE] = { 0 };
+    EVP_CIPHER_CTX *ctx = gst_aamp_clearkey_engine_context();
+    gboolean ok;
+
+    if (!ctx || (ivLen != 8 && ivLen != AES_BLOCK_SIZE))
+    {
+        return -1;
+    }
+    // 8 byte cenc IVs are the upper half of the counter block
+    memcpy(fullIv, iv, ivLen);
+
+    g_mutex_lock(&engine->mutex);
+    const GstAampClearKey *found = gst_aamp_clearkey_engine_find(engine, kid, kidLen);
+    if (found)
+    {
+        memcpy(key, found->key, sizeof(key));
+    }
+    g_mutex_unlock(&engine->mutex);
+    if (!found)
+    {
+        GST_WARNING("no key for sample");
+        return -1;
+    }
+
+    const EVP_CIPHER *cipher = (mode == GST_AAMP_CIPHER_CBCS) ? EVP_aes_128_cbc() : EVP_aes_128_ctr();
+    ok = EVP_DecryptInit_ex(ctx, cipher, NULL, key, fullIv) && EVP_CIPHER_CTX_set_padding(ctx, 0);
+    memset(key, 0, sizeof(key));
+
+    gsize offset = 0;
+    for (guint i = 0; ok && i < (ranges ? rangeCount : 1); i++)
+    {
+        gsize clear = ranges ? ranges[i].clearBytes : 0;
+        gsize encrypted = ranges ? ranges[i].encryptedBytes : size;
+        if (offset + clear + encrypted > size)
+        {
+            GST_WARNING("subsamples exceed sample size %" G_GSIZE_FORMAT, size);
+            ok = FALSE;
+            break;
+        }
+        offset += clear;
+        if (mode == GST_AAMP_CIPHER_CBCS)
+        {
+            ok = gst_aamp_clearkey_engine_cbcs_range(ctx, fullIv, data + offset, encrypted, cryptBlocks, skipBlocks);
+        }
+        else
+        {
+            // the counter runs on across subsamples
+            ok = gst_aamp_clearkey_engine_update(ctx, data + offset, encrypted);
+        }
+        offset += encrypted;
+    }
+    return ok ? 0 : -1;
+}
@@ -0,0 +1,114 @@
+/*
+* Copyright 2018 RDK Management
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Library General Public
+* License as published by the Free Software Foundation, version 2
+* of the license.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Library General Public License for more details.
+*
+* You should have received a copy of the GNU Library General Public
+* License along with this library; if not, write to the
+* Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file gstaampclearkeyengine.h
+ * @brief Software AES engine decrypting ClearKey protected CENC samples in place
+ *
+ * Also used for HLS SAMPLE-AES, which maps onto cbcs ranges. Supports the 'cenc' (AES-128 CTR) and 'cbcs' (AES-128 CBC, crypt/skip block pattern)
+ * protection schemes. AES is done through OpenSSL EVP, which selects AES-NI or the ARMv8
+ * crypto extensions at runtime when the CPU has them.
+ */
+
+#ifndef _GST_AAMP_CLEARKEY_ENGINE_H_
+#define _GST_AAMP_CLEARKEY_ENGINE_H_
+
+#include <gst/gst.h>
+#include "gstaampcdmidecryptor.h"
+
+#define GST_AAMP_CLEARKEY_KEY_SIZE 16
+
+/**
+ * @enum GstAampCipherMode
+ * @brief Common encryption protection schemes
+ */
+enum GstAampCipherMode
+{
+    GST_AAMP_CIPHER_CENC,   // AES-CTR, encrypted ranges form one key stream
+    GST_AAMP_CIPHER_CBCS    // AES-CBC with a crypt/skip block pattern, IV reset per subsample
+};
+
+typedef struct _GstAampClearKeyEngine GstAampClearKeyEngine;
+
+/**
+ * @brief Creates an engine without keys
+ * @retval new engine
+ */
+GstAampClearKeyEngine* gst_aamp_clearkey_engine_new(void);
+
+/**
+ * @brief Frees an engine
+ * @param[in] engine engine to free
+ */
+void gst_aamp_clearkey_engine_free(GstAampClearKeyEngine *engine);
+
+/**
+ * @brief Replaces the engine's keys
+ * @param[in] engine engine
+ * @param[in] keys comma separated "kid:key" pairs, both in hex, dashes in the KID ignored.
+ *                 NULL or empty removes all keys
+ * @retval FALSE if keys could not be parsed, the engine then has no keys
+ */
+gboolean gst_aamp_clearkey_engine_set_keys(GstAampClearKeyEngine *engine, const gchar *keys);
+
+/**
+ * @brief Replaces the engine's keys with a single key
+ * @param[in] engine engine
+ * @param[in] kid key id, GST_AAMP_CLEARKEY_KEY_SIZE bytes
+ * @param[in] key key, GST_AAMP_CLEARKEY_KEY_SIZE bytes. NULL removes all keys
+ */
+void gst_aamp_clearkey_engine_set_key(GstAampClearKeyEngine *engine, const guint8 *kid, const guint8 *key);
+
+/**
+ * @brief Checks if the engine has any key
+ * @param[in] engine engine
+ * @retval TRUE if at least one key is set
+ */
+gboolean gst_aamp_clearkey_engine_has_keys(GstAampClearKeyEngine *engine);
+
+/**
+ * @brief Checks if the engine has the key for a KID
+ * @param[in] engine engine
+ * @param[in] kid key id
+ * @param[in] kidLen length of kid
+ * @retval TRUE if the key is known
+ */
+gboolean gst_aamp_clearkey_engine_has_key(GstAampClearKeyEngine *engine, const guint8 *kid, gsize kidLen);
+
+/**
+ * @brief Decrypts a sample in place
+ * @param[in] engine engine
+ * @param[in] kid key id of the sample
+ * @param[in] kidLen length of kid
+ * @param[in] mode protection scheme
+ * @param[in] iv initialization vector, 8 or 16 bytes
+ * @param[in] ivLen length of iv
+ * @param[in,out] data sample
+ * @param[in] size size of data
+ * @param[in] ranges subsample ranges, NULL to decrypt the whole sample
+ * @param[in] rangeCount number of ranges
+ * @param[in] cryptBlocks encrypted blocks of the cbcs pattern, 0 with skipBlocks 0 for no pattern
+ * @param[in] skipBlocks clear blocks of the cbcs pattern
+ * @retval 0 on success, -1 if the key is unknown or the sample malformed
+ */
+int gst_aamp_clearkey_engine_decrypt(GstAampClearKeyEngine *engine, const guint8 *kid, gsize kidLen,
+        GstAampCipherMode mode, const guint8 *iv, gsize ivLen, guint8 *data, gsize size,
+        const AampDecryptRange *ranges, guint rangeCount, guint cryptBlocks, guint skipBlocks);
+
+#endif /* _GST_AAMP_CLEARKEY_ENGINE_H_ */
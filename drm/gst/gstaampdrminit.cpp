@@ -0,0 +1,118 @@
+/*
+* Copyright 2018 RDK Management
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Library General Public
+* License as published by the Free Software Foundation, version 2
+* of the license.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Library General Public License for more details.
+*
+* You should have received a copy of the GNU Library General Public
+* License along with this library; if not, write to the
+* Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file gstaampdrminit.cpp
+ * @brief AAMP DRM gstreamer plugin initialization
+ *
+ * The decryptors live in their own plugin so that the CDM libraries they link against are
+ * only loaded when a pipeline actually needs a decryptor, not with the aamp elements.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/gst.h>
+#include "gstaampplayreadydecryptor.h"
+#include "gstaampwidevinedecryptor.h"
+#include "gstaampclearkeydecryptor.h"
+#include "gstaampverimatrixdecryptor.h"
+#include "gstaamphlssampleaesdecryptor.h"
+
+
+/**
+ * @brief plugin_init , invoked by gstreamer core on load. Registers aamp decryptor elements.
+ * @param plugin GstPlugin to which elements should be registered
+ * @retval status of operation
+ */
+static gboolean plugin_init(GstPlugin * plugin)
+{
+	gboolean ret = gst_element_register(plugin, GstPluginNamePR,
+			GST_RANK_PRIMARY, GST_TYPE_AAMPPLAYREADYDECRYPTOR );
+	if(ret)
+	{
+		logprintf("aampdrm plugin_init registered %s element\n", GstPluginNamePR);
+	}
+	else
+	{
+		logprintf("aampdrm plugin_init FAILED to register %s element\n", GstPluginNamePR);
+	}
+	ret = gst_element_register(plugin, GstPluginNameWV,
+			GST_RANK_PRIMARY, GST_TYPE_AAMPWIDEVINEDECRYPTOR );
+	if(ret)
+	{
+		logprintf("aampdrm plugin_init registered %s element\n", GstPluginNameWV);
+	}
+	else
+	{
+		logprintf("aampdrm plugin_init FAILED to register %s element\n", GstPluginNameWV);
+	}
+	ret = gst_element_register(plugin, GstPluginNameCK,
+			GST_RANK_PRIMARY, GST_TYPE_AAMPCLEARKEYDECRYPTOR );
+	if(ret)
+	{
+		logprintf("aampdrm plugin_init registered %s element\n", GstPluginNameCK);
+	}
+	else
+	{
+		logprintf("aampdrm plugin_init FAILED to register %s element\n", GstPluginNameCK);
+	}
+	ret = gst_element_register(plugin, GstPluginNameVMX,
+			GST_RANK_PRIMARY, GST_TYPE_AAMPVERIMATRIXDECRYPTOR );
+	if(ret)
+	{
+		logprintf("aampdrm plugin_init registered %s element\n", GstPluginNameVMX);
+	}
+	else
+	{
+		logprintf("aampdrm plugin_init FAILED to register %s element\n", GstPluginNameVMX);
+	}
+	// clear caps on both pads, autoplugging would insert it in every clear stream; linked by name
+	ret = gst_element_register(plugin, GstPluginNameHLS,
+			GST_RANK_NONE, GST_TYPE_AAMPHLSSAMPLEAESDECRYPTOR );
+	if(ret)
+	{
+		logprintf("aampdrm plugin_init registered %s element\n", GstPluginNameHLS);
+	}
+	else
+	{
+		logprintf("aampdrm plugin_init FAILED to register %s element\n", GstPluginNameHLS);
+	}
+	return ret;
+}
+
+#ifndef VERSION
+#define VERSION "0.0.1"
+#endif
+#ifndef PACKAGE
+#define PACKAGE "RDK"
+#endif
+#ifndef PACKAGE_NAME
+#define PACKAGE_NAME "aamp"
+#endif
+#ifndef GST_PACKAGE_ORIGIN
+#define GST_PACKAGE_ORIGIN "https://rdkcentral.com/"
+#endif
+
+GST_PLUGIN_DEFINE (GST_VERSION_MAJOR,
+		GST_VERSION_MINOR,
+		aampdrm,
+		"Advanced Adaptive Media Player decryptors",
+		plugin_init, VERSION, "LGPL", PACKAGE_NAME, GST_PACKAGE_ORIGIN)
@@ -0,0 +1,186 @@
+/*
+* Copyright 2018 RDK Management
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Library General Public
+* License as published by the Free Software Foundation, version 2
+* of the license.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Library General Public License for more details.
+*
+* You should have received a copy of the GNU Library General Public
+* License along with this library; if not, write to the
+* Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file gstaampdrmsessionregistry.cpp
+ * @brief DRM sessions shared by the decryptors of one player, discovered by key id
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include "gstaampdrmsessionregistry.h"
+
+GST_DEBUG_CATEGORY_STATIC(gst_aamp_drm_session_registry_debug_category);
+#define GST_CAT_DEFAULT gst_aamp_drm_session_registry_debug_category
+
+#define MAX_SHARE_KIDS 8
+
+/**
+ * @struct _GstAampDrmSessionShare
+ * @brief Session of a protection system and its key ids, as seen by the decryptors using it
+ */
+struct _GstAampDrmSessionShare
+{
+    AampDRMSessionManager*  manager;
+    gchar*                  systemId;
+    guint8                  kids[MAX_SHARE_KIDS][GST_AAMP_DRM_KID_SIZE];
+    guint                   kidCount;
+    gboolean                created;    // the manager holds a session for kids
+    gboolean                creating;   // a user is creating the session
+    guint                   users;
+};
+
+/**
+ * @struct GstAampDrmSessionRegistry
+ * @brief Registry state
+ */
+struct GstAampDrmSessionRegistry
+{
+    GMutex                  mutex;
+    GCond                   created;    // signalled when a share's creation ends
+    GList*                  shares;
+};
+
+static GstAampDrmSessionRegistry *gst_aamp_drm_session_registry_get(void)
+{
+    static gsize initialized = 0;
+    static GstAampDrmSessionRegistry registry;
+
+    if (g_once_init_enter(&initialized))
+    {
+        GST_DEBUG_CATEGORY_INIT(gst_aamp_drm_session_registry_debug_category, "aampdrmsessionregistry", 0,
+                "debug category for aamp DRM session registry");
+        g_mutex_init(&registry.mutex);
+        g_cond_init(&registry.created);
+        registry.shares = NULL;
+        g_once_init_leave(&initialized, 1);
+    }
+    return &registry;
+}
+
+/*
+ Finds the share of a protection system having one of kids. Called with registry mutex held.
+ */
+static GstAampDrmSessionShare *gst_aamp_drm_session_registry_find(GstAampDrmSessionRegistry *registry,
+        AampDRMSessionManager *manager, const gchar *systemId, const guint8 kids[][GST_AAMP_DRM_KID_SIZE], guint kidCount)
+{
+    for (GList *l = registry->shares; l; l = l->next)
+    {
+        GstAampDrmSessionShare *share = (GstAampDrmSessionShare *) l->data;
+        if (share->manager != manager || g_strcmp0(share->systemId, systemId))
+        {
+            continue;
+        }
+        for (guint i = 0; i < share->kidCount; i++)
+        {
+            for (guint j = 0; j < kidCount; j++)
+            {
+                if (!memcmp(share->kids[i], kids[j], GST_AAMP_DRM_KID_SIZE))
+                {
+                    return share;
+                }
+            }
+        }
+    }
+    return NULL;
+}
+
+GstAampDrmSessionShare* gst_aamp_drm_session_share_acquire(AampDRMSessionManager *manager, const gchar *systemId,
+        const guint8 kids[][GST_AAMP_DRM_KID_SIZE], guint kidCount, gboolean *creator)
+{
+    GstAampDrmSessionRegistry *registry = gst_aamp_drm_session_registry_get();
+    GstAampDrmSessionShare *share;
+
+    *creator = TRUE;
+    // an inactive manager has released or is releasing its sessions
+    if (!kidCount || !manager || SessionMgrState::eSESSIONMGR_ACTIVE != manager->getSessionMgrState())
+    {
+        return NULL;
+    }
+
+    g_mutex_lock(&registry->mutex);
+    for (;;)
+    {
+        share = gst_aamp_drm_session_registry_find(registry, manager, systemId, kids, kidCount);
+        if (!share)
+        {
+            share = g_slice_new0(GstAampDrmSessionShare);
+            share->manager = manager;
+            share->systemId = g_strdup(systemId);
+            share->kidCount = MIN(kidCount, (guint) MAX_SHARE_KIDS);
+            memcpy(share->kids, kids, share->kidCount * GST_AAMP_DRM_KID_SIZE);
+            share->creating = TRUE;
+            registry->shares = g_list_prepend(registry->shares, share);
+            GST_DEBUG("creating session for %s, %u KIDs", systemId, kidCount);
+            break;
+        }
+        if (share->created)
+        {
+            *creator = FALSE;
+            GST_DEBUG("attaching to session of %s", systemId);
+            break;
+        }
+        if (!share->creating)
+        {
+            // the previous creator failed, try again
+            share->creating = TRUE;
+            break;
+        }
+        // the share may be dropped while waiting, look it up again
+        g_cond_wait(&registry->created, &registry->mutex);
+    }
+    share->users++;
+    g_mutex_unlock(&registry->mutex);
+    return share;
+}
+
+void gst_aamp_drm_session_share_complete(GstAampDrmSessionShare *share, gboolean created)
+{
+    GstAampDrmSessionRegistry *registry = gst_aamp_drm_session_registry_get();
+
+    g_mutex_lock(&registry->mutex);
+    share->created = created;
+    share->creating = FALSE;
+    g_cond_broadcast(&registry->created);
+    g_mutex_unlock(&registry->mutex);
+}
+
+void gst_aamp_drm_session_share_release(GstAampDrmSessionShare *share)
+{
+    GstAampDrmSessionRegistry *registry = gst_aamp_drm_session_registry_get();
+
+    if (!share)
+    {
+        return;
+    }
+    g_mutex_lock(&registry->mutex);
+    if (--share->users == 0)
+    {
+        registry->shares = g_list_remove(registry->shares, share);
+        // a creator leaving without completing must not leave waiters behind
+        g_cond_broadcast(&registry->created);
+        GST_DEBUG("dropping share of %s", share->systemId);
+        g_free(share->systemId);
+        g_slice_free(GstAampDrmSessionShare, share);
+    }
+    g_mutex_unlock(&registry->mutex);
+}
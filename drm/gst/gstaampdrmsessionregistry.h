@@ -0,0 +1,75 @@
+/*
+* Copyright 2018 RDK Management
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Library General Public
+* License as published by the Free Software Foundation, version 2
+* of the license.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Library General Public License for more details.
+*
+* You should have received a copy of the GNU Library General Public
+* License along with this library; if not, write to the
+* Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file gstaampdrmsessionregistry.h
+ * @brief DRM sessions shared by the decryptors of one player, discovered by key id
+ *
+ * The audio and video decryptors of a player usually see init data for the same keys.
+ * The first decryptor to ask for a key creates the session, decryptors asking for the
+ * same protection system and an overlapping key id while that is in progress wait for
+ * it, instead of issuing their own license request. Sessions stay owned by the session
+ * manager and are not cached here, the manager frees them on retune: once created,
+ * decryptors look the session up in the manager, which hands out the session it holds
+ * for the keys. Entries are refcounted by the decryptors using them and dropped with
+ * the last one.
+ */
+
+#ifndef _GST_AAMP_DRM_SESSION_REGISTRY_H_
+#define _GST_AAMP_DRM_SESSION_REGISTRY_H_
+
+#include <gst/gst.h>
+#include "AampDRMSessionManager.h"
+
+#define GST_AAMP_DRM_KID_SIZE 16
+
+typedef struct _GstAampDrmSessionShare GstAampDrmSessionShare;
+
+/**
+ * @brief Joins the shared session for a set of key ids
+ *
+ * Waits while another decryptor is creating the session. When no session was created yet,
+ * or the previous attempt failed, the caller becomes its creator and must report the
+ * outcome with gst_aamp_drm_session_share_complete(). Otherwise the session was created
+ * and the caller gets it from the session manager.
+ * @param[in] manager session manager of the player
+ * @param[in] systemId protection system id
+ * @param[in] kids key ids of the init data
+ * @param[in] kidCount number of kids
+ * @param[out] creator TRUE if the caller is to create the session
+ * @retval share to release with gst_aamp_drm_session_share_release(), NULL if sessions
+ *         cannot be shared (no key ids or inactive manager)
+ */
+GstAampDrmSessionShare* gst_aamp_drm_session_share_acquire(AampDRMSessionManager *manager, const gchar *systemId,
+        const guint8 kids[][GST_AAMP_DRM_KID_SIZE], guint kidCount, gboolean *creator);
+
+/**
+ * @brief Ends the creation of the session of a share and wakes waiting decryptors
+ * @param[in] share share the caller became creator of
+ * @param[in] created FALSE if creation failed, one of the waiters then takes over
+ */
+void gst_aamp_drm_session_share_complete(GstAampDrmSessionShare *share, gboolean created);
+
+/**
+ * @brief Leaves a share, dropping it with its last user
+ * @param[in] share share to leave, may be NULL
+ */
+void gst_aamp_drm_session_share_release(GstAampDrmSessionShare *share);
+
+#endif /* _GST_AAMP_DRM_SESSION_REGISTRY_H_ */
@@ -0,0 +1,760 @@
+/*
+* Copyright 2018 RDK Management
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Library General Public
+* License as published by the Free Software Foundation, version 2
+* of the license.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Library General Public License for more details.
+*
+* You should have received a copy of the GNU Library General Public
+* License along with this library; if not, write to the
+* Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file gstaamphlssampleaesdecryptor.cpp
+ * @brief aamp HLS SAMPLE-AES decryptor plugin definitions
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include <gst/gst.h>
+#include <gst/base/gstbasetransform.h>
+#include "gstaamphlssampleaesdecryptor.h"
+#include "gstaampprotectionmeta.h"
+//#define FUNCTION_DEBUG 1
+#ifdef FUNCTION_DEBUG
+#define DEBUG_FUNC()    g_warning("####### %s : %d ####\n", __FUNCTION__, __LINE__);
+#else
+#define DEBUG_FUNC()
+#endif
+
+#define SAMPLE_AES_BLOCK_SIZE 16
+#define SAMPLE_AES_VIDEO_LEADER 32      // clear bytes of an encrypted NAL unit, NAL header included
+#define SAMPLE_AES_VIDEO_MIN_SIZE 48    // NAL units up to this size are clear
+#define SAMPLE_AES_VIDEO_CRYPT_BLOCKS 1
+#define SAMPLE_AES_VIDEO_SKIP_BLOCKS 9
+#define SAMPLE_AES_AUDIO_LEADER 16      // clear bytes of a frame, after the ADTS header
+#define ADTS_HEADER_SIZE 7              // without CRC
+#define AC3_HEADER_SIZE 6
+#define AC3_FRAME_SIZE_CODES 38
+#define MIN_RANGES 16
+
+// SAMPLE-AES has no key ids, the key of the current segments is held under this one
+static const guint8 sampleAesKid[GST_AAMP_CLEARKEY_KEY_SIZE] = { 0 };
+
+/*
+ Key and IV of the segments starting at a position, queued until the first sample there.
+ */
+typedef struct
+{
+    GstClockTime    position;   // stream time of the first sample of the segments
+    gboolean        encrypted;  // segments are encrypted, key and IV set if valid
+    gboolean        valid;
+    guint8          key[GST_AAMP_CLEARKEY_KEY_SIZE];
+    guint8          iv[GST_AAMP_CLEARKEY_KEY_SIZE];
+} GstAampSampleAesKey;
+
+// AC-3 syncframe sizes in 16 bit words by frmsizecod and fscod (48, 44.1 and 32 kHz)
+static const guint16 ac3FrameSizes[AC3_FRAME_SIZE_CODES][3] =
+{
+    { 64, 69, 96 }, { 64, 70, 96 }, { 80, 87, 120 }, { 80, 88, 120 },
+    { 96, 104, 144 }, { 96, 105, 144 }, { 112, 121, 168 }, { 112, 122, 168 },
+    { 128, 139, 192 }, { 128, 140, 192 }, { 160, 174, 240 }, { 160, 175, 240 },
+    { 192, 208, 288 }, { 192, 209, 288 }, { 224, 243, 336 }, { 224, 244, 336 },
+    { 256, 278, 384 }, { 256, 279, 384 }, { 320, 348, 480 }, { 320, 349, 480 },
+    { 384, 417, 576 }, { 384, 418, 576 }, { 448, 487, 672 }, { 448, 488, 672 },
+    { 512, 557, 768 }, { 512, 558, 768 }, { 640, 696, 960 }, { 640, 697, 960 },
+    { 768, 835, 1152 }, { 768, 836, 1152 }, { 896, 975, 1344 }, { 896, 976, 1344 },
+    { 1024, 1114, 1536 }, { 1024, 1115, 1536 }, { 1152, 1253, 1728 }, { 1152, 1254, 1728 },
+    { 1280, 1393, 1920 }, { 1280, 1394, 1920 }
+};
+
+/* prototypes */
+static void gst_aamphlssampleaesdecryptor_finalize(GObject*);
+static GstCaps* gst_aamphlssampleaesdecryptor_transform_caps(GstBaseTransform * trans,
+        GstPadDirection direction, GstCaps * caps, GstCaps * filter);
+static gboolean gst_aamphlssampleaesdecryptor_set_caps(GstBaseTransform * trans,
+        GstCaps * incaps, GstCaps * outcaps);
+static gboolean gst_aamphlssampleaesdecryptor_sink_event(GstBaseTransform * trans,
+        GstEvent * event);
+static GstFlowReturn gst_aamphlssampleaesdecryptor_transform_ip(GstBaseTransform * trans,
+        GstBuffer * buffer);
+static gboolean gst_aamphlssampleaesdecryptor_local_decrypt(GstAampCDMIDecryptor* decryptor, GstBuffer* buffer,
+        const AampCDMISampleInfo* info, int* errorCode, gsize* encryptedBytes);
+static void gst_aamphlssampleaesdecryptor_free_key(GstAampSampleAesKey* key);
+
+/* class initialization */
+#define gst_aamphlssampleaesdecryptor_parent_class parent_class
+G_DEFINE_TYPE(GstAamphlssampleaesdecryptor, gst_aamphlssampleaesdecryptor, GST_TYPE_AAMP_CDMI_DECRYPTOR);
+
+GST_DEBUG_CATEGORY(gst_aamphlssampleaesdecryptor_debug_category);
+#define GST_CAT_DEFAULT gst_aamphlssampleaesdecryptor_debug_category
+
+
+/* pad templates */
+
+#define SAMPLE_AES_CAPS \
+        "video/x-h264, stream-format=(string)byte-stream; " \
+        "audio/mpeg, mpegversion=(int){ 2, 4 }, stream-format=(string)adts; " \
+        "audio/x-ac3; " \
+        "audio/x-eac3"
+
+static GstStaticPadTemplate gst_aamphlssampleaesdecryptor_src_template =
+        GST_STATIC_PAD_TEMPLATE("src", GST_PAD_SRC, GST_PAD_ALWAYS,
+        GST_STATIC_CAPS(SAMPLE_AES_CAPS));
+
+static GstStaticPadTemplate gst_aamphlssampleaesdecryptor_sink_template =
+        GST_STATIC_PAD_TEMPLATE("sink", GST_PAD_SINK, GST_PAD_ALWAYS,
+        GST_STATIC_CAPS(SAMPLE_AES_CAPS));
+
+/**
+ * @brief HLS SAMPLE-AES decryptor class initialization
+ * @param klass Gstreamer Class
+ */
+static void gst_aamphlssampleaesdecryptor_class_init(
+        GstAamphlssampleaesdecryptorClass * klass)
+{
+    GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+    GstElementClass* elementClass = GST_ELEMENT_CLASS(klass);
+    GstBaseTransformClass* baseTransformClass = GST_BASE_TRANSFORM_CLASS(klass);
+    GstAampCDMIDecryptorClass* decryptorClass = GST_AAMP_CDMI_DECRYPTOR_CLASS(klass);
+
+    DEBUG_FUNC();
+
+    gobject_class->finalize = gst_aamphlssampleaesdecryptor_finalize;
+    baseTransformClass->transform_caps = GST_DEBUG_FUNCPTR(gst_aamphlssampleaesdecryptor_transform_caps);
+    baseTransformClass->set_caps = GST_DEBUG_FUNCPTR(gst_aamphlssampleaesdecryptor_set_caps);
+    baseTransformClass->sink_event = GST_DEBUG_FUNCPTR(gst_aamphlssampleaesdecryptor_sink_event);
+    baseTransformClass->transform_ip = GST_DEBUG_FUNCPTR(gst_aamphlssampleaesdecryptor_transform_ip);
+    decryptorClass->local_decrypt = gst_aamphlssampleaesdecryptor_local_decrypt;
+
+    gst_element_class_add_static_pad_template(elementClass, &gst_aamphlssampleaesdecryptor_src_template);
+    gst_element_class_add_static_pad_template(elementClass, &gst_aamphlssampleaesdecryptor_sink_template);
+
+    gst_element_class_set_static_metadata(elementClass,
+            "Decrypt HLS SAMPLE-AES encrypted contents",
+            GST_ELEMENT_FACTORY_KLASS_DECRYPTOR,
+            "Decrypts HLS SAMPLE-AES encrypted H.264, AAC and AC-3 elementary streams.",
+            "comcast");
+}
+
+/**
+ * @brief HLS SAMPLE-AES decryptor element initialization
+ * @param aamphlssampleaesdecryptor HLS SAMPLE-AES decryptor element pointer
+ */
+static void gst_aamphlssampleaesdecryptor_init(GstAamphlssampleaesdecryptor *aamphlssampleaesdecryptor)
+{
+    DEBUG_FUNC();
+    aamphlssampleaesdecryptor->engine = gst_aamp_clearkey_engine_new();
+    memset(aamphlssampleaesdecryptor->iv, 0, sizeof(aamphlssampleaesdecryptor->iv));
+    g_queue_init(&aamphlssampleaesdecryptor->keys);
+    aamphlssampleaesdecryptor->format = GST_AAMP_SAMPLE_AES_UNKNOWN;
+    aamphlssampleaesdecryptor->ranges = NULL;
+    aamphlssampleaesdecryptor->rangesSize = 0;
+    aamphlssampleaesdecryptor->nal = NULL;
+    aamphlssampleaesdecryptor->nalSize = 0;
+    aamphlssampleaesdecryptor->output = NULL;
+    aamphlssampleaesdecryptor->outputSize = 0;
+    // decrypted in host memory, there is no secure video path to feed
+    GST_AAMP_CDMI_DECRYPTOR(aamphlssampleaesdecryptor)->ignoreSVP = true;
+}
+
+/**
+ * @brief HLS SAMPLE-AES decryptor element termination
+ * @param object HLS SAMPLE-AES decryptor element pointer
+ */
+static void gst_aamphlssampleaesdecryptor_finalize(GObject * object)
+{
+    DEBUG_FUNC();
+    GstAamphlssampleaesdecryptor* aamphlssampleaesdecryptor = GST_AAMPHLSSAMPLEAESDECRYPTOR(object);
+    gst_aamp_clearkey_engine_free(aamphlssampleaesdecryptor->engine);
+    aamphlssampleaesdecryptor->engine = NULL;
+    g_queue_free_full(&aamphlssampleaesdecryptor->keys, (GDestroyNotify) gst_aamphlssampleaesdecryptor_free_key);
+    g_queue_init(&aamphlssampleaesdecryptor->keys);
+    g_free(aamphlssampleaesdecryptor->ranges);
+    aamphlssampleaesdecryptor->ranges = NULL;
+    aamphlssampleaesdecryptor->rangesSize = 0;
+    g_free(aamphlssampleaesdecryptor->nal);
+    aamphlssampleaesdecryptor->nal = NULL;
+    aamphlssampleaesdecryptor->nalSize = 0;
+    g_free(aamphlssampleaesdecryptor->output);
+    aamphlssampleaesdecryptor->output = NULL;
+    aamphlssampleaesdecryptor->outputSize = 0;
+    GST_CALL_PARENT(G_OBJECT_CLASS, finalize, (object));
+}
+
+/**
+ * @brief Transforms caps, decryption keeps the stream format
+ * @param trans HLS SAMPLE-AES decryptor element pointer
+ * @param direction direction of caps
+ * @param caps caps to transform
+ * @param filter caps to intersect the result with, may be NULL
+ * @retval transformed caps
+ */
+static GstCaps* gst_aamphlssampleaesdecryptor_transform_caps(GstBaseTransform * trans,
+        GstPadDirection direction, GstCaps * caps, GstCaps * filter)
+{
+    if (filter)
+    {
+        return gst_caps_intersect_full(filter, caps, GST_CAPS_INTERSECT_FIRST);
+    }
+    return gst_caps_ref(caps);
+}
+
+/**
+ * @brief Selects the encryption layout from the sink caps
+ * @param trans HLS SAMPLE-AES decryptor element pointer
+ * @param incaps sink caps
+ * @param outcaps src caps
+ * @retval TRUE
+ */
+static gboolean gst_aamphlssampleaesdecryptor_set_caps(GstBaseTransform * trans,
+        GstCaps * incaps, GstCaps * outcaps)
+{
+    GstAamphlssampleaesdecryptor* aamphlssampleaesdecryptor = GST_AAMPHLSSAMPLEAESDECRYPTOR(trans);
+    const GstStructure* structure = gst_caps_get_structure(incaps, 0);
+
+    if (gst_structure_has_name(structure, "video/x-h264"))
+    {
+        aamphlssampleaesdecryptor->format = GST_AAMP_SAMPLE_AES_H264;
+    }
+    else if (gst_structure_has_name(structure, "audio/mpeg"))
+    {
+        aamphlssampleaesdecryptor->format = GST_AAMP_SAMPLE_AES_ADTS;
+    }
+    else if (gst_structure_has_name(structure, "audio/x-ac3") || gst_structure_has_name(structure, "audio/x-eac3"))
+    {
+        aamphlssampleaesdecryptor->format = GST_AAMP_SAMPLE_AES_AC3;
+    }
+    else
+    {
+        aamphlssampleaesdecryptor->format = GST_AAMP_SAMPLE_AES_UNKNOWN;
+    }
+    GST_DEBUG_OBJECT(aamphlssampleaesdecryptor, "caps %" GST_PTR_FORMAT ", format %d",
+            incaps, aamphlssampleaesdecryptor->format);
+    return TRUE;
+}
+
+/*
+ Frees a queued key, wiping it.
+ */
+static void gst_aamphlssampleaesdecryptor_free_key(GstAampSampleAesKey* key)
+{
+    memset(key, 0, sizeof(*key));
+    g_slice_free(GstAampSampleAesKey, key);
+}
+
+/*
+ Drops the keys of segments no sample was seen of.
+ */
+static void gst_aamphlssampleaesdecryptor_clear_keys(GstAamphlssampleaesdecryptor* aamphlssampleaesdecryptor)
+{
+    g_queue_free_full(&aamphlssampleaesdecryptor->keys, (GDestroyNotify) gst_aamphlssampleaesdecryptor_free_key);
+    g_queue_init(&aamphlssampleaesdecryptor->keys);
+}
+
+/*
+ Makes key the key of the current segments, freeing it.
+ */
+static void gst_aamphlssampleaesdecryptor_apply_key(GstAamphlssampleaesdecryptor* aamphlssampleaesdecryptor,
+        GstAampSampleAesKey* key)
+{
+    if (key->valid)
+    {
+        memcpy(aamphlssampleaesdecryptor->iv, key->iv, sizeof(aamphlssampleaesdecryptor->iv));
+        gst_aamp_clearkey_engine_set_key(aamphlssampleaesdecryptor->engine, sampleAesKid, key->key);
+    }
+    else
+    {
+        // an invalid key fails samples to decrypt, they are reported as such instead of passing through encrypted
+        gst_aamp_clearkey_engine_set_key(aamphlssampleaesdecryptor->engine, NULL, NULL);
+    }
+    GST_AAMP_CDMI_DECRYPTOR(aamphlssampleaesdecryptor)->localDecrypt = key->encrypted;
+    GST_DEBUG_OBJECT(aamphlssampleaesdecryptor, "segments from %" GST_TIME_FORMAT " are %s",
+            GST_TIME_ARGS(key->position), key->encrypted ? "encrypted" : "clear");
+    gst_aamphlssampleaesdecryptor_free_key(key);
+}
+
+/*
+ Applies the queued keys of the segments starting at or before position, the stream time of
+ the sample about to be decrypted.
+ */
+static void gst_aamphlssampleaesdecryptor_update_key(GstAamphlssampleaesdecryptor* aamphlssampleaesdecryptor,
+        GstClockTime position)
+{
+    GstAampSampleAesKey* key;
+
+    // samples without timestamp stay with the current segments
+    while (GST_CLOCK_TIME_IS_VALID(position)
+            && (key = (GstAampSampleAesKey*) g_queue_peek_head(&aamphlssampleaesdecryptor->keys))
+            && key->position <= position)
+    {
+        gst_aamphlssampleaesdecryptor_apply_key(aamphlssampleaesdecryptor,
+                (GstAampSampleAesKey*) g_queue_pop_head(&aamphlssampleaesdecryptor->keys));
+    }
+}
+
+/**
+ * @brief Takes the key and IV of the following segments from a key event
+ *
+ * Samples before the position of the event keep the key of their segment.
+ * @param aamphlssampleaesdecryptor HLS SAMPLE-AES decryptor element pointer
+ * @param structure key event structure
+ */
+static void gst_aamphlssampleaesdecryptor_set_key(GstAamphlssampleaesdecryptor* aamphlssampleaesdecryptor,
+        const GstStructure* structure)
+{
+    const GValue* keyValue = gst_structure_get_value(structure, GST_AAMP_HLS_SAMPLE_AES_KEY_FIELD);
+    const GValue* ivValue = gst_structure_get_value(structure, GST_AAMP_HLS_SAMPLE_AES_IV_FIELD);
+    GstBuffer* key = (keyValue && GST_VALUE_HOLDS_BUFFER(keyValue)) ? gst_value_get_buffer(keyValue) : NULL;
+    GstBuffer* iv = (ivValue && GST_VALUE_HOLDS_BUFFER(ivValue)) ? gst_value_get_buffer(ivValue) : NULL;
+    GstAampSampleAesKey* entry = g_slice_new0(GstAampSampleAesKey);
+
+    if (!gst_structure_get_clock_time(structure, GST_AAMP_HLS_SAMPLE_AES_POSITION_FIELD, &entry->position))
+    {
+        entry->position = GST_CLOCK_TIME_NONE;
+    }
+    entry->encrypted = (NULL != key);
+    if (key && iv && gst_buffer_get_size(key) == sizeof(entry->key) && gst_buffer_get_size(iv) == sizeof(entry->iv))
+    {
+        gst_buffer_extract(key, 0, entry->key, sizeof(entry->key));
+        gst_buffer_extract(iv, 0, entry->iv, sizeof(entry->iv));
+        entry->valid = TRUE;
+    }
+    else if (key)
+    {
+        GST_ERROR_OBJECT(aamphlssampleaesdecryptor, "invalid SAMPLE-AES key event, expected 16 byte key and IV");
+    }
+
+    if (!GST_CLOCK_TIME_IS_VALID(entry->position))
+    {
+        // untagged, takes over from the queued keys at once
+        gst_aamphlssampleaesdecryptor_clear_keys(aamphlssampleaesdecryptor);
+        gst_aamphlssampleaesdecryptor_apply_key(aamphlssampleaesdecryptor, entry);
+    }
+    else
+    {
+        GST_DEBUG_OBJECT(aamphlssampleaesdecryptor, "segments from %" GST_TIME_FORMAT " are %s",
+                GST_TIME_ARGS(entry->position), key ? "encrypted" : "clear");
+        g_queue_push_tail(&aamphlssampleaesdecryptor->keys, entry);
+    }
+}
+
+/**
+ * @brief Handles the SAMPLE-AES key events, other events go to the CDMI decryptor
+ * @param trans HLS SAMPLE-AES decryptor element pointer
+ * @param event event to handle
+ * @retval TRUE if the event was handled
+ */
+static gboolean gst_aamphlssampleaesdecryptor_sink_event(GstBaseTransform * trans,
+        GstEvent * event)
+{
+    if (gst_event_has_name(event, GST_AAMP_HLS_SAMPLE_AES_EVENT))
+    {
+        gst_aamphlssampleaesdecryptor_set_key(GST_AAMPHLSSAMPLEAESDECRYPTOR(trans), gst_event_get_structure(event));
+        gst_event_unref(event);
+        return TRUE;
+    }
+    if (GST_EVENT_TYPE(event) == GST_EVENT_FLUSH_STOP)
+    {
+        // segments after the flush come with their own key events
+        gst_aamphlssampleaesdecryptor_clear_keys(GST_AAMPHLSSAMPLEAESDECRYPTOR(trans));
+    }
+    return GST_BASE_TRANSFORM_CLASS(parent_class)->sink_event(trans, event);
+}
+
+/**
+ * @brief Hands samples of encrypted segments to the CDMI decryptor, passes clear ones through
+ * @param trans HLS SAMPLE-AES decryptor element pointer
+ * @param buffer sample
+ * @retval flow return
+ */
+static GstFlowReturn gst_aamphlssampleaesdecryptor_transform_ip(GstBaseTransform * trans,
+        GstBuffer * buffer)
+{
+    GstAamphlssampleaesdecryptor* aamphlssampleaesdecryptor = GST_AAMPHLSSAMPLEAESDECRYPTOR(trans);
+    GstClockTime position = GST_CLOCK_TIME_NONE;
+
+    // the sample may still belong to a segment before the last key event
+    if (trans->segment.format == GST_FORMAT_TIME)
+    {
+        position = gst_segment_to_stream_time(&trans->segment, GST_FORMAT_TIME, GST_BUFFER_PTS(buffer));
+    }
+    gst_aamphlssampleaesdecryptor_update_key(aamphlssampleaesdecryptor, position);
+    if (!GST_AAMP_CDMI_DECRYPTOR(trans)->localDecrypt)
+    {
+        return GST_FLOW_OK;
+    }
+    // tsdemux output has no protection metadata, the segment IV stands in for it
+    gst_buffer_add_aamp_protection_meta(buffer, aamphlssampleaesdecryptor->iv, sizeof(aamphlssampleaesdecryptor->iv),
+            sampleAesKid, 0, NULL);
+    return GST_BASE_TRANSFORM_CLASS(parent_class)->transform_ip(trans, buffer);
+}
+
+/*
+ Appends a range to the range list, growing it as needed.
+ */
+static void gst_aamphlssampleaesdecryptor_add_range(GstAamphlssampleaesdecryptor* aamphlssampleaesdecryptor,
+        guint* rangeCount, gsize clearBytes, gsize encryptedBytes)
+{
+    if (*rangeCount == aamphlssampleaesdecryptor->rangesSize)
+    {
+        aamphlssampleaesdecryptor->rangesSize = MAX(MIN_RANGES, aamphlssampleaesdecryptor->rangesSize * 2);
+        aamphlssampleaesdecryptor->ranges = g_renew(AampDecryptRange, aamphlssampleaesdecryptor->ranges,
+                aamphlssampleaesdecryptor->rangesSize);
+    }
+    aamphlssampleaesdecryptor->ranges[*rangeCount].clearBytes = (uint32_t) clearBytes;
+    aamphlssampleaesdecryptor->ranges[*rangeCount].encryptedBytes = (uint32_t) encryptedBytes;
+    (*rangeCount)++;
+}
+
+/*
+ Returns the offset of the next 00 00 01 start code at or after pos, size if there is none.
+ */
+static gsize gst_aamphlssampleaesdecryptor_start_code(const guint8* data, gsize size, gsize pos)
+{
+    for (; pos + 3 <= size; pos++)
+    {
+        if (data[pos + 2] > 1)
+        {
+            // no start code begins at pos, pos + 1 or pos + 2
+            pos += 2;
+        }
+        else if (!data[pos] && !data[pos + 1] && data[pos + 2] == 1)
+        {
+            return pos;
+        }
+    }
+    return size;
+}
+
+/*
+ Grows a scratch buffer to hold at least size bytes, keeping its content.
+ */
+static guint8* gst_aamphlssampleaesdecryptor_reserve(guint8** scratch, gsize* scratchSize, gsize size)
+{
+    if (size > *scratchSize)
+    {
+        *scratchSize = MAX(size, *scratchSize * 2);
+        *scratch = (guint8*) g_realloc(*scratch, *scratchSize);
+    }
+    return *scratch;
+}
+
+/*
+ Copies a NAL unit from src to dst dropping its emulation prevention bytes.
+ Returns the bytes written, at most size.
+ */
+static gsize gst_aamphlssampleaesdecryptor_unescape(guint8* dst, const guint8* src, gsize size)
+{
+    gsize written = 0;
+    guint zeros = 0;
+
+    for (gsize i = 0; i < size; i++)
+    {
+        if (zeros >= 2 && src[i] == 3)
+        {
+            zeros = 0;
+            continue;
+        }
+        dst[written++] = src[i];
+        zeros = src[i] ? 0 : zeros + 1;
+    }
+    return written;
+}
+
+/*
+ Copies a NAL unit from src to dst inserting emulation prevention bytes where its content
+ would read as a start code. Returns the bytes written, at most size + size / 2 + 1.
+ */
+static gsize gst_aamphlssampleaesdecryptor_escape(guint8* dst, const guint8* src, gsize size)
+{
+    gsize written = 0;
+    guint zeros = 0;
+
+    for (gsize i = 0; i < size; i++)
+    {
+        if (zeros >= 2 && src[i] <= 3)
+        {
+            dst[written++] = 3;
+            zeros = 0;
+        }
+        dst[written++] = src[i];
+        zeros = src[i] ? 0 : zeros + 1;
+    }
+    // a trailing zero would merge with the next start code
+    if (written && !dst[written - 1])
+    {
+        dst[written++] = 3;
+    }
+    return written;
+}
+
+/*
+ Decrypts the encrypted NAL units of an H.264 access unit into the output scratch. Encryption
+ applies to NAL units without emulation prevention, which is added after it: each NAL unit is
+ unescaped, decrypted and escaped again, which can leave it shorter or longer than it was.
+ Returns the number of NAL units decrypted, the access unit is left alone if there are none.
+ */
+static guint gst_aamphlssampleaesdecryptor_h264_decrypt(GstAamphlssampleaesdecryptor* aamphlssampleaesdecryptor,
+        const AampCDMISampleInfo* info, const guint8* data, gsize size, gsize* outputSize, int* errorCode,
+        gsize* encryptedBytes)
+{
+    gsize pos = gst_aamphlssampleaesdecryptor_start_code(data, size, 0);
+    gsize copied = 0;
+    gsize written = 0;
+    guint decrypted = 0;
+
+    pos = (pos < size) ? pos + 3 : size;
+    *errorCode = 0;
+    while (pos < size && !*errorCode)
+    {
+        gsize next = gst_aamphlssampleaesdecryptor_start_code(data, size, pos);
+        gsize end = next;
+
+        // trailing zeros belong to the next start code
+        while (end > pos && !data[end - 1])
+        {
+            end--;
+        }
+        guint8 type = data[pos] & 0x1f;
+        gsize nalSize = end - pos;
+        // only non-IDR and IDR slices are encrypted
+        if (type == 1 || type == 5)
+        {
+            guint8* nal = gst_aamphlssampleaesdecryptor_reserve(&aamphlssampleaesdecryptor->nal,
+                    &aamphlssampleaesdecryptor->nalSize, nalSize);
+            gsize rbspSize = gst_aamphlssampleaesdecryptor_unescape(nal, data + pos, nalSize);
+            if (rbspSize > SAMPLE_AES_VIDEO_MIN_SIZE)
+            {
+                // SAMPLE-AES restarts the CBC chain with each NAL unit, as cbcs does with each subsample
+                AampDecryptRange range = { SAMPLE_AES_VIDEO_LEADER, (uint32_t) (rbspSize - SAMPLE_AES_VIDEO_LEADER) };
+                *errorCode = gst_aamp_clearkey_engine_decrypt(aamphlssampleaesdecryptor->engine, sampleAesKid,
+                        sizeof(sampleAesKid), GST_AAMP_CIPHER_CBCS, info->iv, info->ivLength, nal, rbspSize,
+                        &range, 1, SAMPLE_AES_VIDEO_CRYPT_BLOCKS, SAMPLE_AES_VIDEO_SKIP_BLOCKS);
+
+                gsize blocks = range.encryptedBytes / SAMPLE_AES_BLOCK_SIZE;
+                gsize period = SAMPLE_AES_VIDEO_CRYPT_BLOCKS + SAMPLE_AES_VIDEO_SKIP_BLOCKS;
+                blocks = (blocks / period) * SAMPLE_AES_VIDEO_CRYPT_BLOCKS + MIN(blocks % period, (gsize) SAMPLE_AES_VIDEO_CRYPT_BLOCKS);
+                *encryptedBytes += blocks * SAMPLE_AES_BLOCK_SIZE;
+
+                // start codes and clear NAL units since the previous encrypted one go unchanged
+                guint8* output = gst_aamphlssampleaesdecryptor_reserve(&aamphlssampleaesdecryptor->output,
+                        &aamphlssampleaesdecryptor->outputSize, written + (pos - copied) + rbspSize + rbspSize / 2 + 1);
+                memcpy(output + written, data + copied, pos - copied);
+                written += pos - copied;
+                written += gst_aamphlssampleaesdecryptor_escape(output + written, nal, rbspSize);
+                copied = end;
+                decrypted++;
+            }
+        }
+        pos = (next < size) ? next + 3 : size;
+    }
+    if (decrypted)
+    {
+        guint8* output = gst_aamphlssampleaesdecryptor_reserve(&aamphlssampleaesdecryptor->output,
+                &aamphlssampleaesdecryptor->outputSize, written + (size - copied));
+        memcpy(output + written, data + copied, size - copied);
+        written += size - copied;
+    }
+    *outputSize = written;
+    return decrypted;
+}
+
+/*
+ Lays out the frames of an ADTS sample as cbcs ranges. Returns FALSE unless the sample
+ holds whole frames.
+ */
+static gboolean gst_aamphlssampleaesdecryptor_adts_ranges(GstAamphlssampleaesdecryptor* aamphlssampleaesdecryptor,
+        const guint8* data, gsize size, guint* rangeCount)
+{
+    gsize pos = 0;
+    gsize rangeEnd = 0;
+
+    while (pos + ADTS_HEADER_SIZE <= size)
+    {
+        if (data[pos] != 0xff || (data[pos + 1] & 0xf6) != 0xf0)
+        {
+            return FALSE;
+        }
+        // protection_absent, otherwise a CRC follows the header
+        gsize headerSize = (data[pos + 1] & 0x01) ? ADTS_HEADER_SIZE : ADTS_HEADER_SIZE + 2;
+        gsize frameSize = ((gsize) (data[pos + 3] & 0x03) << 11) | ((gsize) data[pos + 4] << 3) | (data[pos + 5] >> 5);
+        if (frameSize < headerSize || frameSize > size - pos)
+        {
+            return FALSE;
+        }
+        if (frameSize > headerSize + SAMPLE_AES_AUDIO_LEADER)
+        {
+            gst_aamphlssampleaesdecryptor_add_range(aamphlssampleaesdecryptor, rangeCount,
+                    pos + headerSize + SAMPLE_AES_AUDIO_LEADER - rangeEnd,
+                    frameSize - headerSize - SAMPLE_AES_AUDIO_LEADER);
+            rangeEnd = pos + frameSize;
+        }
+        pos += frameSize;
+    }
+    return pos == size;
+}
+
+/*
+ Lays out the syncframes of an AC-3 or E-AC-3 sample as cbcs ranges. Returns FALSE unless
+ the sample holds whole syncframes.
+ */
+static gboolean gst_aamphlssampleaesdecryptor_ac3_ranges(GstAamphlssampleaesdecryptor* aamphlssampleaesdecryptor,
+        const guint8* data, gsize size, guint* rangeCount)
+{
+    gsize pos = 0;
+    gsize rangeEnd = 0;
+
+    while (pos + AC3_HEADER_SIZE <= size)
+    {
+        gsize frameSize;
+
+        if (data[pos] != 0x0b || data[pos + 1] != 0x77)
+        {
+            return FALSE;
+        }
+        // bsid above 10 is E-AC-3, which has the frame size in the header
+        if ((data[pos + 5] >> 3) > 10)
+        {
+            frameSize = ((((gsize) (data[pos + 2] & 0x07) << 8) | data[pos + 3]) + 1) * 2;
+        }
+        else
+        {
+            guint fscod = data[pos + 4] >> 6;
+            guint frmsizecod = data[pos + 4] & 0x3f;
+            if (fscod == 3 || frmsizecod >= AC3_FRAME_SIZE_CODES)
+            {
+                return FALSE;
+            }
+            frameSize = (gsize) ac3FrameSizes[frmsizecod][fscod] * 2;
+        }
+        if (frameSize > size - pos)
+        {
+            return FALSE;
+        }
+        if (frameSize > SAMPLE_AES_AUDIO_LEADER)
+        {
+            gst_aamphlssampleaesdecryptor_add_range(aamphlssampleaesdecryptor, rangeCount,
+                    pos + SAMPLE_AES_AUDIO_LEADER - rangeEnd, frameSize - SAMPLE_AES_AUDIO_LEADER);
+            rangeEnd = pos + frameSize;
+        }
+        pos += frameSize;
+    }
+    return pos == size;
+}
+
+/*
+ Decrypts an H.264 access unit, replacing the content of buffer by the decrypted one.
+ */
+static void gst_aamphlssampleaesdecryptor_h264_local_decrypt(GstAamphlssampleaesdecryptor* aamphlssampleaesdecryptor,
+        GstBuffer* buffer, const AampCDMISampleInfo* info, int* errorCode, gsize* encryptedBytes)
+{
+    gsize outputSize = 0;
+    gsize size;
+    guint decrypted;
+    GstMapInfo map;
+
+    if (!gst_buffer_map(buffer, &map, GST_MAP_READ))
+    {
+        return;
+    }
+    decrypted = gst_aamphlssampleaesdecryptor_h264_decrypt(aamphlssampleaesdecryptor, info, map.data, map.size,
+            &outputSize, errorCode, encryptedBytes);
+    size = map.size;
+    gst_buffer_unmap(buffer, &map);
+
+    if (!decrypted || *errorCode)
+    {
+        return;
+    }
+    if (outputSize > size)
+    {
+        // escaping the decrypted NAL units took more bytes than the encrypted ones had
+        gst_buffer_replace_all_memory(buffer, gst_allocator_alloc(NULL, outputSize, NULL));
+    }
+    else
+    {
+        gst_buffer_set_size(buffer, outputSize);
+    }
+    gst_buffer_fill(buffer, 0, aamphlssampleaesdecryptor->output, outputSize);
+}
+
+/**
+ * @brief Decrypts a SAMPLE-AES sample with the key of the current segments
+ * @param decryptor HLS SAMPLE-AES decryptor element pointer
+ * @param buffer sample, decrypted in place. The size of H.264 samples changes with the emulation
+ *        prevention the decrypted NAL units need
+ * @param info protection parameters made up for the sample
+ * @param errorCode outcome of the decryption
+ * @param encryptedBytes number of encrypted bytes in the sample
+ * @retval TRUE, the sample is always handled in element
+ */
+static gboolean gst_aamphlssampleaesdecryptor_local_decrypt(GstAampCDMIDecryptor* decryptor, GstBuffer* buffer,
+        const AampCDMISampleInfo* info, int* errorCode, gsize* encryptedBytes)
+{
+    GstAamphlssampleaesdecryptor* aamphlssampleaesdecryptor = GST_AAMPHLSSAMPLEAESDECRYPTOR(decryptor);
+    guint rangeCount = 0;
+    gboolean valid = TRUE;
+    GstMapInfo map;
+
+    *errorCode = -1;
+    *encryptedBytes = 0;
+    if (aamphlssampleaesdecryptor->format == GST_AAMP_SAMPLE_AES_H264)
+    {
+        gst_aamphlssampleaesdecryptor_h264_local_decrypt(aamphlssampleaesdecryptor, buffer, info,
+                errorCode, encryptedBytes);
+        return TRUE;
+    }
+    if (!gst_buffer_map(buffer, &map, static_cast<GstMapFlags>(GST_MAP_READWRITE)))
+    {
+        return TRUE;
+    }
+
+    switch (aamphlssampleaesdecryptor->format)
+    {
+    case GST_AAMP_SAMPLE_AES_ADTS:
+        valid = gst_aamphlssampleaesdecryptor_adts_ranges(aamphlssampleaesdecryptor, map.data, map.size, &rangeCount);
+        break;
+    case GST_AAMP_SAMPLE_AES_AC3:
+        valid = gst_aamphlssampleaesdecryptor_ac3_ranges(aamphlssampleaesdecryptor, map.data, map.size, &rangeCount);
+        break;
+    default:
+        valid = FALSE;
+        break;
+    }
+
+    if (!valid)
+    {
+        GST_WARNING_OBJECT(aamphlssampleaesdecryptor, "malformed sample of %" G_GSIZE_FORMAT " bytes, format %d",
+                map.size, aamphlssampleaesdecryptor->format);
+    }
+    else if (!rangeCount)
+    {
+        // nothing large enough to be encrypted
+        *errorCode = 0;
+    }
+    else
+    {
+        // SAMPLE-AES restarts the CBC chain with each frame, as cbcs does with each subsample
+        *errorCode = gst_aamp_clearkey_engine_decrypt(aamphlssampleaesdecryptor->engine, sampleAesKid,
+                sizeof(sampleAesKid), GST_AAMP_CIPHER_CBCS, info->iv, info->ivLength, map.data, map.size,
+                aamphlssampleaesdecryptor->ranges, rangeCount, 0, 0);
+        for (guint i = 0; i < rangeCount; i++)
+        {
+            *encryptedBytes += aamphlssampleaesdecryptor->ranges[i].encryptedBytes / SAMPLE_AES_BLOCK_SIZE * SAMPLE_AES_BLOCK_SIZE;
+        }
+    }
+    gst_buffer_unmap(buffer, &map);
+    return TRUE;
+}
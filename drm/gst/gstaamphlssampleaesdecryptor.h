@@ -0,0 +1,125 @@
+/*
+* Copyright 2018 RDK Management
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Library General Public
+* License as published by the Free Software Foundation, version 2
+* of the license.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Library General Public License for more details.
+*
+* You should have received a copy of the GNU Library General Public
+* License along with this library; if not, write to the
+* Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file gstaamphlssampleaesdecryptor.h
+ * @brief aamp HLS SAMPLE-AES decryptor plugin declarations
+ *
+ * Decrypts SAMPLE-AES protected elementary streams as output by tsdemux: H.264 byte-stream
+ * video and ADTS AAC, AC-3 and E-AC-3 audio, on the streaming thread of each stream. It is
+ * linked after tsdemux in place of decrypting segments before they are handed to the
+ * pipeline. Its pads have clear caps, so it has no rank and is never autoplugged, it must be
+ * created by name. Buffers must hold whole NAL units and audio frames.
+ *
+ * The key and IV of the following segments are given with a serialized custom downstream
+ * event sent ahead of the segment data, tsdemux forwards it to all of its streams:
+ * a GST_AAMP_HLS_SAMPLE_AES_EVENT structure with GST_AAMP_HLS_SAMPLE_AES_KEY_FIELD and
+ * GST_AAMP_HLS_SAMPLE_AES_IV_FIELD GstBuffer fields of 16 bytes each. An event without key
+ * marks the following segments as clear.
+ *
+ * tsdemux outputs the last access units of a segment after the event for the next one, so
+ * the event also tags the segment it belongs to: GST_AAMP_HLS_SAMPLE_AES_POSITION_FIELD, a
+ * GstClockTime with the stream time of the first sample of the segment. Keys are queued
+ * and take over from the first sample at or after their position. An event without
+ * position applies at once.
+ */
+
+#ifndef _GST_AAMPHLSSAMPLEAESDECRYPTOR_H_
+#define _GST_AAMPHLSSAMPLEAESDECRYPTOR_H_
+
+#include <gst/gst.h>
+#include <gst/base/gstbasetransform.h>
+#include "AampDRMSessionManager.h"
+#include "priv_aamp.h"
+
+#include "gstaampcdmidecryptor.h"  // For base gobject
+#include "gstaampclearkeyengine.h"
+
+// Declared static here because this string exists in libaamp.so
+// and libgstaampplugin.so  This string needs to match the start
+// of the gsteamer plugin name as created by the macros.
+static const char* GstPluginNameHLS = "aamphlssampleaesdecryptor";
+
+G_BEGIN_DECLS
+
+#define GST_AAMP_HLS_SAMPLE_AES_EVENT       "aamp-hls-sample-aes"
+#define GST_AAMP_HLS_SAMPLE_AES_KEY_FIELD   "key"
+#define GST_AAMP_HLS_SAMPLE_AES_IV_FIELD    "iv"
+#define GST_AAMP_HLS_SAMPLE_AES_POSITION_FIELD  "position"
+
+#define GST_TYPE_AAMPHLSSAMPLEAESDECRYPTOR             (gst_aamphlssampleaesdecryptor_get_type())
+#define GST_AAMPHLSSAMPLEAESDECRYPTOR(obj)             (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_AAMPHLSSAMPLEAESDECRYPTOR, GstAamphlssampleaesdecryptor))
+#define GST_AAMPHLSSAMPLEAESDECRYPTOR_CLASS(klass)     (G_TYPE_CHECK_CLASS_CAST((klass), GST_TYPE_AAMPHLSSAMPLEAESDECRYPTOR, GstAamphlssampleaesdecryptorClass))
+#define GST_IS_AAMPHLSSAMPLEAESDECRYPTOR(obj)          (G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_AAMPHLSSAMPLEAESDECRYPTOR))
+#define GST_IS_AAMPHLSSAMPLEAESDECRYPTOR_CLASS(obj)    (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_AAMPHLSSAMPLEAESDECRYPTOR))
+
+typedef struct _GstAamphlssampleaesdecryptor GstAamphlssampleaesdecryptor;
+typedef struct _GstAamphlssampleaesdecryptorClass GstAamphlssampleaesdecryptorClass;
+
+/**
+ * @enum GstAampSampleAesFormat
+ * @brief Elementary stream formats with a SAMPLE-AES encryption layout
+ */
+enum GstAampSampleAesFormat
+{
+    GST_AAMP_SAMPLE_AES_UNKNOWN,
+    GST_AAMP_SAMPLE_AES_H264,       // NAL units of type 1 and 5, 1:9 block pattern after a 32 byte leader
+    GST_AAMP_SAMPLE_AES_ADTS,       // AAC frames, whole blocks after the header and a 16 byte leader
+    GST_AAMP_SAMPLE_AES_AC3         // AC-3 and E-AC-3 syncframes, whole blocks after a 16 byte leader
+};
+
+/**
+ * @struct _GstAamphlssampleaesdecryptor
+ * @brief GstElement structure override for HLS SAMPLE-AES decryptor
+ */
+struct _GstAamphlssampleaesdecryptor
+{
+    GstAampCDMIDecryptor                parent;
+    GstAampClearKeyEngine*              engine;     // holds the key of the current segments
+    guint8                              iv[GST_AAMP_CLEARKEY_KEY_SIZE];     // IV of the current segments, streaming thread only
+    GQueue                              keys;       // keys of the following segments by position, streaming thread only
+    GstAampSampleAesFormat              format;     // from the sink caps
+    AampDecryptRange*                   ranges;     // grow-only range list, one range per encrypted audio frame
+    guint                               rangesSize;
+    guint8*                             nal;        // grow-only, the NAL unit being decrypted without emulation prevention
+    gsize                               nalSize;
+    guint8*                             output;     // grow-only, the decrypted H.264 access unit
+    gsize                               outputSize;
+};
+
+/**
+ * @struct _GstAamphlssampleaesdecryptorClass
+ * @brief GstElementClass structure override for HLS SAMPLE-AES decryptor
+ */
+struct _GstAamphlssampleaesdecryptorClass
+{
+    GstAampCDMIDecryptorClass parentClass;
+};
+
+
+/**
+ * @brief Get type of HLS SAMPLE-AES decryptor
+ * @retval Type of HLS SAMPLE-AES decryptor
+ */
+GType gst_aamphlssampleaesdecryptor_get_type (void);
+
+G_END_DECLS
+
+
+#endif /* _GST_AAMPHLSSAMPLEAESDECRYPTOR_H_ */
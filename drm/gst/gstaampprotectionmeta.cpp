@@ -0,0 +1,147 @@
+/*
+* Copyright 2018 RDK Management
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Library General Public
+* License as published by the Free Software Foundation, version 2
+* of the license.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Library General Public License for more details.
+*
+* You should have received a copy of the GNU Library General Public
+* License along with this library; if not, write to the
+* Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file gstaampprotectionmeta.cpp
+ * @brief Binary per sample protection metadata
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+#include "gstaampprotectionmeta.h"
+
+static gboolean gst_aamp_protection_meta_init(GstMeta* meta, gpointer params, GstBuffer* buffer)
+{
+    GstAampProtectionMeta* protectionMeta = (GstAampProtectionMeta*) meta;
+
+    protectionMeta->encrypted = FALSE;
+    protectionMeta->ivSize = 0;
+    protectionMeta->kidSize = 0;
+    protectionMeta->pattern = FALSE;
+    protectionMeta->cryptBlocks = 0;
+    protectionMeta->skipBlocks = 0;
+    protectionMeta->subsampleCount = 0;
+    protectionMeta->subsamples = NULL;
+    return TRUE;
+}
+
+static void gst_aamp_protection_meta_free(GstMeta* meta, GstBuffer* buffer)
+{
+    GstAampProtectionMeta* protectionMeta = (GstAampProtectionMeta*) meta;
+
+    if (protectionMeta->subsamples)
+    {
+        g_bytes_unref(protectionMeta->subsamples);
+    }
+}
+
+/*
+ Copies the meta along with the buffer. The parameters apply to the whole sample,
+ partial copies lose them.
+ */
+static gboolean gst_aamp_protection_meta_transform(GstBuffer* transbuf, GstMeta* meta, GstBuffer* buffer,
+        GQuark type, gpointer data)
+{
+    GstAampProtectionMeta* protectionMeta = (GstAampProtectionMeta*) meta;
+
+    if (GST_META_TRANSFORM_IS_COPY(type))
+    {
+        GstMetaTransformCopy* copy = (GstMetaTransformCopy*) data;
+        if (!copy->region)
+        {
+            GstAampProtectionMeta* newMeta = (GstAampProtectionMeta*) gst_buffer_add_meta(transbuf,
+                    GST_AAMP_PROTECTION_META_INFO, NULL);
+            if (!newMeta)
+            {
+                return FALSE;
+            }
+            newMeta->encrypted = protectionMeta->encrypted;
+            newMeta->ivSize = protectionMeta->ivSize;
+            memcpy(newMeta->iv, protectionMeta->iv, sizeof(newMeta->iv));
+            newMeta->kidSize = protectionMeta->kidSize;
+            memcpy(newMeta->kid, protectionMeta->kid, sizeof(newMeta->kid));
+            newMeta->pattern = protectionMeta->pattern;
+            newMeta->cryptBlocks = protectionMeta->cryptBlocks;
+            newMeta->skipBlocks = protectionMeta->skipBlocks;
+            newMeta->subsampleCount = protectionMeta->subsampleCount;
+            newMeta->subsamples = protectionMeta->subsamples ? g_bytes_ref(protectionMeta->subsamples) : NULL;
+        }
+        return TRUE;
+    }
+    return FALSE;
+}
+
+GType gst_aamp_protection_meta_api_get_type(void)
+{
+    static gsize type = 0;
+    static const gchar* tags[] = { NULL };
+
+    if (g_once_init_enter(&type))
+    {
+        GType newType = gst_meta_api_type_register("GstAampProtectionMetaAPI", tags);
+        g_once_init_leave(&type, newType);
+    }
+    return type;
+}
+
+const GstMetaInfo* gst_aamp_protection_meta_get_info(void)
+{
+    static const GstMetaInfo* info = NULL;
+
+    if (g_once_init_enter(&info))
+    {
+        const GstMetaInfo* newInfo = gst_meta_register(GST_AAMP_PROTECTION_META_API_TYPE,
+                "GstAampProtectionMeta", sizeof(GstAampProtectionMeta),
+                gst_aamp_protection_meta_init, gst_aamp_protection_meta_free,
+                gst_aamp_protection_meta_transform);
+        g_once_init_leave(&info, newInfo);
+    }
+    return info;
+}
+
+GstAampProtectionMeta* gst_buffer_add_aamp_protection_meta(GstBuffer* buffer, const guint8* iv, gsize ivSize,
+        const guint8* kid, guint subsampleCount, GBytes* subsamples)
+{
+    g_return_val_if_fail(GST_IS_BUFFER(buffer), NULL);
+    g_return_val_if_fail(ivSize <= GST_AAMP_PROTECTION_META_MAX_IV_SIZE, NULL);
+    g_return_val_if_fail(!subsampleCount || (subsamples && g_bytes_get_size(subsamples) >= subsampleCount * 6), NULL);
+
+    GstAampProtectionMeta* protectionMeta = (GstAampProtectionMeta*) gst_buffer_add_meta(buffer,
+            GST_AAMP_PROTECTION_META_INFO, NULL);
+    if (protectionMeta)
+    {
+        protectionMeta->encrypted = (iv && ivSize);
+        protectionMeta->ivSize = protectionMeta->encrypted ? (guint8) ivSize : 0;
+        if (protectionMeta->ivSize)
+        {
+            memcpy(protectionMeta->iv, iv, ivSize);
+        }
+        if (kid)
+        {
+            protectionMeta->kidSize = GST_AAMP_PROTECTION_META_KID_SIZE;
+            memcpy(protectionMeta->kid, kid, GST_AAMP_PROTECTION_META_KID_SIZE);
+        }
+        protectionMeta->subsampleCount = subsampleCount;
+        protectionMeta->subsamples = subsamples ? g_bytes_ref(subsamples) : NULL;
+    }
+    return protectionMeta;
+}
@@ -0,0 +1,94 @@
+/*
+* Copyright 2018 RDK Management
+*
+* This library is free software; you can redistribute it and/or
+* modify it under the terms of the GNU Library General Public
+* License as published by the Free Software Foundation, version 2
+* of the license.
+*
+* This library is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+* Library General Public License for more details.
+*
+* You should have received a copy of the GNU Library General Public
+* License along with this library; if not, write to the
+* Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+* Boston, MA 02110-1301, USA.
+*/
+
+/**
+ * @file gstaampprotectionmeta.h
+ * @brief Binary per sample protection metadata
+ *
+ * Compact alternative to GstProtectionMeta for upstream elements that know the sample
+ * encryption parameters. The decryptor reads it without structure field lookups and
+ * prefers it when a buffer carries both. Not supported with the OpenCDM adapter, which
+ * reads GstProtectionMeta itself.
+ */
+
+#ifndef _GST_AAMP_PROTECTION_META_H_
+#define _GST_AAMP_PROTECTION_META_H_
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+#define GST_AAMP_PROTECTION_META_MAX_IV_SIZE 16
+#define GST_AAMP_PROTECTION_META_KID_SIZE 16
+
+#define GST_AAMP_PROTECTION_META_API_TYPE (gst_aamp_protection_meta_api_get_type())
+#define GST_AAMP_PROTECTION_META_INFO (gst_aamp_protection_meta_get_info())
+
+#define gst_buffer_get_aamp_protection_meta(b) \
+        ((GstAampProtectionMeta*) gst_buffer_get_meta((b), GST_AAMP_PROTECTION_META_API_TYPE))
+
+typedef struct _GstAampProtectionMeta GstAampProtectionMeta;
+
+/**
+ * @struct _GstAampProtectionMeta
+ * @brief Encryption parameters of one sample
+ */
+struct _GstAampProtectionMeta
+{
+    GstMeta     meta;
+    gboolean    encrypted;                                  // FALSE for clear samples
+    guint8      ivSize;                                     // 8 or 16, 0 for clear samples
+    guint8      iv[GST_AAMP_PROTECTION_META_MAX_IV_SIZE];   // per sample IV, or the constant IV of cbcs streams
+    guint8      kidSize;                                    // 0 if unknown, else GST_AAMP_PROTECTION_META_KID_SIZE
+    guint8      kid[GST_AAMP_PROTECTION_META_KID_SIZE];
+    gboolean    pattern;                                    // cbcs crypt/skip pattern encryption
+    guint8      cryptBlocks;
+    guint8      skipBlocks;
+    guint       subsampleCount;
+    GBytes*     subsamples;                                 // CENC subsample table: big endian uint16 clear, uint32 encrypted bytes
+};
+
+/**
+ * @brief Get API type of the binary protection meta
+ * @retval meta API type
+ */
+GType gst_aamp_protection_meta_api_get_type(void);
+
+/**
+ * @brief Get info of the binary protection meta
+ * @retval meta info
+ */
+const GstMetaInfo* gst_aamp_protection_meta_get_info(void);
+
+/**
+ * @brief Attaches binary protection metadata to a sample
+ * @param[in] buffer sample
+ * @param[in] iv sample IV, NULL for clear samples
+ * @param[in] ivSize size of iv, at most GST_AAMP_PROTECTION_META_MAX_IV_SIZE
+ * @param[in] kid key id, may be NULL
+ * @param[in] subsampleCount number of subsamples, 0 if the whole sample is encrypted
+ * @param[in] subsamples subsample table, referenced by the meta
+ * @retval attached meta, cbcs fields to be set by the caller; NULL on invalid arguments
+ */
+GstAampProtectionMeta* gst_buffer_add_aamp_protection_meta(GstBuffer* buffer, const guint8* iv, gsize ivSize,
+        const guint8* kid, guint subsampleCount, GBytes* subsamples);
+
+G_END_DECLS
+
+#endif /* _GST_AAMP_PROTECTION_META_H_ */
@@ -28,6 +28,7 @@
 #endif
 
 #include <gst/gst.h>
+#include <gst/base/gstbytereader.h>
 #include <string.h>
 #include <stdio.h>
 #include "gstaamp.h"
@@ -62,14 +63,53 @@ GST_DEBUG_CATEGORY_STATIC (gst_aamp_debug_category);
  */
 #define MAX_NUM_BUFFERS_IN_QUEUE 100
 
+/* Src pad tasks of all aamp instances can optionally be serviced by one shared
+ * set of push threads instead of one GstTask thread per pad, see
+ * GST_AAMP_SRC_POOL_THREADS. Each ready pad gets at most
+ * GST_AAMP_SRC_POOL_QUANTUM items pushed per turn before the next ready pad is
+ * serviced, so a pad with a deep queue can't starve the others. When a pad is
+ * ready while every worker is busy, e.g. blocked in a push on a prerolling sink,
+ * a worker is added, up to one per pad on the pool. Added workers leave after
+ * being idle for SRC_POOL_IDLE_TIMEOUT.
+ */
+#define DEFAULT_SRC_POOL_QUANTUM 4
+#define SRC_POOL_IDLE_TIMEOUT (2 * G_TIME_SPAN_SECOND)
+
 #define  GST_AAMP_LOG_TIMING(msg...) GST_FIXME_OBJECT(aamp, msg)
 #define  STREAM_COUNT (sizeof(aamp->stream)/sizeof(aamp->stream[0]))
 
 static const gchar *g_aamp_expose_hls_caps = NULL;
+static guint g_aamp_src_pool_threads = 0;
+static guint g_aamp_src_pool_quantum = DEFAULT_SRC_POOL_QUANTUM;
+
+/**
+ * @struct GstAampSrcPool
+ * @brief Process wide pool of threads pushing queued items of ready src pads
+ */
+struct GstAampSrcPool
+{
+	GList *threads;		/* running workers */
+	GList *exited;		/* added workers that left, to be joined */
+	guint numThreads;	/* workers kept while idle */
+	guint idle;		/* workers waiting for a ready stream */
+	guint active;		/* streams serviced by the pool */
+	guint refCount;		/* aamp instances using the pool */
+	gboolean quit;
+	guint quantum;
+	GQueue ready;
+	GMutex mutex;
+	GCond workAvailable;
+	GCond serviceDone;
+};
+
+static GMutex g_aamp_src_pool_lock;
+static GstAampSrcPool *g_aamp_src_pool = NULL;
 
 static GstStateChangeReturn
 gst_aamp_change_state(GstElement * element, GstStateChange transition);
 static void gst_aamp_finalize(GObject * object);
+static void gst_aamp_set_property(GObject * object, guint prop_id, const GValue * value, GParamSpec * pspec);
+static void gst_aamp_get_property(GObject * object, guint prop_id, GValue * value, GParamSpec * pspec);
 static gboolean gst_aamp_query(GstElement * element, GstQuery * query);
 
 static GstFlowReturn gst_aamp_sink_chain(GstPad * pad, GstObject *parent, GstBuffer * buffer);
@@ -80,6 +120,8 @@ static gboolean gst_aamp_src_query(GstPad * pad, GstObject *parent, GstQuery * q
 
 static void gst_aamp_configure(GstAamp * aamp, StreamOutputFormat format, StreamOutputFormat audioFormat);
 static gboolean gst_aamp_ready(GstAamp *aamp);
+static void gst_aamp_src_pool_schedule(media_stream* stream);
+static void gst_aamp_src_pool_defer(media_stream* stream, GstClock *clock, GstClockTime releaseTime);
 
 #ifdef AAMP_JSCONTROLLER_ENABLED
 extern "C"
@@ -95,7 +137,10 @@ extern "C"
  */
 enum GstAampProperties
 {
-	PROP_0
+	PROP_0,
+	PROP_SEAMLESS_DISCONTINUITY,
+	PROP_PACING_LEAD_MS,
+	PROP_GAP_THRESHOLD_MS
 };
 
 gboolean gst_aamp_push(media_stream* stream, GstMiniObject *obj, gboolean *eosEvent = NULL)
@@ -115,9 +160,13 @@ gboolean gst_aamp_push(media_stream* stream, GstMiniObject *obj, gboolean *eosEv
 		{
 			GST_WARNING_OBJECT(stream->parent, "gst_pad_push[%s] error: %s \n", GST_PAD_NAME(stream->srcpad),
 			        gst_flow_get_name(ret));
-			retVal = gst_pad_pause_task(stream->srcpad);
-			if (!retVal)
-				GST_WARNING_OBJECT(stream->parent, "gst_pad_push[%s] pausing error \n", GST_PAD_NAME(stream->srcpad));
+			/* on the src pool, the worker stops servicing the stream, there is no pad task */
+			if (!stream->parent->srcPool)
+			{
+				retVal = gst_pad_pause_task(stream->srcpad);
+				if (!retVal)
+					GST_WARNING_OBJECT(stream->parent, "gst_pad_push[%s] pausing error \n", GST_PAD_NAME(stream->srcpad));
+			}
 			stream->isPaused=TRUE;
 			retVal = FALSE;
 		}
@@ -134,6 +183,10 @@ gboolean gst_aamp_push(media_stream* stream, GstMiniObject *obj, gboolean *eosEv
 		}
 		GST_INFO_OBJECT(stream->parent, "%s: send %s event\n", __FUNCTION__,
 		        GST_EVENT_TYPE_NAME(event));
+		if (GST_EVENT_TYPE(event) == GST_EVENT_SEGMENT)
+		{
+			gst_event_copy_segment(event, &stream->outSegment);
+		}
 		if (!gst_pad_push_event(stream->srcpad, event))
 		{
 			GST_WARNING_OBJECT(stream->parent, "gst_pad_push_event[%s] error\n", GST_PAD_NAME(stream->srcpad));
@@ -189,6 +242,10 @@ void gst_aamp_stream_add_item(media_stream* stream, gpointer item)
 		}
 		g_cond_broadcast(&stream->cond);
 		g_mutex_unlock(&stream->mutex);
+		if (aamp->srcPool)
+		{
+			gst_aamp_src_pool_schedule(stream);
+		}
 	}
 	else
 	{
@@ -196,6 +253,107 @@ void gst_aamp_stream_add_item(media_stream* stream, gpointer item)
 	}
 }
 
+/**
+ * @brief Checks if an item can be added to stream without waiting for queue space
+ * @param[in] stream Media stream object pointer
+ * @retval TRUE if gst_aamp_stream_add_item will not block on a full queue
+ */
+static gboolean gst_aamp_stream_can_accept(media_stream* stream)
+{
+	gboolean ret = TRUE;
+	if (stream->parent->enable_src_tasks)
+	{
+		g_mutex_lock(&stream->mutex);
+		ret = (g_queue_get_length(stream->queue) <= MAX_NUM_BUFFERS_IN_QUEUE);
+		g_mutex_unlock(&stream->mutex);
+	}
+	return ret;
+}
+
+/**
+ * @brief Gets clock time at which a buffer may be pushed when pacing is enabled
+ * @param[in] stream Media stream object pointer
+ * @param[in] obj buffer/event to be pushed
+ * @param[out] clock pipeline clock to wait on, to be unreffed by caller if time is valid
+ * @retval clock time to wait for, GST_CLOCK_TIME_NONE if obj can be pushed now
+ */
+static GstClockTime gst_aamp_stream_release_time(media_stream* stream, GstMiniObject *obj, GstClock **clock)
+{
+	GstAamp *aamp = GST_AAMP(stream->parent);
+	GstClockTime lead = aamp->pacingLead;
+	GstClockTime releaseTime = GST_CLOCK_TIME_NONE;
+
+	if (!lead || !GST_IS_BUFFER(obj) || stream->outSegment.format != GST_FORMAT_TIME)
+	{
+		return GST_CLOCK_TIME_NONE;
+	}
+	guint64 runningTime = gst_segment_to_running_time(&stream->outSegment, GST_FORMAT_TIME, GST_BUFFER_PTS(GST_BUFFER(obj)));
+	if (!GST_CLOCK_TIME_IS_VALID(runningTime) || runningTime <= lead)
+	{
+		return GST_CLOCK_TIME_NONE;
+	}
+
+	GST_OBJECT_LOCK(aamp);
+	if (GST_STATE(aamp) == GST_STATE_PLAYING && GST_STATE_PENDING(aamp) == GST_STATE_VOID_PENDING
+		&& GST_ELEMENT_CLOCK(aamp))
+	{
+		*clock = GST_CLOCK(gst_object_ref(GST_ELEMENT_CLOCK(aamp)));
+		releaseTime = GST_ELEMENT_CAST(aamp)->base_time + runningTime - lead;
+	}
+	GST_OBJECT_UNLOCK(aamp);
+
+	if (GST_CLOCK_TIME_IS_VALID(releaseTime) && releaseTime <= gst_clock_get_time(*clock))
+	{
+		gst_object_unref(*clock);
+		*clock = NULL;
+		releaseTime = GST_CLOCK_TIME_NONE;
+	}
+	return releaseTime;
+}
+
+/**
+ * @brief Waits until a buffer is within the pacing lead of the pipeline running time
+ * @param[in] stream Media stream object pointer
+ * @param[in] clock pipeline clock
+ * @param[in] releaseTime clock time to wait for
+ * @note Wait is cut short on flush, on stop and when leaving PLAYING
+ */
+static void gst_aamp_stream_pace(media_stream* stream, GstClock *clock, GstClockTime releaseTime)
+{
+	GstAamp *aamp = GST_AAMP(stream->parent);
+	GstClockID id = gst_clock_new_single_shot_id(clock, releaseTime);
+	g_mutex_lock(&stream->mutex);
+	if (aamp->flushing || stream->stopping)
+	{
+		g_mutex_unlock(&stream->mutex);
+		gst_clock_id_unref(id);
+		return;
+	}
+	stream->paceClockId = id;
+	g_mutex_unlock(&stream->mutex);
+
+	GST_TRACE_OBJECT(aamp, "[%s] pacing until %" GST_TIME_FORMAT, GST_PAD_NAME(stream->srcpad), GST_TIME_ARGS(releaseTime));
+	gst_clock_id_wait(id, NULL);
+
+	g_mutex_lock(&stream->mutex);
+	stream->paceClockId = NULL;
+	g_mutex_unlock(&stream->mutex);
+	gst_clock_id_unref(id);
+}
+
+/**
+ * @brief Cuts short pacing wait of stream
+ * @param[in] stream Media stream object pointer
+ * @note stream mutex must be held
+ */
+static void gst_aamp_stream_unpace(media_stream* stream)
+{
+	if (stream->paceClockId)
+	{
+		gst_clock_id_unschedule(stream->paceClockId);
+	}
+}
+
 /**
  * @brief Dequeue buffer/event and push it to srcpad
  * @param[in] stream Media stream object pointer
@@ -208,15 +366,19 @@ void gst_aamp_stream_push_next_item(media_stream* stream)
 	while (!eosSent)
 	{
 		g_mutex_lock(&stream->mutex);
-		if (g_queue_is_empty(stream->queue) && !aamp->flushing)
+		if (g_queue_is_empty(stream->queue) && !aamp->flushing && !stream->stopping)
 		{
 			g_cond_wait(&stream->cond, &stream->mutex);
 		}
-		if (aamp->flushing)
+		if (aamp->flushing || stream->stopping)
 		{
 			GST_INFO_OBJECT(aamp, "Flushing");
+			gboolean stopping = stream->stopping;
 			g_mutex_unlock(&stream->mutex);
-			gst_pad_pause_task(stream->srcpad);
+			if (!stopping)
+			{
+				gst_pad_pause_task(stream->srcpad);
+			}
 			break;
 		}
 		gpointer item = g_queue_pop_head(stream->queue);
@@ -224,6 +386,21 @@ void gst_aamp_stream_push_next_item(media_stream* stream)
 		g_mutex_unlock(&stream->mutex);
 		if (item)
 		{
+			GstClock *clock = NULL;
+			GstClockTime releaseTime = gst_aamp_stream_release_time(stream, (GstMiniObject *)item, &clock);
+			if (GST_CLOCK_TIME_IS_VALID(releaseTime))
+			{
+				gst_aamp_stream_pace(stream, clock, releaseTime);
+				gst_object_unref(clock);
+				g_mutex_lock(&stream->mutex);
+				gboolean dropped = aamp->flushing || stream->stopping;
+				g_mutex_unlock(&stream->mutex);
+				if (dropped)
+				{
+					gst_mini_object_unref((GstMiniObject *)item);
+					break;
+				}
+			}
 			if (!gst_aamp_push(stream, (GstMiniObject *)item, &eosSent))
 			{
 				break;
@@ -237,6 +414,369 @@ void gst_aamp_stream_push_next_item(media_stream* stream)
 	}
 }
 
+/**
+ * @brief Push up to quantum queued items of a stream without waiting for more
+ * @param[in] stream Media stream object pointer
+ * @param[in] quantum maximum number of items to push
+ * @retval FALSE if pushing failed and the stream has to be paused
+ */
+static gboolean gst_aamp_stream_push_items(media_stream* stream, guint quantum)
+{
+	GST_TRACE_OBJECT(stream->parent, "Enter gst_aamp_stream_push_items");
+	GstAamp *aamp = GST_AAMP(stream->parent);
+	gboolean ret = TRUE;
+	GST_PAD_STREAM_LOCK(stream->srcpad);
+	for (guint i = 0; ret && i < quantum; i++)
+	{
+		gpointer item = NULL;
+		g_mutex_lock(&stream->mutex);
+		if (!aamp->flushing)
+		{
+			item = g_queue_pop_head(stream->queue);
+		}
+		g_cond_broadcast(&stream->cond);
+		g_mutex_unlock(&stream->mutex);
+		if (!item)
+		{
+			break;
+		}
+		GstClock *clock = NULL;
+		GstClockTime releaseTime = gst_aamp_stream_release_time(stream, (GstMiniObject *)item, &clock);
+		if (GST_CLOCK_TIME_IS_VALID(releaseTime))
+		{
+			/* don't hold a pool thread, put item back and come back when it is due */
+			g_mutex_lock(&stream->mutex);
+			if (aamp->flushing)
+			{
+				gst_mini_object_unref((GstMiniObject *)item);
+				item = NULL;
+			}
+			else
+			{
+				g_queue_push_head(stream->queue, item);
+			}
+			g_mutex_unlock(&stream->mutex);
+			if (item)
+			{
+				gst_aamp_src_pool_defer(stream, clock, releaseTime);
+			}
+			gst_object_unref(clock);
+			break;
+		}
+		ret = gst_aamp_push(stream, (GstMiniObject *)item);
+	}
+	GST_PAD_STREAM_UNLOCK(stream->srcpad);
+	return ret;
+}
+
+/**
+ * @brief Clock callback rescheduling a stream whose paced buffer is due
+ * @param[in] clock pipeline clock
+ * @param[in] time time of the clock entry
+ * @param[in] id clock entry
+ * @param[in] user_data media stream pointer
+ * @retval always TRUE
+ */
+static gboolean gst_aamp_src_pool_paced(GstClock *clock, GstClockTime time, GstClockID id, gpointer user_data)
+{
+	media_stream* stream = (media_stream *) user_data;
+	GstAampSrcPool *pool = stream->parent->srcPool;
+	g_mutex_lock(&pool->mutex);
+	stream->paceWaiting = FALSE;
+	g_mutex_unlock(&pool->mutex);
+
+	g_mutex_lock(&stream->mutex);
+	if (stream->paceClockId == id)
+	{
+		gst_clock_id_unref(stream->paceClockId);
+		stream->paceClockId = NULL;
+	}
+	g_mutex_unlock(&stream->mutex);
+
+	gst_aamp_src_pool_schedule(stream);
+	return TRUE;
+}
+
+/**
+ * @brief Releases element reference held by a pending pacing callback
+ * @param[in] data media stream pointer
+ */
+static void gst_aamp_src_pool_paced_done(gpointer data)
+{
+	media_stream* stream = (media_stream *) data;
+	gst_object_unref(stream->parent);
+}
+
+/**
+ * @brief Parks stream until its head buffer is within the pacing lead
+ * @param[in] stream Media stream object pointer
+ * @param[in] clock pipeline clock
+ * @param[in] releaseTime clock time to wait for
+ */
+static void gst_aamp_src_pool_defer(media_stream* stream, GstClock *clock, GstClockTime releaseTime)
+{
+	GstAampSrcPool *pool = stream->parent->srcPool;
+	GstClockID id = gst_clock_new_single_shot_id(clock, releaseTime);
+	g_mutex_lock(&pool->mutex);
+	stream->paceWaiting = TRUE;
+	g_mutex_unlock(&pool->mutex);
+
+	g_mutex_lock(&stream->mutex);
+	if (stream->paceClockId)
+	{
+		gst_clock_id_unref(stream->paceClockId);
+	}
+	stream->paceClockId = gst_clock_id_ref(id);
+	g_mutex_unlock(&stream->mutex);
+
+	gst_object_ref(stream->parent);
+	if (gst_clock_id_wait_async(id, gst_aamp_src_pool_paced, stream, gst_aamp_src_pool_paced_done) != GST_CLOCK_OK)
+	{
+		GST_WARNING_OBJECT(stream->parent, "[%s] pacing wait failed", GST_PAD_NAME(stream->srcpad));
+		gst_object_unref(stream->parent);
+		g_mutex_lock(&pool->mutex);
+		stream->paceWaiting = FALSE;
+		g_mutex_unlock(&pool->mutex);
+		gst_aamp_src_pool_schedule(stream);
+	}
+	gst_clock_id_unref(id);
+}
+
+/**
+ * @brief Worker thread of the shared src pool, services ready streams round robin
+ * @param[in] data GstAampSrcPool pointer
+ * @retval NULL when the pool is shut down or an added worker was idle too long
+ */
+static gpointer gst_aamp_src_pool_worker(gpointer data)
+{
+	GstAampSrcPool *pool = (GstAampSrcPool *) data;
+	g_mutex_lock(&pool->mutex);
+	while (!pool->quit)
+	{
+		media_stream* stream = (media_stream *) g_queue_pop_head(&pool->ready);
+		if (!stream)
+		{
+			pool->idle++;
+			if (g_list_length(pool->threads) > pool->numThreads)
+			{
+				gint64 endTime = g_get_monotonic_time() + SRC_POOL_IDLE_TIMEOUT;
+				if (!g_cond_wait_until(&pool->workAvailable, &pool->mutex, endTime)
+					&& g_queue_is_empty(&pool->ready) && g_list_length(pool->threads) > pool->numThreads)
+				{
+					pool->idle--;
+					pool->threads = g_list_remove(pool->threads, g_thread_self());
+					pool->exited = g_list_prepend(pool->exited, g_thread_self());
+					break;
+				}
+			}
+			else
+			{
+				g_cond_wait(&pool->workAvailable, &pool->mutex);
+			}
+			pool->idle--;
+			continue;
+		}
+		stream->servicing = TRUE;
+		g_mutex_unlock(&pool->mutex);
+
+		gboolean ok = gst_aamp_stream_push_items(stream, pool->quantum);
+
+		g_mutex_lock(&pool->mutex);
+		stream->servicing = FALSE;
+		if (!ok && stream->poolActive)
+		{
+			GST_WARNING_OBJECT(stream->parent, "[%s] push failed, pausing", GST_PAD_NAME(stream->srcpad));
+			stream->poolActive = FALSE;
+			pool->active--;
+		}
+		g_mutex_lock(&stream->mutex);
+		gboolean more = !g_queue_is_empty(stream->queue);
+		g_mutex_unlock(&stream->mutex);
+		if (more && stream->poolActive && !stream->paceWaiting)
+		{
+			/* back of the line, other ready pads get their turn first */
+			g_queue_push_tail(&pool->ready, stream);
+		}
+		else
+		{
+			stream->scheduled = FALSE;
+		}
+		g_cond_broadcast(&pool->serviceDone);
+	}
+	g_mutex_unlock(&pool->mutex);
+	return NULL;
+}
+
+/**
+ * @brief Adds a worker to the shared src pool
+ * @param[in] pool GstAampSrcPool pointer
+ * @note pool mutex must be held
+ */
+static void gst_aamp_src_pool_add_worker(GstAampSrcPool *pool)
+{
+	gchar *name = g_strdup_printf("aamp-srcpool-%u", g_list_length(pool->threads));
+	pool->threads = g_list_prepend(pool->threads, g_thread_new(name, gst_aamp_src_pool_worker, pool));
+	g_free(name);
+}
+
+/**
+ * @brief Takes a reference to the shared src pool, creating it on first use
+ * @retval GstAampSrcPool pointer
+ */
+static GstAampSrcPool *gst_aamp_src_pool_ref(void)
+{
+	g_mutex_lock(&g_aamp_src_pool_lock);
+	GstAampSrcPool *pool = g_aamp_src_pool;
+	if (!pool)
+	{
+		pool = g_new0(GstAampSrcPool, 1);
+		g_queue_init(&pool->ready);
+		g_mutex_init(&pool->mutex);
+		g_cond_init(&pool->workAvailable);
+		g_cond_init(&pool->serviceDone);
+		pool->quantum = g_aamp_src_pool_quantum;
+		pool->numThreads = g_aamp_src_pool_threads;
+		g_mutex_lock(&pool->mutex);
+		for (guint i = 0; i < pool->numThreads; i++)
+		{
+			gst_aamp_src_pool_add_worker(pool);
+		}
+		g_mutex_unlock(&pool->mutex);
+		GST_INFO("Created src pool with %u threads, quantum %u", pool->numThreads, pool->quantum);
+		g_aamp_src_pool = pool;
+	}
+	pool->refCount++;
+	g_mutex_unlock(&g_aamp_src_pool_lock);
+	return pool;
+}
+
+/**
+ * @brief Drops a reference to the shared src pool, joining its workers and freeing it with the last one
+ * @param[in] pool GstAampSrcPool pointer
+ * @note streams of the caller must be stopped
+ */
+static void gst_aamp_src_pool_unref(GstAampSrcPool *pool)
+{
+	g_mutex_lock(&g_aamp_src_pool_lock);
+	if (--pool->refCount)
+	{
+		g_mutex_unlock(&g_aamp_src_pool_lock);
+		return;
+	}
+	g_aamp_src_pool = NULL;
+	g_mutex_unlock(&g_aamp_src_pool_lock);
+
+	g_mutex_lock(&pool->mutex);
+	pool->quit = TRUE;
+	g_cond_broadcast(&pool->workAvailable);
+	GList *threads = g_list_concat(pool->threads, pool->exited);
+	pool->threads = NULL;
+	pool->exited = NULL;
+	g_mutex_unlock(&pool->mutex);
+
+	g_list_free_full(threads, (GDestroyNotify) g_thread_join);
+	g_queue_clear(&pool->ready);
+	g_mutex_clear(&pool->mutex);
+	g_cond_clear(&pool->workAvailable);
+	g_cond_clear(&pool->serviceDone);
+	GST_INFO("Freed src pool");
+	g_free(pool);
+}
+
+/**
+ * @brief Queues stream for servicing by the shared src pool if it has pending items
+ * @param[in] stream Media stream object pointer
+ */
+static void gst_aamp_src_pool_schedule(media_stream* stream)
+{
+	GstAampSrcPool *pool = stream->parent->srcPool;
+	g_mutex_lock(&pool->mutex);
+	if (stream->poolActive && !stream->scheduled && !stream->paceWaiting)
+	{
+		g_mutex_lock(&stream->mutex);
+		gboolean pending = !g_queue_is_empty(stream->queue);
+		g_mutex_unlock(&stream->mutex);
+		if (pending)
+		{
+			stream->scheduled = TRUE;
+			g_queue_push_tail(&pool->ready, stream);
+			g_cond_signal(&pool->workAvailable);
+			/* every worker is busy and may be blocked in a push, don't make this pad wait for them */
+			if (g_queue_get_length(&pool->ready) > pool->idle && g_list_length(pool->threads) < pool->active)
+			{
+				gst_aamp_src_pool_add_worker(pool);
+			}
+		}
+	}
+	GList *exited = pool->exited;
+	pool->exited = NULL;
+	g_mutex_unlock(&pool->mutex);
+	g_list_free_full(exited, (GDestroyNotify) g_thread_join);
+}
+
+/**
+ * @brief Stops servicing of stream by the shared src pool, waits if it is being serviced
+ * @param[in] stream Media stream object pointer
+ */
+static void gst_aamp_src_pool_stop(media_stream* stream)
+{
+	GstAampSrcPool *pool = stream->parent->srcPool;
+	g_mutex_lock(&pool->mutex);
+	if (stream->poolActive)
+	{
+		stream->poolActive = FALSE;
+		pool->active--;
+	}
+	stream->paceWaiting = FALSE;
+	g_queue_remove(&pool->ready, stream);
+	while (stream->servicing)
+	{
+		g_cond_wait(&pool->serviceDone, &pool->mutex);
+	}
+	stream->scheduled = FALSE;
+	g_mutex_unlock(&pool->mutex);
+
+	g_mutex_lock(&stream->mutex);
+	if (stream->paceClockId)
+	{
+		gst_clock_id_unschedule(stream->paceClockId);
+		gst_clock_id_unref(stream->paceClockId);
+		stream->paceClockId = NULL;
+	}
+	g_mutex_unlock(&stream->mutex);
+}
+
+/**
+ * @brief Releases buffers held back by pacing, used when leaving PLAYING
+ * @param[in] aamp Gstreamer aamp object pointer
+ */
+static void gst_aamp_stream_unpace_all(GstAamp *aamp)
+{
+	for (int i = 0; i < STREAM_COUNT; i++)
+	{
+		media_stream* stream = &aamp->stream[i];
+		if (!stream->srcpad)
+		{
+			continue;
+		}
+		g_mutex_lock(&stream->mutex);
+		gst_aamp_stream_unpace(stream);
+		if (aamp->srcPool && stream->paceClockId)
+		{
+			gst_clock_id_unref(stream->paceClockId);
+			stream->paceClockId = NULL;
+		}
+		g_mutex_unlock(&stream->mutex);
+		if (aamp->srcPool)
+		{
+			g_mutex_lock(&aamp->srcPool->mutex);
+			stream->paceWaiting = FALSE;
+			g_mutex_unlock(&aamp->srcPool->mutex);
+			gst_aamp_src_pool_schedule(stream);
+		}
+	}
+}
+
 /**
  * @brief Start src pad task of stream
  * @param[in] stream Media stream object pointer
@@ -246,9 +786,51 @@ void gst_aamp_stream_start(media_stream* stream)
 	GST_DEBUG_OBJECT(stream->parent, "Enter gst_aamp_stream_start");
 	if(stream->srcpad)
 	{
-		GST_INFO_OBJECT(stream->parent, "start %s pad task", GST_PAD_NAME(stream->srcpad));
-		gst_pad_start_task (stream->srcpad, (GstTaskFunction) gst_aamp_stream_push_next_item,
-				stream, NULL);
+		GstAampSrcPool *pool = stream->parent->srcPool;
+		if (pool)
+		{
+			GST_INFO_OBJECT(stream->parent, "start %s pad on src pool", GST_PAD_NAME(stream->srcpad));
+			g_mutex_lock(&pool->mutex);
+			if (!stream->poolActive)
+			{
+				stream->poolActive = TRUE;
+				pool->active++;
+			}
+			g_mutex_unlock(&pool->mutex);
+			gst_aamp_src_pool_schedule(stream);
+		}
+		else
+		{
+			GST_INFO_OBJECT(stream->parent, "start %s pad task", GST_PAD_NAME(stream->srcpad));
+			gst_pad_start_task (stream->srcpad, (GstTaskFunction) gst_aamp_stream_push_next_item,
+					stream, NULL);
+		}
+	}
+}
+
+/**
+ * @brief Stop src pad task of stream
+ * @param[in] stream Media stream object pointer
+ */
+void gst_aamp_stream_stop(media_stream* stream)
+{
+	GST_DEBUG_OBJECT(stream->parent, "Enter gst_aamp_stream_stop");
+	if (stream->parent->srcPool)
+	{
+		gst_aamp_src_pool_stop(stream);
+	}
+	else
+	{
+		/* wake the task if it waits for items, it can't be joined otherwise */
+		g_mutex_lock(&stream->mutex);
+		stream->stopping = TRUE;
+		gst_aamp_stream_unpace(stream);
+		g_cond_broadcast(&stream->cond);
+		g_mutex_unlock(&stream->mutex);
+		gst_pad_stop_task(stream->srcpad);
+		g_mutex_lock(&stream->mutex);
+		stream->stopping = FALSE;
+		g_mutex_unlock(&stream->mutex);
 	}
 }
 
@@ -267,6 +849,7 @@ void gst_aamp_stream_flush(GstAamp *aamp)
 			if (aamp->enable_src_tasks)
 			{
 				g_mutex_lock(&stream->mutex);
+				gst_aamp_stream_unpace(stream);
 				while (FALSE == g_queue_is_empty(stream->queue))
 				{
 					GstMiniObject *obj = (GstMiniObject *) g_queue_pop_head(stream->queue);
@@ -308,7 +891,7 @@ void gst_aamp_stop_and_flush(GstAamp *aamp)
 			gst_pad_push_event(stream->srcpad, gst_event_new_flush_start());
 			if (aamp->enable_src_tasks)
 			{
-				gst_pad_stop_task(stream->srcpad);
+				gst_aamp_stream_stop(stream);
 			}
 			GST_INFO_OBJECT(aamp, "[%s]sending flush stop", GST_PAD_NAME(stream->srcpad));
 			gst_pad_push_event(stream->srcpad, gst_event_new_flush_stop(TRUE));
@@ -317,6 +900,120 @@ void gst_aamp_stop_and_flush(GstAamp *aamp)
 	aamp->flushing = FALSE;
 }
 
+/**
+ * @brief Finds a box among sibling boxes of ISO BMFF data
+ * @param[in] data start of the first sibling box
+ * @param[in] size size of all sibling boxes
+ * @param[in] fourcc type of the box to find
+ * @param[out] payload start of the box payload
+ * @param[out] payloadSize size of the box payload
+ * @retval TRUE if the box is found
+ */
+static gboolean gst_aamp_find_box(const guint8 *data, gsize size, guint32 fourcc, const guint8 **payload, gsize *payloadSize)
+{
+	GstByteReader reader;
+	gst_byte_reader_init(&reader, data, size);
+	while (gst_byte_reader_get_remaining(&reader) >= 8)
+	{
+		guint start = gst_byte_reader_get_pos(&reader);
+		guint32 size32 = 0;
+		guint32 type = 0;
+		guint64 boxSize;
+		gst_byte_reader_get_uint32_be(&reader, &size32);
+		gst_byte_reader_get_uint32_le(&reader, &type);
+		boxSize = size32;
+		if (size32 == 1)
+		{
+			if (!gst_byte_reader_get_uint64_be(&reader, &boxSize))
+			{
+				break;
+			}
+		}
+		else if (size32 == 0)
+		{
+			boxSize = size - start;
+		}
+		guint headerSize = gst_byte_reader_get_pos(&reader) - start;
+		if (boxSize < headerSize || boxSize > size - start)
+		{
+			break;
+		}
+		if (type == fourcc)
+		{
+			*payload = data + start + headerSize;
+			*payloadSize = boxSize - headerSize;
+			return TRUE;
+		}
+		gst_byte_reader_set_pos(&reader, start + boxSize);
+	}
+	return FALSE;
+}
+
+/**
+ * @brief Gets media timescale from the moov box of an init fragment
+ * @param[in] data init fragment or moov box
+ * @param[in] size size of data
+ * @retval timescale of the first track, 0 if not found
+ */
+static guint32 gst_aamp_parse_timescale(const guint8 *data, gsize size)
+{
+	const guint8 *moov, *trak, *mdia, *mdhd;
+	gsize moovSize, trakSize, mdiaSize, mdhdSize;
+	guint32 timescale = 0;
+	if (gst_aamp_find_box(data, size, GST_MAKE_FOURCC('m','o','o','v'), &moov, &moovSize)
+		&& gst_aamp_find_box(moov, moovSize, GST_MAKE_FOURCC('t','r','a','k'), &trak, &trakSize)
+		&& gst_aamp_find_box(trak, trakSize, GST_MAKE_FOURCC('m','d','i','a'), &mdia, &mdiaSize)
+		&& gst_aamp_find_box(mdia, mdiaSize, GST_MAKE_FOURCC('m','d','h','d'), &mdhd, &mdhdSize))
+	{
+		GstByteReader reader;
+		guint8 version = 0;
+		gst_byte_reader_init(&reader, mdhd, mdhdSize);
+		/* version, flags, creation and modification time */
+		if (gst_byte_reader_get_uint8(&reader, &version)
+			&& gst_byte_reader_skip(&reader, 3 + ((version == 1) ? 16 : 8)))
+		{
+			gst_byte_reader_get_uint32_be(&reader, &timescale);
+		}
+	}
+	return timescale;
+}
+
+/**
+ * @brief Gets base media decode time from the tfdt box of a moof box
+ * @param[in] data moof box
+ * @param[in] size size of data
+ * @param[out] decodeTime base media decode time in media timescale
+ * @retval TRUE if tfdt is found
+ */
+static gboolean gst_aamp_parse_decode_time(const guint8 *data, gsize size, guint64 *decodeTime)
+{
+	const guint8 *moof, *traf, *tfdt;
+	gsize moofSize, trafSize, tfdtSize;
+	gboolean ret = FALSE;
+	if (gst_aamp_find_box(data, size, GST_MAKE_FOURCC('m','o','o','f'), &moof, &moofSize)
+		&& gst_aamp_find_box(moof, moofSize, GST_MAKE_FOURCC('t','r','a','f'), &traf, &trafSize)
+		&& gst_aamp_find_box(traf, trafSize, GST_MAKE_FOURCC('t','f','d','t'), &tfdt, &tfdtSize))
+	{
+		GstByteReader reader;
+		guint8 version = 0;
+		gst_byte_reader_init(&reader, tfdt, tfdtSize);
+		if (gst_byte_reader_get_uint8(&reader, &version) && gst_byte_reader_skip(&reader, 3))
+		{
+			if (version == 1)
+			{
+				ret = gst_byte_reader_get_uint64_be(&reader, decodeTime);
+			}
+			else
+			{
+				guint32 decodeTime32 = 0;
+				ret = gst_byte_reader_get_uint32_be(&reader, &decodeTime32);
+				*decodeTime = decodeTime32;
+			}
+		}
+	}
+	return ret;
+}
+
 /**
  * @class GstAampStreamer
  * @brief Handle media data/configuration/events from AAMP core
@@ -324,6 +1021,43 @@ void gst_aamp_stop_and_flush(GstAamp *aamp)
 class GstAampStreamer : public StreamSink, public AAMPEventObjectListener
 {
 private:
+	/**
+	 * @brief Propagates pause state and applies seek position to timestamps of copied data
+	 * @param[in] mediaType stream type
+	 * @param[in,out] fpts PTS of data (in sec)
+	 * @param[in,out] fdts DTS of data (in sec)
+	 * @retval false if stream is paused and data is not to be pushed
+	 */
+	bool ApplyStreamPosition(MediaType mediaType, double &fpts, double &fdts)
+	{
+		const char* mediaTypeStr = (mediaType == eMEDIATYPE_AUDIO) ? "AUDIO" : "VIDEO";
+		media_stream* stream = &aamp->stream[mediaType];
+
+		if (stream->isPaused)
+		{
+			for (int i = 0; i < STREAM_COUNT; i++)
+			{
+				aamp->stream[i].isPaused = TRUE;
+			}
+		}
+
+		if (stream->resetPosition && aamp->player_aamp->aamp->seek_pos_seconds > 0)
+		{
+			aamp->spts = aamp->player_aamp->aamp->seek_pos_seconds;
+			GST_DEBUG_OBJECT(aamp, "%s:%d Updating spts(%f) mediaType(%s)", __FUNCTION__, __LINE__, aamp->spts, mediaTypeStr);
+		}
+
+		if (aamp->spts > 0 && !aamp->isSkipSeekPosUpdate)
+		{
+			fpts += aamp->spts;
+			fdts += aamp->spts;
+		}
+
+		GST_TRACE_OBJECT(aamp, "%s:%d MediaType(%d) Updated fpts(%lf)\n", __FUNCTION__, __LINE__, mediaType, fpts);
+
+		return !stream->isPaused;
+	}
+
 	/**
 	 * @brief Inject stream buffer to gstreamer pipeline
 	 * @param[in] mediaType stream type
@@ -365,29 +1099,7 @@ private:
 		{
 			if (copy)
 			{
-				if (stream->isPaused)
-				{
-					for (int i = 0; i < STREAM_COUNT; i++)
-					{
-						aamp->stream[i].isPaused = TRUE;
-					}
-				}
-
-				if (stream->resetPosition && aamp->player_aamp->aamp->seek_pos_seconds > 0)
-				{
-					aamp->spts = aamp->player_aamp->aamp->seek_pos_seconds;
-					GST_DEBUG_OBJECT(aamp, "%s:%d Updating spts(%f) mediaType(%s)", __FUNCTION__, __LINE__, aamp->spts, mediaTypeStr);
-				}
-
-				if (aamp->spts > 0 && !aamp->isSkipSeekPosUpdate)
-				{
-					fpts += aamp->spts;
-					fdts += aamp->spts;
-				}
-
-				GST_TRACE_OBJECT(aamp, "%s:%d MediaType(%d) Updated fpts(%lf)\n", __FUNCTION__, __LINE__, mediaType, fpts);
-
-				bPushBuffer = !stream->isPaused;
+				bPushBuffer = ApplyStreamPosition(mediaType, fpts, fdts);
 			}
 		}
 		else
@@ -399,61 +1111,277 @@ private:
 		GstClockTime pts = (GstClockTime)(fpts * GST_SECOND);
 		GstClockTime dts = (GstClockTime)(fdts * GST_SECOND);
 
+		g_mutex_lock(&stream->eventsMutex);
 		if(stream->eventsPending)
 		{
 			SendPendingEvents(stream, pts);
 			discontinuity = TRUE;
 		}
 
-		if (aamp->player_aamp->aamp->DownloadsAreEnabled() && bPushBuffer)
+		if (aamp->player_aamp->aamp->DownloadsAreEnabled() && bPushBuffer)
+		{
+			GstBuffer *buffer;
+
+			if (copy)
+			{
+				buffer = gst_buffer_new_allocate(NULL, (gsize)len, NULL);
+
+				if (buffer)
+				{
+					GstMapInfo map;
+					gst_buffer_map(buffer, &map, GST_MAP_WRITE);
+					memcpy(map.data, ptr, len);
+					gst_buffer_unmap(buffer, &map);
+					GST_BUFFER_PTS(buffer) = pts;
+					GST_BUFFER_DTS(buffer) = dts;
+				}
+				else
+				{
+					bPushBuffer = FALSE;
+				}
+			}
+			else
+			{
+				buffer = gst_buffer_new_wrapped ((gpointer)ptr ,(gsize)len);
+
+				if (buffer)
+				{
+					GST_BUFFER_PTS(buffer) = pts;
+					GST_BUFFER_DTS(buffer) = dts;
+				}
+				else
+				{
+					bPushBuffer = FALSE;
+				}
+			}
+
+			if (bPushBuffer)
+			{
+				EnqueueBuffer(stream, buffer, discontinuity, (GstClockTime)(fDuration * GST_SECOND));
+			}
+		}
+		g_mutex_unlock(&stream->eventsMutex);
+
+		GST_TRACE_OBJECT(aamp, "%s:%d Exit", __FUNCTION__, __LINE__);
+	}
+
+	/**
+	 * @brief Adds timestamped buffer to stream
+	 * @param[in] stream Media stream to which buffer is sent
+	 * @param[in] buffer Buffer to send, ownership is transferred
+	 * @param[in] discontinuity TRUE if buffer follows a discontinuity
+	 * @param[in] duration duration of media in buffer, GST_CLOCK_TIME_NONE if unknown
+	 */
+	void EnqueueBuffer(media_stream* stream, GstBuffer *buffer, gboolean discontinuity, GstClockTime duration)
+	{
+		if (discontinuity)
+		{
+			GST_BUFFER_FLAG_SET(buffer, GST_BUFFER_FLAG_DISCONT);
+		}
+
+		GstClockTime pts = GST_BUFFER_PTS(buffer);
+		GstClockTime end = pts;
+		if (GST_CLOCK_TIME_IS_VALID(end) && GST_CLOCK_TIME_IS_VALID(duration))
+		{
+			end += duration;
+		}
+		if (GST_CLOCK_TIME_IS_VALID(end) && (!GST_CLOCK_TIME_IS_VALID(stream->lastEnd) || end > stream->lastEnd || discontinuity))
+		{
+			SetLastEnd(stream, end);
+		}
+
+		gst_aamp_stream_add_item (stream, buffer);
+
+		if (aamp->gapThreshold && aamp->enable_src_tasks && GST_CLOCK_TIME_IS_VALID(pts))
+		{
+			FillGaps(stream, pts);
+		}
+	}
+
+	/**
+	 * @brief Records the end of data sent on a stream
+	 * @param[in] stream Media stream, eventsMutex held
+	 * @param[in] end end of data in stream time, GST_CLOCK_TIME_NONE to reset
+	 *
+	 * The running time of the end is published for SharedSeamlessBase.
+	 */
+	void SetLastEnd(media_stream* stream, GstClockTime end)
+	{
+		GstClockTime runningEnd = GST_CLOCK_TIME_NONE;
+		stream->lastEnd = end;
+		if (GST_CLOCK_TIME_IS_VALID(end) && stream->segment.format == GST_FORMAT_TIME)
+		{
+			runningEnd = gst_segment_to_running_time(&stream->segment, GST_FORMAT_TIME, end);
+		}
+		g_mutex_lock(&aamp->seamlessMutex);
+		stream->runningEnd = runningEnd;
+		g_mutex_unlock(&aamp->seamlessMutex);
+	}
+
+	/**
+	 * @brief Gets the segment base of a stream continuing seamlessly after a discontinuity
+	 * @param[in] stream Media stream handling the discontinuity, eventsMutex held
+	 * @retval running time at which all streams continue, GST_CLOCK_TIME_NONE if unknown
+	 *
+	 * The first stream to handle a discontinuity takes the latest running time reached
+	 * by any stream, the other streams reuse it so audio and video stay in sync. A stream
+	 * coming back before all have used the base starts a new discontinuity.
+	 */
+	GstClockTime SharedSeamlessBase(media_stream* stream)
+	{
+		guint self = 1 << (stream - aamp->stream);
+		GstClockTime base;
+
+		g_mutex_lock(&aamp->seamlessMutex);
+		if (!GST_CLOCK_TIME_IS_VALID(aamp->seamlessBase) || (aamp->seamlessUsed & self))
 		{
-			GstBuffer *buffer;
-
-			if (copy)
+			aamp->seamlessBase = GST_CLOCK_TIME_NONE;
+			aamp->seamlessStreams = 0;
+			aamp->seamlessUsed = 0;
+			for (int i = 0; i < STREAM_COUNT; i++)
 			{
-				buffer = gst_buffer_new_allocate(NULL, (gsize)len, NULL);
-
-				if (buffer)
+				media_stream* other = &aamp->stream[i];
+				if (!other->srcpad || (i == eMEDIATYPE_AUDIO && !aamp->audio_enabled))
 				{
-					GstMapInfo map;
-					gst_buffer_map(buffer, &map, GST_MAP_WRITE);
-					memcpy(map.data, ptr, len);
-					gst_buffer_unmap(buffer, &map);
-					GST_BUFFER_PTS(buffer) = pts;
-					GST_BUFFER_DTS(buffer) = dts;
+					continue;
 				}
-				else
+				aamp->seamlessStreams |= 1 << i;
+				if (GST_CLOCK_TIME_IS_VALID(other->runningEnd)
+					&& (!GST_CLOCK_TIME_IS_VALID(aamp->seamlessBase) || other->runningEnd > aamp->seamlessBase))
 				{
-					bPushBuffer = FALSE;
+					aamp->seamlessBase = other->runningEnd;
 				}
 			}
-			else
+		}
+		base = aamp->seamlessBase;
+		aamp->seamlessUsed |= self;
+		if ((aamp->seamlessUsed & aamp->seamlessStreams) == aamp->seamlessStreams)
+		{
+			aamp->seamlessBase = GST_CLOCK_TIME_NONE;
+			aamp->seamlessUsed = 0;
+		}
+		g_mutex_unlock(&aamp->seamlessMutex);
+		return base;
+	}
+
+	/**
+	 * @brief Sends GAP events on streams lagging behind the stream being fed
+	 * @param[in] stream Media stream that has just received a buffer, eventsMutex held
+	 * @param[in] pts Presentation time-stamp of that buffer
+	 *
+	 * Muxed content may deliver one elementary stream well ahead of the other, leaving
+	 * downstream aggregators and sinks waiting on the starved pad. A lagging stream is
+	 * told that there is no data up to gap-threshold before pts, so preroll and playback
+	 * proceed without deep queues. Streams busy injecting are skipped.
+	 * Only used with src pad tasks: GAP events are queued for the lagging stream's task,
+	 * never pushed on its pad from this thread while its eventsMutex is held.
+	 */
+	void FillGaps(media_stream* stream, GstClockTime pts)
+	{
+		if (pts <= aamp->gapThreshold)
+		{
+			return;
+		}
+		GstClockTime limit = pts - aamp->gapThreshold;
+
+		for (int i = 0; i < STREAM_COUNT; i++)
+		{
+			media_stream* other = &aamp->stream[i];
+			if (other == stream || !other->srcpad || (i == eMEDIATYPE_AUDIO && !aamp->audio_enabled))
 			{
-				buffer = gst_buffer_new_wrapped ((gpointer)ptr ,(gsize)len);
+				continue;
+			}
+			if (!g_mutex_trylock(&other->eventsMutex))
+			{
+				continue;
+			}
 
-				if (buffer)
+			GstClockTime start = GST_CLOCK_TIME_NONE;
+			if (!other->eos && !other->flush)
+			{
+				/* stream-start may have gone out early with manifest protection events, see
+				 * SendEarlyProtectionEvents, no segment has been sent in that case */
+				if (other->eventsPending && other->resetPosition
+					&& (other->streamStart || other->segment.format != GST_FORMAT_TIME)
+					&& stream->segment.format == GST_FORMAT_TIME)
 				{
-					GST_BUFFER_PTS(buffer) = pts;
-					GST_BUFFER_DTS(buffer) = dts;
+					/* nothing received yet, start the stream where this one started */
+					start = stream->segment.start;
+					SendPendingEvents(other, start);
 				}
-				else
+				else if (!other->eventsPending)
 				{
-					bPushBuffer = FALSE;
+					start = other->lastEnd;
+					if (GST_CLOCK_TIME_IS_VALID(other->gapEnd)
+						&& (!GST_CLOCK_TIME_IS_VALID(start) || other->gapEnd > start))
+					{
+						start = other->gapEnd;
+					}
 				}
 			}
 
-			if (bPushBuffer)
+			if (GST_CLOCK_TIME_IS_VALID(start) && start < limit && gst_aamp_stream_can_accept(other))
 			{
-				if (discontinuity)
-				{
-					GST_BUFFER_FLAG_SET(buffer, GST_BUFFER_FLAG_DISCONT);
-				}
-
-				gst_aamp_stream_add_item (stream, buffer);
+				GST_DEBUG_OBJECT(aamp, "stream %d lagging, gap %" GST_TIME_FORMAT " - %" GST_TIME_FORMAT,
+						i, GST_TIME_ARGS(start), GST_TIME_ARGS(limit));
+				gst_aamp_stream_add_item(other, gst_event_new_gap(start, limit - start));
+				other->gapEnd = limit;
 			}
+			g_mutex_unlock(&other->eventsMutex);
+		}
+	}
+
+	/**
+	 * @brief Sends complete boxes of a partially received fragment
+	 * @param[in] stream Media stream to which buffer is sent
+	 * @param[in] size number of bytes from the start of the chunk adapter to send
+	 * @param[in] fpts PTS of the fragment (in sec), seek position applied
+	 * @param[in] fdts DTS of the fragment (in sec), seek position applied
+	 * @param[in] push false to drop the boxes while the stream is paused
+	 */
+	void SendChunkBoxes(media_stream* stream, gsize size, double fpts, double fdts, bool push)
+	{
+		GstBuffer *buffer = gst_adapter_take_buffer(stream->chunkAdapter, size);
+		GstClockTime pts = (GstClockTime)(fpts * GST_SECOND) + stream->chunkOffset;
+		GstClockTime dts = (GstClockTime)(fdts * GST_SECOND) + stream->chunkOffset;
+		gboolean discontinuity = FALSE;
+
+		g_mutex_lock(&stream->eventsMutex);
+		if (stream->eventsPending)
+		{
+			SendPendingEvents(stream, pts);
+			discontinuity = TRUE;
 		}
 
-		GST_TRACE_OBJECT(aamp, "%s:%d Exit", __FUNCTION__, __LINE__);
+		if (!buffer)
+		{
+			g_mutex_unlock(&stream->eventsMutex);
+			return;
+		}
+
+		if (aamp->player_aamp->aamp->DownloadsAreEnabled() && push)
+		{
+			GST_BUFFER_PTS(buffer) = pts;
+			GST_BUFFER_DTS(buffer) = dts;
+			EnqueueBuffer(stream, buffer, discontinuity, GST_CLOCK_TIME_NONE);
+		}
+		else
+		{
+			gst_buffer_unref(buffer);
+		}
+		g_mutex_unlock(&stream->eventsMutex);
+	}
+
+	/**
+	 * @brief Drops the partially received fragment of a stream
+	 * @param[in] stream Media stream
+	 */
+	void ClearChunks(media_stream* stream)
+	{
+		gst_adapter_clear(stream->chunkAdapter);
+		stream->chunkScanOffset = 0;
+		stream->chunkBaseValid = FALSE;
+		stream->chunkOffset = 0;
 	}
 
 public:
@@ -507,16 +1435,10 @@ public:
 	void SendPendingEvents(media_stream* stream, GstClockTime pts)
 	{
 		GST_INFO_OBJECT(aamp, "Enter SendPendingEvents");
+		gboolean flushed = stream->flush;
 		if (stream->streamStart)
 		{
-			GST_INFO_OBJECT(aamp, "sending new_stream_start\n");
-			gst_aamp_stream_add_item(stream, gst_event_new_stream_start(aamp->stream_id));
-
-			GST_INFO_OBJECT(aamp, "%s: sending caps1\n", __FUNCTION__);
-			gst_aamp_stream_add_item(stream, gst_event_new_caps(stream->caps));
-			stream->streamStart = FALSE;
-			GST_INFO_OBJECT(aamp, "%s: sent caps\n", __FUNCTION__);
-			stream->isPaused=FALSE;
+			SendStreamStart(stream);
 		}
 		if (stream->flush)
 		{
@@ -528,6 +1450,13 @@ public:
 			GST_INFO_OBJECT(aamp, "%s: sending flush stop\n", __FUNCTION__);
 			gst_aamp_stream_add_item(stream, event);
 			stream->flush = FALSE;
+			stream->eos = FALSE;
+
+			/* a base taken before the flush is stale for streams yet to use it */
+			g_mutex_lock(&aamp->seamlessMutex);
+			aamp->seamlessBase = GST_CLOCK_TIME_NONE;
+			aamp->seamlessUsed = 0;
+			g_mutex_unlock(&aamp->seamlessMutex);
 		}
 		if (stream->resetPosition)
 		{
@@ -538,14 +1467,156 @@ public:
 			segment.position = 0;
 			segment.rate = AAMP_NORMAL_PLAY_RATE;
 			segment.applied_rate = rate;
-			GST_INFO_OBJECT(aamp, "Sending segment event. start %" G_GUINT64_FORMAT " stop %" G_GUINT64_FORMAT" rate %f\n", segment.start, segment.stop, segment.rate);
+			if (stream->seamless && !flushed && stream->segment.format == GST_FORMAT_TIME)
+			{
+				/* continue running time from the end of the data before the discontinuity,
+				 * so decoders and sinks carry on without a flush or a gap */
+				GstClockTime base = SharedSeamlessBase(stream);
+				if (GST_CLOCK_TIME_IS_VALID(base))
+				{
+					segment.base = base;
+				}
+			}
+			stream->seamless = FALSE;
+			GST_INFO_OBJECT(aamp, "Sending segment event. start %" G_GUINT64_FORMAT " stop %" G_GUINT64_FORMAT" base %" G_GUINT64_FORMAT " rate %f\n", segment.start, segment.stop, segment.base, segment.rate);
 			GstEvent* event = gst_event_new_segment (&segment);
 			gst_aamp_stream_add_item(stream, event);
+			gst_segment_copy_into(&segment, &stream->segment);
+			SetLastEnd(stream, GST_CLOCK_TIME_NONE);
+			stream->gapEnd = GST_CLOCK_TIME_NONE;
+			stream->eos = FALSE;
 			stream->resetPosition = FALSE;
 		}
+		SendProtectionEvents(stream);
 		stream->eventsPending = FALSE;
 	}
 
+	/**
+	 * @brief Sends stream-start and caps events to stream's src pad
+	 * @param[in] stream Media stream to which events are sent, eventsMutex held
+	 */
+	void SendStreamStart(media_stream* stream)
+	{
+		GST_INFO_OBJECT(aamp, "sending new_stream_start\n");
+		gst_aamp_stream_add_item(stream, gst_event_new_stream_start(aamp->stream_id));
+
+		GST_INFO_OBJECT(aamp, "%s: sending caps1\n", __FUNCTION__);
+		gst_aamp_stream_add_item(stream, gst_event_new_caps(stream->caps));
+		stream->streamStart = FALSE;
+		GST_INFO_OBJECT(aamp, "%s: sent caps\n", __FUNCTION__);
+		stream->isPaused=FALSE;
+		// a new stream starts without sticky protection events downstream
+		stream->protectionPending = (stream->protectionEvents != NULL);
+	}
+
+	/**
+	 * @brief Sends protection events queued from the manifest to stream's src pad
+	 * @param[in] stream Media stream to which events are sent, eventsMutex held
+	 */
+	void SendProtectionEvents(media_stream* stream)
+	{
+		if (stream->protectionPending)
+		{
+			for (GList *l = stream->protectionEvents; l; l = l->next)
+			{
+				GST_INFO_OBJECT(aamp, "%s: sending protection event\n", __FUNCTION__);
+				gst_aamp_stream_add_item(stream, gst_event_ref(GST_EVENT(l->data)));
+			}
+			stream->protectionPending = FALSE;
+		}
+	}
+
+	/**
+	 * @brief Queues protection data known from the manifest
+	 *
+	 * The protection event is pushed on the stream's src pad as soon as the pad is ready,
+	 * ahead of the first fragment, so decryptors can start license acquisition while
+	 * the fragment is downloaded. It is sent again after each new stream-start.
+	 * @param[in] protSystemId protection system UUID
+	 * @param[in] ptr init data (PSSH)
+	 * @param[in] len length of init data
+	 * @param[in] type media type of the stream
+	 */
+	void QueueProtectionEvent(const char *protSystemId, const void *ptr, size_t len, MediaType type)
+	{
+		GST_INFO_OBJECT(aamp, "Enter QueueProtectionEvent type %d system %s len %d", (int)type, protSystemId, (int)len);
+		if (type != eMEDIATYPE_VIDEO && type != eMEDIATYPE_AUDIO)
+		{
+			return;
+		}
+		media_stream* stream = &aamp->stream[type];
+		GstBuffer *initData = gst_buffer_new_allocate(NULL, (gsize)len, NULL);
+		gst_buffer_fill(initData, 0, ptr, (gsize)len);
+		GstEvent *event = gst_event_new_protection(protSystemId, initData, "dash/mpd");
+		gst_buffer_unref(initData);
+
+		g_mutex_lock(&aamp->mutex);
+		gboolean ready = (aamp->state == GST_AAMP_READY);
+		g_mutex_unlock(&aamp->mutex);
+
+		g_mutex_lock(&stream->eventsMutex);
+		GList *l = stream->protectionEvents;
+		while (l)
+		{
+			GList *next = l->next;
+			const gchar *systemId = NULL;
+			gst_event_parse_protection(GST_EVENT(l->data), &systemId, NULL, NULL);
+			if (!g_strcmp0(systemId, protSystemId))
+			{
+				gst_event_unref(GST_EVENT(l->data));
+				stream->protectionEvents = g_list_delete_link(stream->protectionEvents, l);
+			}
+			l = next;
+		}
+		stream->protectionEvents = g_list_append(stream->protectionEvents, event);
+		stream->protectionPending = TRUE;
+		g_mutex_unlock(&stream->eventsMutex);
+
+		if (ready)
+		{
+			SendEarlyProtectionEvents(stream);
+		}
+	}
+
+	/**
+	 * @brief Sends queued protection events without waiting for the first fragment
+	 *
+	 * Stream-start and caps go out first if not sent yet; the segment follows with
+	 * the first buffer.
+	 * @param[in] stream Media stream, src pad added to the element
+	 */
+	void SendEarlyProtectionEvents(media_stream* stream)
+	{
+		g_mutex_lock(&stream->eventsMutex);
+		gboolean added = (stream != &aamp->stream[eMEDIATYPE_AUDIO] || aamp->audio_enabled);
+		if (stream->srcpad && added && stream->protectionPending && !stream->flush)
+		{
+			if (stream->streamStart)
+			{
+				SendStreamStart(stream);
+			}
+			SendProtectionEvents(stream);
+		}
+		g_mutex_unlock(&stream->eventsMutex);
+	}
+
+	/**
+	 * @brief Drops protection data queued from the manifest
+	 */
+	void ClearProtectionEvent()
+	{
+		GST_INFO_OBJECT(aamp, "Enter ClearProtectionEvent");
+		for (int i = 0; i < STREAM_COUNT; i++)
+		{
+			media_stream* stream = &aamp->stream[i];
+			g_mutex_lock(&stream->eventsMutex);
+			g_list_free_full(stream->protectionEvents, (GDestroyNotify) gst_event_unref);
+			stream->protectionEvents = NULL;
+			stream->protectionPending = FALSE;
+			g_mutex_unlock(&stream->eventsMutex);
+		}
+	}
+
 	/**
 	 * @brief inject HLS/ts elementary stream buffer to gstreamer pipeline
 	 * @param[in] mediaType stream type
@@ -573,12 +1644,161 @@ public:
 	 */
 	void SendTransfer(MediaType mediaType, GrowableBuffer* pBuffer, double fpts, double fdts, double fDuration, bool initFragment = false)
 	{
+		if (initFragment)
+		{
+			aamp->stream[mediaType].timescale = gst_aamp_parse_timescale((const guint8 *)pBuffer->ptr, pBuffer->len);
+		}
 		SendHelper(mediaType, pBuffer->ptr, pBuffer->len, fpts, fdts, fDuration, false /*transfer*/);
 
 		/*Since ownership of buffer is given to gstreamer, reset pBuffer*/
 		memset(pBuffer, 0x00, sizeof(GrowableBuffer));
 	}
 
+	/**
+	 * @brief inject part of a low latency CMAF fragment to gstreamer pipeline as soon as it arrives
+	 * @param[in] mediaType stream type
+	 * @param[in] ptr chunk pointer, any byte range of the fragment received over chunked transfer
+	 * @param[in] len length of chunk
+	 * @param[in] fpts PTS of the fragment (in sec)
+	 * @param[in] fdts DTS of the fragment (in sec)
+	 * @param[in] fDuration duration of the fragment (in sec)
+	 * @param[in] lastChunk true for the final chunk of the fragment
+	 * @note Caller owns ptr, may free on return. Each complete moof+mdat pair is pushed
+	 *       immediately, timestamped with fpts plus its tfdt offset within the fragment.
+	 *       Only complete boxes are pushed; an incomplete box left at lastChunk is dropped.
+	 */
+	void SendChunk(MediaType mediaType, const void *ptr, size_t len, double fpts, double fdts, double fDuration, bool lastChunk)
+	{
+		const char* mediaTypeStr = (mediaType == eMEDIATYPE_AUDIO) ? "AUDIO" : "VIDEO";
+		media_stream* stream = &aamp->stream[mediaType];
+
+		GST_DEBUG_OBJECT(aamp, "%s:%d MediaType(%s) len(%lu), fpts(%lf), fdts(%lf), fDuration(%lf) lastChunk(%d)\n", __FUNCTION__, __LINE__, mediaTypeStr, len, fpts, fdts, fDuration, lastChunk);
+
+		if (!readyToSend)
+		{
+			if (!gst_aamp_ready(aamp))
+			{
+				GST_WARNING_OBJECT(aamp, "%s:%d Not ready to consume data type(%s)\n", __FUNCTION__, __LINE__, mediaTypeStr);
+				return;
+			}
+			readyToSend = true;
+		}
+
+		if (!stream->srcpad)
+		{
+			GST_WARNING_OBJECT(aamp, "%s:%d Pad NULL mediaType(%s) len(%d) fpts(%f)\n", __FUNCTION__, __LINE__, mediaTypeStr, (int)len, fpts);
+			return;
+		}
+
+		bool bPushBuffer = ApplyStreamPosition(mediaType, fpts, fdts);
+
+		g_mutex_lock(&stream->eventsMutex);
+		guint flushCount = stream->flushCount;
+		g_mutex_unlock(&stream->eventsMutex);
+		if (flushCount != stream->chunkFlushCount)
+		{
+			/* remainder of a fragment from before the seek, chunks of the
+			 * fragment after it are kept while the flush is still pending */
+			ClearChunks(stream);
+			stream->chunkFlushCount = flushCount;
+		}
+
+		if (len)
+		{
+			GstBuffer *chunk = gst_buffer_new_allocate(NULL, (gsize)len, NULL);
+			gst_buffer_fill(chunk, 0, ptr, len);
+			gst_adapter_push(stream->chunkAdapter, chunk);
+		}
+
+		gsize available = gst_adapter_available(stream->chunkAdapter);
+		while (stream->chunkScanOffset + 8 <= available)
+		{
+			guint8 header[16];
+			gsize start = stream->chunkScanOffset;
+			gst_adapter_copy(stream->chunkAdapter, header, start, MIN(sizeof(header), available - start));
+			guint64 boxSize = GST_READ_UINT32_BE(header);
+			guint32 type = GST_READ_UINT32_LE(header + 4);
+			if (boxSize == 1)
+			{
+				if (start + 16 > available)
+				{
+					break;
+				}
+				boxSize = GST_READ_UINT64_BE(header + 8);
+			}
+			else if (boxSize == 0)
+			{
+				/* box runs to the end of the fragment */
+				if (!lastChunk)
+				{
+					break;
+				}
+				boxSize = available - start;
+			}
+			if (boxSize < 8 || boxSize > available - start)
+			{
+				break;
+			}
+			gsize end = start + boxSize;
+
+			if (type == GST_MAKE_FOURCC('m','o','o','f') || type == GST_MAKE_FOURCC('m','o','o','v'))
+			{
+				const guint8 *data = (const guint8 *) gst_adapter_map(stream->chunkAdapter, end);
+				if (type == GST_MAKE_FOURCC('m','o','o','v'))
+				{
+					stream->timescale = gst_aamp_parse_timescale(data + start, boxSize);
+				}
+				else
+				{
+					guint64 decodeTime = 0;
+					if (stream->timescale && gst_aamp_parse_decode_time(data + start, boxSize, &decodeTime))
+					{
+						if (!stream->chunkBaseValid)
+						{
+							stream->chunkBaseDecodeTime = decodeTime;
+							stream->chunkBaseValid = TRUE;
+						}
+						if (decodeTime >= stream->chunkBaseDecodeTime)
+						{
+							stream->chunkOffset = gst_util_uint64_scale(decodeTime - stream->chunkBaseDecodeTime, GST_SECOND, stream->timescale);
+						}
+					}
+				}
+				gst_adapter_unmap(stream->chunkAdapter);
+			}
+
+			stream->chunkScanOffset = end;
+			if (type == GST_MAKE_FOURCC('m','d','a','t'))
+			{
+				SendChunkBoxes(stream, end, fpts, fdts, bPushBuffer);
+				stream->chunkScanOffset = 0;
+				available -= end;
+			}
+		}
+
+		if (lastChunk)
+		{
+			if (stream->chunkScanOffset)
+			{
+				/* complete boxes after the last mdat */
+				SendChunkBoxes(stream, stream->chunkScanOffset, fpts, fdts, bPushBuffer);
+				available -= stream->chunkScanOffset;
+			}
+			if (available)
+			{
+				GST_WARNING_OBJECT(aamp, "%s:%d MediaType(%s) dropping %lu bytes of incomplete box at end of fragment\n", __FUNCTION__, __LINE__, mediaTypeStr, (unsigned long)available);
+			}
+			ClearChunks(stream);
+			GstClockTime end = (GstClockTime)((fpts + fDuration) * GST_SECOND);
+			g_mutex_lock(&stream->eventsMutex);
+			if (bPushBuffer && (!GST_CLOCK_TIME_IS_VALID(stream->lastEnd) || end > stream->lastEnd))
+			{
+				SetLastEnd(stream, end);
+			}
+			g_mutex_unlock(&stream->eventsMutex);
+		}
+	}
+
 	/**
 	 * @brief Updates internal rate
 	 * @param[in] rate Rate at which media is played back
@@ -602,7 +1822,10 @@ public:
 		media_stream* stream = &aamp->stream[type];
 		if (stream->srcpad)
 		{
+			g_mutex_lock(&stream->eventsMutex);
 			gst_aamp_stream_add_item( stream, gst_event_new_eos());
+			stream->eos = TRUE;
+			g_mutex_unlock(&stream->eventsMutex);
 		}
 	}
 
@@ -614,9 +1837,13 @@ public:
 	 */
 	bool Discontinuity(MediaType mediaType)
 	{
-		GST_INFO_OBJECT(aamp, "Enter Discontinuity, mediaType = %d", mediaType);
-		aamp->stream[mediaType].resetPosition = TRUE;
-		aamp->stream[mediaType].eventsPending = TRUE;
+		GST_INFO_OBJECT(aamp, "Enter Discontinuity, mediaType = %d seamless %d", mediaType, aamp->seamlessDiscontinuity);
+		media_stream* stream = &aamp->stream[mediaType];
+		g_mutex_lock(&stream->eventsMutex);
+		stream->seamless = aamp->seamlessDiscontinuity;
+		stream->resetPosition = TRUE;
+		stream->eventsPending = TRUE;
+		g_mutex_unlock(&stream->eventsMutex);
 		return false;
 	}
 
@@ -632,8 +1859,12 @@ public:
 		GST_INFO_OBJECT(aamp, "Enter Stream Flush position = %lf rate = %d shouldTearDown %d", position, rate, shouldTearDown);
 		for (int i = 0; i < STREAM_COUNT; i++)
 		{
-			aamp->stream[i].flush = TRUE;
-			aamp->stream[i].eventsPending = TRUE;
+			media_stream* stream = &aamp->stream[i];
+			g_mutex_lock(&stream->eventsMutex);
+			stream->flush = TRUE;
+			stream->eventsPending = TRUE;
+			stream->flushCount++;
+			g_mutex_unlock(&stream->eventsMutex);
 		}
 		aamp->seekFlush = TRUE;
 		}
@@ -644,9 +1875,13 @@ public:
 		GST_INFO_OBJECT(aamp, "Enter Stream stop keepLastFrame %d", keepLastFrame);
 		for (int i = 0; i < STREAM_COUNT; i++)
 		{
-			aamp->stream[i].resetPosition = TRUE;
-			aamp->stream[i].flush = TRUE;
-			aamp->stream[i].eventsPending = TRUE;
+			media_stream* stream = &aamp->stream[i];
+			g_mutex_lock(&stream->eventsMutex);
+			stream->resetPosition = TRUE;
+			stream->flush = TRUE;
+			stream->eventsPending = TRUE;
+			stream->flushCount++;
+			g_mutex_unlock(&stream->eventsMutex);
 		}
 		aamp->seekFlush = TRUE;
 	}
@@ -818,6 +2053,11 @@ static void gst_aamp_update_audio_src_pad(GstAamp * aamp)
 		else if (!enable_audio && aamp->audio_enabled)
 		{
 			GST_INFO_OBJECT(aamp, "Disable aud and remove pad");
+			if (aamp->enable_src_tasks)
+			{
+				/* nothing may push on the pad once it is removed */
+				gst_aamp_stream_stop(&aamp->stream[eMEDIATYPE_AUDIO]);
+			}
 			if (FALSE == gst_pad_set_active (aamp->stream[eMEDIATYPE_AUDIO].srcpad, FALSE))
 			{
 				GST_WARNING_OBJECT(aamp, "gst_pad_set_active FALSE failed");
@@ -842,8 +2082,10 @@ void gst_aamp_initialize_stream( GstAamp* parent, media_stream* stream)
 {
 	GST_DEBUG_OBJECT(parent, "Enter gst_aamp_initialize_stream");
 	stream->queue = g_queue_new ();
+	stream->chunkAdapter = gst_adapter_new ();
 	stream->parent = parent;
 	g_mutex_init (&stream->mutex);
+	g_mutex_init (&stream->eventsMutex);
 	g_cond_init (&stream->cond);
 }
 
@@ -958,6 +2200,17 @@ static void gst_aamp_class_init(GstAampClass * klass)
 	GstElementClass *element_class = GST_ELEMENT_CLASS(klass);
 
 	g_aamp_expose_hls_caps = g_getenv ("GST_AAMP_EXPOSE_HLS_CAPS");
+
+	const gchar *env = g_getenv ("GST_AAMP_SRC_POOL_THREADS");
+	if (env)
+	{
+		g_aamp_src_pool_threads = (guint) g_ascii_strtoull(env, NULL, 10);
+	}
+	env = g_getenv ("GST_AAMP_SRC_POOL_QUANTUM");
+	if (env)
+	{
+		g_aamp_src_pool_quantum = MAX((guint) g_ascii_strtoull(env, NULL, 10), 1);
+	}
 	if (g_aamp_expose_hls_caps)
 	{
 		gst_element_class_add_pad_template(element_class, gst_static_pad_template_get(&gst_aamp_sink_template_hls));
@@ -973,6 +2226,23 @@ static void gst_aamp_class_init(GstAampClass * klass)
 			"Advanced Adaptive Media Player", "Comcast");
 
 	gobject_class->finalize = gst_aamp_finalize;
+	gobject_class->set_property = gst_aamp_set_property;
+	gobject_class->get_property = gst_aamp_get_property;
+
+	g_object_class_install_property(gobject_class, PROP_SEAMLESS_DISCONTINUITY,
+			g_param_spec_boolean("seamless-discontinuity", "Seamless discontinuity",
+					"Keep running time continuous across discontinuities: new segment with adjusted base and no flush",
+					FALSE, G_PARAM_READWRITE));
+
+	g_object_class_install_property(gobject_class, PROP_PACING_LEAD_MS,
+			g_param_spec_uint("pacing-lead-ms", "Pacing lead",
+					"When non zero, src pad tasks push buffers at most this many milliseconds ahead of the pipeline running time",
+					0, G_MAXUINT, 0, G_PARAM_READWRITE));
+
+	g_object_class_install_property(gobject_class, PROP_GAP_THRESHOLD_MS,
+			g_param_spec_uint("gap-threshold-ms", "Gap threshold",
+					"When non zero and src pad tasks are enabled, a stream lagging more than this many milliseconds behind the other gets GAP events for the missing interval",
+					0, G_MAXUINT, 0, G_PARAM_READWRITE));
 	element_class->change_state = GST_DEBUG_FUNCPTR(gst_aamp_change_state);
 	element_class->query = GST_DEBUG_FUNCPTR(gst_aamp_query);
 }
@@ -993,15 +2263,29 @@ static void gst_aamp_init(GstAamp * aamp)
 	aamp->player_aamp = new PlayerInstanceAAMP(aamp->context);
 	aamp->sinkpad = gst_pad_new_from_static_template(&gst_aamp_sink_template_hls, "sink");
 	memset(&aamp->stream[0], 0 , sizeof(aamp->stream));
+	for (int i = 0; i < STREAM_COUNT; i++)
+	{
+		aamp->stream[i].lastEnd = GST_CLOCK_TIME_NONE;
+		aamp->stream[i].runningEnd = GST_CLOCK_TIME_NONE;
+		aamp->stream[i].gapEnd = GST_CLOCK_TIME_NONE;
+	}
+	aamp->seamlessBase = GST_CLOCK_TIME_NONE;
+	aamp->seamlessStreams = 0;
+	aamp->seamlessUsed = 0;
+	aamp->seamlessDiscontinuity = FALSE;
+	aamp->pacingLead = 0;
+	aamp->gapThreshold = 0;
 	aamp->stream_id = NULL;
 	aamp->idle_id = 0;
 	aamp->enable_src_tasks = FALSE;
+	aamp->srcPool = g_aamp_src_pool_threads ? gst_aamp_src_pool_ref() : NULL;
 	aamp->decoder_idle_id = 0;
 
 	gst_pad_set_chain_function(aamp->sinkpad, GST_DEBUG_FUNCPTR(gst_aamp_sink_chain));
 	gst_pad_set_event_function(aamp->sinkpad, GST_DEBUG_FUNCPTR(gst_aamp_sink_event));
 	gst_element_add_pad(GST_ELEMENT(aamp), aamp->sinkpad);
 	g_mutex_init (&aamp->mutex);
+	g_mutex_init (&aamp->seamlessMutex);
 	g_cond_init (&aamp->state_changed);
 	aamp->context->Discontinuity(eMEDIATYPE_VIDEO);
 	aamp->context->Discontinuity(eMEDIATYPE_AUDIO);
@@ -1030,7 +2314,14 @@ void gst_aamp_finalize_stream( media_stream* stream)
 		{
 			g_queue_free(stream->queue);
 		}
+
+		if (stream->chunkAdapter)
+		{
+			g_object_unref(stream->chunkAdapter);
+		}
+		g_list_free_full(stream->protectionEvents, (GDestroyNotify) gst_event_unref);
 		g_mutex_clear(&stream->mutex);
+		g_mutex_clear(&stream->eventsMutex);
 		g_cond_clear(&stream->cond);
 	}
 }
@@ -1050,6 +2341,7 @@ void gst_aamp_finalize(GObject * object)
 		aamp->location = NULL;
 	}
 	g_mutex_clear (&aamp->mutex);
+	g_mutex_clear (&aamp->seamlessMutex);
 	delete aamp->player_aamp;
 	delete aamp->context;
 	aamp->context=NULL;
@@ -1058,6 +2350,12 @@ void gst_aamp_finalize(GObject * object)
 	gst_aamp_finalize_stream( &aamp->stream[eMEDIATYPE_VIDEO]);
 	gst_aamp_finalize_stream(&aamp->stream[eMEDIATYPE_AUDIO]);
 
+	if (aamp->srcPool)
+	{
+		gst_aamp_src_pool_unref(aamp->srcPool);
+		aamp->srcPool = NULL;
+	}
+
 	if (aamp->stream_id)
 	{
 		g_free(aamp->stream_id);
@@ -1067,6 +2365,69 @@ void gst_aamp_finalize(GObject * object)
 	G_OBJECT_CLASS(gst_aamp_parent_class)->finalize(object);
 }
 
+/**
+ * @brief Invoked by gstreamer core to set element property
+ * @param[in] object gstaamp pointer
+ * @param[in] prop_id property id
+ * @param[in] value value to set
+ * @param[in] pspec property spec
+ */
+static void gst_aamp_set_property(GObject * object, guint prop_id, const GValue * value, GParamSpec * pspec)
+{
+	GstAamp *aamp = GST_AAMP(object);
+	switch (prop_id)
+	{
+		case PROP_SEAMLESS_DISCONTINUITY:
+			aamp->seamlessDiscontinuity = g_value_get_boolean(value);
+			GST_INFO_OBJECT(aamp, "seamless-discontinuity %d", aamp->seamlessDiscontinuity);
+			break;
+
+		case PROP_PACING_LEAD_MS:
+			aamp->pacingLead = g_value_get_uint(value) * GST_MSECOND;
+			GST_INFO_OBJECT(aamp, "pacing-lead %" GST_TIME_FORMAT, GST_TIME_ARGS(aamp->pacingLead));
+			break;
+
+		case PROP_GAP_THRESHOLD_MS:
+			aamp->gapThreshold = g_value_get_uint(value) * GST_MSECOND;
+			GST_INFO_OBJECT(aamp, "gap-threshold %" GST_TIME_FORMAT, GST_TIME_ARGS(aamp->gapThreshold));
+			break;
+
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+			break;
+	}
+}
+
+/**
+ * @brief Invoked by gstreamer core to get element property
+ * @param[in] object gstaamp pointer
+ * @param[in] prop_id property id
+ * @param[out] value property value
+ * @param[in] pspec property spec
+ */
+static void gst_aamp_get_property(GObject * object, guint prop_id, GValue * value, GParamSpec * pspec)
+{
+	GstAamp *aamp = GST_AAMP(object);
+	switch (prop_id)
+	{
+		case PROP_SEAMLESS_DISCONTINUITY:
+			g_value_set_boolean(value, aamp->seamlessDiscontinuity);
+			break;
+
+		case PROP_PACING_LEAD_MS:
+			g_value_set_uint(value, (guint)(aamp->pacingLead / GST_MSECOND));
+			break;
+
+		case PROP_GAP_THRESHOLD_MS:
+			g_value_set_uint(value, (guint)(aamp->gapThreshold / GST_MSECOND));
+			break;
+
+		default:
+			G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+			break;
+	}
+}
+
 /**
  * @brief This function processes asynchronous events from aamp core
  * @param[in] e reference of event
@@ -1316,6 +2677,10 @@ static GstStateChangeReturn gst_aamp_change_state(GstElement * element, GstState
 			g_cond_signal(&aamp->state_changed);
 			g_mutex_unlock (&aamp->mutex);
 			gst_element_no_more_pads (element);
+			for (int i = 0; i < STREAM_COUNT; i++)
+			{
+				aamp->context->SendEarlyProtectionEvents(&aamp->stream[i]);
+			}
 			break;
 		case GST_STATE_CHANGE_PAUSED_TO_PLAYING:
 			GST_AAMP_LOG_TIMING("GST_STATE_CHANGE_PAUSED_TO_PLAYING\n");
@@ -1357,6 +2722,10 @@ static GstStateChangeReturn gst_aamp_change_state(GstElement * element, GstState
 	switch (trans)
 	{
 		case GST_STATE_CHANGE_PLAYING_TO_PAUSED:
+			if (aamp->enable_src_tasks && aamp->pacingLead)
+			{
+				gst_aamp_stream_unpace_all(aamp);
+			}
 			if (aamp->idle_id)
 			{
 				g_source_remove(aamp->idle_id);
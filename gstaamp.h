@@ -27,6 +27,7 @@
 #define _GST_AAMP_H_
 
 #include <gst/gst.h>
+#include <gst/base/gstadapter.h>
 G_BEGIN_DECLS
 
 #define GST_TYPE_AAMP   (gst_aamp_get_type())
@@ -53,6 +54,12 @@ typedef struct _GstAampClass GstAampClass;
  */
 struct GstAampStreamer;
 
+/**
+ * @struct GstAampSrcPool
+ * @brief forward declaration
+ */
+struct GstAampSrcPool;
+
 /**
  * @enum _GstAampState {
  * @brief State of element
@@ -89,6 +96,30 @@ struct media_stream
 	GMutex mutex;
 	GCond cond;
 	GstAamp* parent;
+	gboolean poolActive;
+	gboolean scheduled;
+	gboolean servicing;
+	gboolean stopping;
+	GstAdapter *chunkAdapter;
+	gsize chunkScanOffset;
+	guint64 chunkBaseDecodeTime;
+	gboolean chunkBaseValid;
+	GstClockTime chunkOffset;
+	guint32 timescale;
+	guint flushCount;
+	guint chunkFlushCount;
+	gboolean seamless;
+	GstSegment segment;
+	GstClockTime lastEnd;
+	GstClockTime runningEnd;
+	GstClockTime gapEnd;
+	GstSegment outSegment;
+	GstClockID paceClockId;
+	gboolean paceWaiting;
+	GMutex eventsMutex;
+	gboolean eos;
+	GList *protectionEvents;
+	gboolean protectionPending;
 };
 
 /**
@@ -113,8 +144,16 @@ struct _GstAamp
 	guint idle_id;
 	gboolean report_tune;
 	gboolean enable_src_tasks;
+	GstAampSrcPool* srcPool;
 	gboolean flushing;
 	gboolean isSkipSeekPosUpdate;
+	gboolean seamlessDiscontinuity;
+	GMutex seamlessMutex;
+	GstClockTime seamlessBase;
+	guint seamlessStreams;
+	guint seamlessUsed;
+	GstClockTime pacingLead;
+	GstClockTime gapThreshold;
 
 	guint decoder_idle_id;
 	gboolean report_decode_handle;
@@ -29,12 +29,6 @@
 #include <gst/gst.h>
 #include "gstaamp.h"
 #include "gstaampsrc.h"
-#ifdef DRM_BUILD_PROFILE
-#include "gstaampplayreadydecryptor.h"
-#include "gstaampwidevinedecryptor.h"
-#include "gstaampclearkeydecryptor.h"
-#include "gstaampverimatrixdecryptor.h"
-#endif
 
 
 /**
@@ -49,51 +43,6 @@ static gboolean plugin_init(GstPlugin * plugin)
 	{
 		ret = gst_element_register(plugin, "aampsrc", GST_RANK_PRIMARY, GST_TYPE_AAMPSRC);
 	}
-#ifdef DRM_BUILD_PROFILE
-	if (ret)
-	{
-		ret = gst_element_register(plugin, GstPluginNamePR,
-				GST_RANK_PRIMARY, GST_TYPE_AAMPPLAYREADYDECRYPTOR );
-		if(ret)
-		{
-			logprintf("aamp plugin_init registered %s element\n", GstPluginNamePR);
-		}
-		else
-		{
-			logprintf("aamp plugin_init FAILED to register %s element\n", GstPluginNamePR);
-		}
-		ret = gst_element_register(plugin, GstPluginNameWV,
-				GST_RANK_PRIMARY, GST_TYPE_AAMPWIDEVINEDECRYPTOR );
-		if(ret)
-		{
-			logprintf("aamp plugin_init registered %s element\n", GstPluginNameWV);
-		}
-		else
-		{
-			logprintf("aamp plugin_init FAILED to register %s element\n", GstPluginNameWV);
-		}
-		ret = gst_element_register(plugin, GstPluginNameCK,
-				GST_RANK_PRIMARY, GST_TYPE_AAMPCLEARKEYDECRYPTOR );
-		if(ret)
-		{
-			logprintf("aamp plugin_init registered %s element\n", GstPluginNameCK);
-		}
-		else
-		{
-			logprintf("aamp plugin_init FAILED to register %s element\n", GstPluginNameCK);
-		}
-		ret = gst_element_register(plugin, GstPluginNameVMX,
-				GST_RANK_PRIMARY, GST_TYPE_AAMPVERIMATRIXDECRYPTOR );
-		if(ret)
-		{
-			logprintf("aamp plugin_init registered %s element\n", GstPluginNameVMX);
-		}
-		else
-		{
-			logprintf("aamp plugin_init FAILED to register %s element\n", GstPluginNameVMX);
-		}
-	}
-#endif
 	return ret;
 }
 